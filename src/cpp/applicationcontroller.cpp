@@ -1,7 +1,18 @@
 #include "applicationcontroller.h"
-#include "guihelper.h"
-
-ApplicationController::ApplicationController(QObject *parent) : QObject(parent)
+#include "structuredlog.h"
+#include "startupprofile.h"
+#include "logclock.h"
+
+ApplicationController::ApplicationController(QObject *parent)
+    : QObject(parent)
+    , mDirtyValves(0)
+    , mDirtyPumps(0)
+    , mDirtyMeasuredPressures(0)
+    , mDirtySetpoints(0)
+    , mConfirmationTimeout(0)
+    , mPressureRecorder(nullptr)
+    , mPressureSeries(new PressureTimeSeries(PressureTimeSeries::DEFAULT_CAPACITY, this))
+    , mExporter(nullptr)
 {
     // Initialize mCommunicator. Can be either USB ("Serial") or Bluetooth. Windows
     // doesn't support Bluetooth, and Android doesn't support serial over USB (at least,
@@ -20,21 +31,68 @@ ApplicationController::ApplicationController(QObject *parent) : QObject(parent)
     else
         mCommunicator = new SerialCommunicator(this);
 
-    QObject::connect(mCommunicator, &Communicator::valveStateChanged, this, &ApplicationController::onValveStateChanged);
-    QObject::connect(mCommunicator, &Communicator::pressureChanged, this, &ApplicationController::onPressureChanged);
-    QObject::connect(mCommunicator, &Communicator::pressureSetpointChanged, this, &ApplicationController::onPressureSetpointChanged);
-    QObject::connect(mCommunicator, &Communicator::pumpStateChanged, this, &ApplicationController::onPumpStateChanged);
-    QObject::connect(mCommunicator, &Communicator::connectionStatusChanged, this, &ApplicationController::onCommunicatorStatusChanged);
-    QObject::connect(mCommunicator, &Communicator::uptimeChanged, this, &ApplicationController::onUptimeChanged);
+    connectCommunicator();
+
+    mGuiUpdateTimer.setSingleShot(true);
+    mGuiUpdateTimer.setTimerType(Qt::PreciseTimer);
+    mGuiUpdateTimer.setInterval(GUI_UPDATE_INTERVAL);
+    QObject::connect(&mGuiUpdateTimer, &QTimer::timeout, this, &ApplicationController::updateGui);
+
+    for (Multiplexer const& mux : Multiplexer::builtInMultiplexers())
+        mMultiplexers[mux.name()] = mux;
 
     mRoutineController = new RoutineController(this);
 
     QObject::connect(mRoutineController, &RoutineController::setValve,
                      this, &ApplicationController::setValve);
+    QObject::connect(mRoutineController, &RoutineController::setValves,
+                     this, &ApplicationController::setValves);
     QObject::connect(mRoutineController, &RoutineController::setPressure,
                      this, &ApplicationController::setPressure);
 
-    mSettings = new QSettings();
+    mSettings = new SettingsCache(QString(), this);
+
+    mConfirmationTimeout = mSettings->value("communication/confirmationTimeout", 2000).toLongLong();
+    mConfirmationTimer.setInterval(CONFIRMATION_CHECK_INTERVAL);
+    QObject::connect(&mConfirmationTimer, &QTimer::timeout, this, &ApplicationController::expireCommands);
+
+    // Until the device reports its capabilities, assume it is the same as last time
+    mDeviceState.setCapabilities(cachedCapabilities(mSettings->value("devices/lastDevice").toString()));
+
+    mLogModel = new LogModel(logCapacity(), this);
+
+    if (isPressureHistoryEnabled()) {
+        QString directory = PressureRecorder::defaultDirectory();
+        PressureRecorder::prune(directory, mSettings->value("pressureHistory/retentionDays", 90).toInt());
+        mPressureRecorder = new PressureRecorder(directory);
+
+        // Chunks are otherwise only written when a sample arrives, which may never happen if the device goes quiet
+        mPressureFlushTimer.setInterval(PRESSURE_FLUSH_INTERVAL);
+        QObject::connect(&mPressureFlushTimer, &QTimer::timeout, [this]() { mPressureRecorder->flushExpired(); });
+        mPressureFlushTimer.start();
+    }
+
+    if (isExportEnabled()) {
+        mExporter = new ExperimentExporter(exportDirectory());
+
+        // These are direct connections, so that steps are timestamped by the routine thread as they start.
+        // The exporter is thread-safe.
+        QObject::connect(mRoutineController, &RoutineController::runStatusChanged, [this](RoutineController::RunStatus status) {
+            if (status == RoutineController::Running)
+                mExporter->beginRun(mRoutineController->routineName());
+            else if (status == RoutineController::Finished)
+                mExporter->endRun();
+        });
+        QObject::connect(mRoutineController, &RoutineController::currentStepChanged, [this](int step) {
+            mExporter->recordStep(step, mRoutineController->stepText(step));
+        });
+        QObject::connect(mRoutineController, &RoutineController::paused, [this]() {
+            mExporter->recordRunEvent("Paused");
+        });
+        QObject::connect(mRoutineController, &RoutineController::resumed, [this]() {
+            mExporter->recordRunEvent("Resumed");
+        });
+    }
 
     if (isDenseThemeEnabled())
         qputenv("QT_QUICK_CONTROLS_MATERIAL_VARIANT", "Dense");
@@ -44,8 +102,57 @@ ApplicationController::~ApplicationController()
 {
     delete mRoutineController;
     delete mCommunicator;
+    delete mPressureRecorder;
+    delete mExporter;
+}
+
+/**
+ * @brief Save everything that is written in the background. Call this before the application exits.
+ *
+ * The controller is not destroyed at exit (QML may still refer to it), so this must not rely on the destructor.
+ */
+void ApplicationController::shutdown()
+{
+    mPressureFlushTimer.stop();
+    if (mPressureRecorder) {
+        mPressureRecorder->flush();
+        mPressureRecorder->waitForDone();
+    }
+
+    // Writes the end of the current run, if any
+    if (mExporter)
+        mExporter->stop();
+
+    mSettings->flush();
+    mSettings->waitForDone();
 }
 
+/**
+ * @brief Connect the communicator's signals to the corresponding slots of the application controller
+ */
+void ApplicationController::connectCommunicator()
+{
+    QObject::connect(mCommunicator, &Communicator::valveStateChanged, this, &ApplicationController::onValveStateChanged);
+    QObject::connect(mCommunicator, &Communicator::pressureChanged, this, &ApplicationController::onPressureChanged);
+    QObject::connect(mCommunicator, &Communicator::pressureSetpointChanged, this, &ApplicationController::onPressureSetpointChanged);
+    QObject::connect(mCommunicator, &Communicator::pumpStateChanged, this, &ApplicationController::onPumpStateChanged);
+    QObject::connect(mCommunicator, &Communicator::connectionStatusChanged, this, &ApplicationController::onCommunicatorStatusChanged);
+    QObject::connect(mCommunicator, &Communicator::uptimeChanged, this, &ApplicationController::onUptimeChanged);
+    QObject::connect(mCommunicator, &Communicator::capabilitiesReceived, this, &ApplicationController::onCapabilitiesReceived);
+}
+
+#ifdef TESTING
+/**
+ * @brief Replace the communicator, e.g. with a simulated one. For use in tests and benchmarks only.
+ */
+void ApplicationController::setCommunicator(Communicator *communicator)
+{
+    delete mCommunicator;
+    mCommunicator = communicator;
+    connectCommunicator();
+}
+#endif
+
 QString ApplicationController::connectionStatus()
 {
     return mCommunicator->getConnectionStatusString();
@@ -57,33 +164,54 @@ void ApplicationController::connect()
 }
 
 /**
- * @brief Return the number of valves defined in the GUI
+ * @brief Return the startup phases measured by StartupProfile, for display in the diagnostics section of the settings
  *
- * This reflects the ValveSwitches defined on the QML side
+ * Each item has the properties name, elapsed, duration (all times in ms) and deferred.
+ */
+QVariantList ApplicationController::startupPhases()
+{
+    QVariantList phases;
+    for (StartupProfile::Phase const& phase : StartupProfile::phases()) {
+        QVariantMap p;
+        p["name"] = phase.name;
+        p["elapsed"] = phase.elapsed;
+        p["duration"] = phase.duration;
+        p["deferred"] = phase.deferred;
+        phases.push_back(p);
+    }
+    return phases;
+}
+
+/**
+ * @brief Record the time (in ms) taken to load a screen that is only loaded when it is first shown
+ */
+void ApplicationController::recordScreenLoad(const QString &screen, double duration)
+{
+    StartupProfile::addDeferredLoad(screen, duration);
+}
+
+/**
+ * @brief Return the number of valves of the device (see DeviceCapabilities)
  */
 int ApplicationController::nValves()
 {
-    return mQmlValveSwitches.size();
+    return mDeviceState.valveCount();
 }
 
 /**
- * @brief Return the number of pumps defined in the GUI
- *
- * This reflects the PumpSwitches defined on the QML side
+ * @brief Return the number of pumps of the device (see DeviceCapabilities)
  */
 int ApplicationController::nPumps()
 {
-    return mQmlPumpSwitches.size();
+    return mDeviceState.pumpCount();
 }
 
 /**
- * @brief Return the number of pressure controllers defined in the GUI
- *
- * This reflects the PressureControllers defined on the QML side
+ * @brief Return the number of pressure controllers of the device (see DeviceCapabilities)
  */
 int ApplicationController::nPressureControllers()
 {
-    return mQmlPressureControllers.size();
+    return mDeviceState.controllerCount();
 }
 
 /**
@@ -91,14 +219,12 @@ int ApplicationController::nPressureControllers()
  */
 double ApplicationController::minPressure(int controllerNumber)
 {
-    QList<PCHelper*> pcs = mQmlPressureControllers[controllerNumber];
-
-    if (pcs.isEmpty()) {
-        qCritical() << "Tried to access undefined pressure controller";
+    if (!mDeviceState.isControllerDefined(controllerNumber)) {
+        UFCS_CRITICAL(lcApplication) << "Tried to access undefined pressure controller";
         return 0;
     }
 
-    return pcs.first()->minPressure();
+    return mDeviceState.minPressure(controllerNumber);
 }
 
 /**
@@ -106,49 +232,71 @@ double ApplicationController::minPressure(int controllerNumber)
  */
 double ApplicationController::maxPressure(int controllerNumber)
 {
-    QList<PCHelper*> pcs = mQmlPressureControllers[controllerNumber];
-
-    if (pcs.isEmpty()) {
-        qCritical() << "Tried to access undefined pressure controller";
+    if (!mDeviceState.isControllerDefined(controllerNumber)) {
+        UFCS_CRITICAL(lcApplication) << "Tried to access undefined pressure controller";
         return 0;
     }
 
-    return pcs.first()->maxPressure();
+    return mDeviceState.maxPressure(controllerNumber);
 }
 
-
-void ApplicationController::registerPCHelper(int controllerNumber, PCHelper* instance)
+/**
+ * @brief Return the firmware version of the device, or an empty string if it didn't report it
+ */
+QString ApplicationController::firmwareVersion()
 {
-    if (!mQmlPressureControllers.contains(controllerNumber))
-        mQmlPressureControllers[controllerNumber] = QList<PCHelper*>();
-
-    mQmlPressureControllers[controllerNumber].push_back(instance);
+    return mDeviceState.capabilities().firmwareVersion;
 }
 
-void ApplicationController::registerValveSwitchHelper(int valveNumber, ValveSwitchHelper* instance)
-{
-    if (!mQmlValveSwitches.contains(valveNumber))
-        mQmlValveSwitches[valveNumber] = QList<ValveSwitchHelper*>();
+/**
+ * @brief Return the capabilities of a device as saved in settings, or the defaults if there are none
+ * @param deviceKey The device identifier, as returned by settingsKey()
+ */
+DeviceCapabilities ApplicationController::cachedCapabilities(const QString &deviceKey)
+{
+    DeviceCapabilities capabilities = DeviceCapabilities::defaults();
+    if (deviceKey.isEmpty())
+        return capabilities;
+
+    QString group = "devices/" + deviceKey + "/";
+
+    if (mSettings->contains(group + "valveCount")) {
+        capabilities.deviceId = deviceKey;
+        capabilities.valveCount = mSettings->value(group + "valveCount").toInt();
+        capabilities.pumpCount = mSettings->value(group + "pumpCount").toInt();
+        capabilities.controllerCount = qMin(mSettings->value(group + "controllerCount").toInt(), N_PRS);
+        capabilities.firmwareVersion = mSettings->value(group + "firmwareVersion").toString();
+        for (int i(0); i < capabilities.controllerCount; ++i) {
+            capabilities.minPressure[i] = mSettings->value(group + QString("minPressure%1").arg(i + 1)).toDouble();
+            capabilities.maxPressure[i] = mSettings->value(group + QString("maxPressure%1").arg(i + 1)).toDouble();
+        }
+    }
 
-    mQmlValveSwitches[valveNumber].push_back(instance);
+    return capabilities;
 }
 
-void ApplicationController::registerPumpSwitchHelper(int pumpNumber, PumpSwitchHelper *instance)
+/**
+ * @brief Return a device identifier that can be used as a settings key, i.e. without slashes
+ */
+QString ApplicationController::settingsKey(const QString &deviceId)
 {
-    mQmlPumpSwitches[pumpNumber] = instance;
+    QString key = deviceId;
+    key.replace(QRegularExpression("[/\\\\]"), "_");
+    return key;
 }
 
 /**
- * @brief Add a message to the (internal) log, for access within the application.
- * @param entry A QStringList (or compatible type) with 3 elements: time, message type and message text.
- *
- * This log is only for access within the application. It is separate from the messages logged to file.
- * See ApplicationController::messageHandler for the rest of the logging code.
+ * @brief Return the maximum number of log messages kept for display in the GUI
  */
-void ApplicationController::addToLog(QVariant entry)
+int ApplicationController::logCapacity()
+{
+    return mSettings->value("logging/guiCapacity", 5000).toInt();
+}
+
+void ApplicationController::setLogCapacity(int capacity)
 {
-    mLog.append(entry);
-    emit newLogMessage(entry);
+    mSettings->setValue("logging/guiCapacity", capacity);
+    mLogModel->setCapacity(capacity);
 }
 
 bool ApplicationController::isDarkModeEnabled()
@@ -166,7 +314,7 @@ bool ApplicationController::isDarkModeEnabled()
 void ApplicationController::setDarkModeEnabled(bool enabled)
 {
     mSettings->setValue("darkMode", enabled);
-    qInfo() << "Setting theme to" << (enabled ? "dark" : "light") << "mode";
+    UFCS_INFO(lcApplication) << "Setting theme to" << (enabled ? "dark" : "light") << "mode";
     emit darkModeChanged(enabled);
 }
 
@@ -291,14 +439,8 @@ QMap<QString, QUrl> ApplicationController::graphicalControlScreenSources()
 {
     QMap<QString, QUrl> sources;
 
-    mSettings->beginGroup("graphicalControl");
-    mSettings->beginGroup("sources");
-
-    for (QString const& k : mSettings->childKeys())
-        sources[k] = mSettings->value(k).toString();
-
-    mSettings->endGroup();
-    mSettings->endGroup();
+    for (QString const& k : mSettings->childKeys("graphicalControl/sources"))
+        sources[k] = mSettings->value("graphicalControl/sources/" + k).toString();
 
     // Default values, in case no sources are specified
     if (sources.isEmpty()) {
@@ -313,15 +455,9 @@ QMap<QString, QUrl> ApplicationController::graphicalControlScreenSources()
 
 void ApplicationController::setGraphicalControlScreenSources(QMap<QString, QUrl> sources)
 {
-    mSettings->beginGroup("graphicalControl");
-    mSettings->beginGroup("sources");
-
-    for (QString const& key : sources.keys())
+    for (auto it = sources.constBegin(); it != sources.constEnd(); ++it)
         // Saved as string rather than QUrl to make it more human-friendly
-        mSettings->setValue(key, sources[key].toString());
-
-    mSettings->endGroup();
-    mSettings->endGroup();
+        mSettings->setValue("graphicalControl/sources/" + it.key(), it.value().toString());
 }
 
 QString ApplicationController::currentGraphicalControlScreenLabel()
@@ -334,7 +470,8 @@ QString ApplicationController::currentGraphicalControlScreenLabel()
 
 QUrl ApplicationController::currentGraphicalControlScreenURL()
 {
-    return graphicalControlScreenSources()[currentGraphicalControlScreenLabel()];
+    QMap<QString, QUrl> sources = graphicalControlScreenSources();
+    return sources.value(mSettings->value("graphicalControl/currentLabel", sources.firstKey()).toString());
 }
 
 void ApplicationController::setCurrentGraphicalControlScreen(QString label)
@@ -342,6 +479,73 @@ void ApplicationController::setCurrentGraphicalControlScreen(QString label)
     mSettings->setValue("graphicalControl/currentLabel", label);
 }
 
+/**
+ * @brief Return the channel labels of the given multiplexer, in the order in which they were defined
+ *
+ * This is used by MultiplexerControl to create one button per channel.
+ */
+QStringList ApplicationController::multiplexerChannels(QString multiplexerName)
+{
+    const Multiplexer* mux = multiplexer(multiplexerName);
+    if (!mux) {
+        UFCS_WARNING(lcApplication) << "No multiplexer defined with name" << multiplexerName;
+        return QStringList();
+    }
+
+    return mux->channelLabels();
+}
+
+/**
+ * @brief Switch a multiplexer to the given channel
+ * @param multiplexerName The name of the multiplexer, e.g. "Co-culture chip v5"
+ * @param channelLabel The label of the channel, e.g. "1" or "All" (case-insensitive)
+ * @return True if the channel was found, false otherwise.
+ *
+ * All the multiplexer's valves are set in one bulk operation.
+ */
+bool ApplicationController::setMultiplexer(QString multiplexerName, QString channelLabel)
+{
+    const Multiplexer* mux = multiplexer(multiplexerName);
+    Multiplexer::Channel channel;
+
+    if (!mux || !mux->findChannel(channelLabel, channel)) {
+        UFCS_WARNING(lcApplication) << "No channel" << channelLabel << "found for multiplexer" << multiplexerName;
+        return false;
+    }
+
+    UFCS_INFO(lcApplication) << "Setting multiplexer" << multiplexerName << "to channel" << channel.label;
+    setValves(channel.openMask, channel.closeMask);
+    return true;
+}
+
+/**
+ * @brief Return the multiplexer with the given name, or nullptr if there is none
+ */
+const Multiplexer* ApplicationController::multiplexer(const QString &name) const
+{
+    auto it = mMultiplexers.find(name);
+    if (it == mMultiplexers.end())
+        return nullptr;
+    return &it.value();
+}
+
+/**
+ * @brief Return the multiplexer used by the `multiplexer` and `input` routine commands
+ * @param inputMultiplexer If true, return the input multiplexer rather than the main one
+ * @return The multiplexer of the chip whose graphical control screen is currently selected,
+ * or nullptr if that chip has no such multiplexer.
+ *
+ * Built-in multiplexers are named after the graphical control screen of their chip, with
+ * " inputs" appended to the name for input multiplexers.
+ */
+const Multiplexer* ApplicationController::routineMultiplexer(bool inputMultiplexer)
+{
+    QString name = currentGraphicalControlScreenLabel();
+    if (inputMultiplexer)
+        name += " inputs";
+
+    return multiplexer(name);
+}
 
 /**
  * @brief Load the baud rate for USB communication from settings
@@ -361,40 +565,244 @@ void ApplicationController::setSerialBaudRate(int rate)
     mSettings->setValue("baudRate", rate);
 }
 
+/**
+ * @brief Return whether the binary (structured) log is written, in addition to the text log
+ */
+bool ApplicationController::isBinaryLogEnabled()
+{
+    return mSettings->value("logging/binaryLogEnabled", false).toBool();
+}
+
+/**
+ * @brief Enable or disable the binary log. This takes effect when the application is restarted.
+ */
+void ApplicationController::setBinaryLogEnabled(bool enabled)
+{
+    mSettings->setValue("logging/binaryLogEnabled", enabled);
+}
+
+/**
+ * @brief Return whether measured pressures are recorded (see PressureRecorder)
+ */
+bool ApplicationController::isPressureHistoryEnabled()
+{
+    return mSettings->value("pressureHistory/enabled", true).toBool();
+}
+
+/**
+ * @brief Enable or disable the pressure history. This takes effect when the application is restarted.
+ */
+void ApplicationController::setPressureHistoryEnabled(bool enabled)
+{
+    mSettings->setValue("pressureHistory/enabled", enabled);
+}
+
+/**
+ * @brief Return whether routine runs are exported (see ExperimentExporter)
+ */
+bool ApplicationController::isExportEnabled()
+{
+    return mSettings->value("export/enabled", true).toBool();
+}
+
+/**
+ * @brief Enable or disable the export of routine runs. This takes effect when the application is restarted.
+ */
+void ApplicationController::setExportEnabled(bool enabled)
+{
+    mSettings->setValue("export/enabled", enabled);
+}
+
+/**
+ * @brief Return the directory where routine runs are exported
+ */
+QString ApplicationController::exportDirectory()
+{
+    return mSettings->value("export/directory", ExperimentExporter::defaultDirectory()).toString();
+}
+
+/**
+ * @brief Open or close a valve. The GUI shows the new state immediately, as pending until the device confirms it.
+ */
+void ApplicationController::setValve(uint valveNumber, bool open)
+{
+    if (valveNumber >= 1 && valveNumber <= N_VALVES) {
+        mDeviceState.commandValve(valveNumber, open, LogClock::monotonicNanoseconds() / 1000000);
+        mDirtyValves |= 1u << (valveNumber - 1);
+        watchCommands();
+    }
+
+    mCommunicator->setValve(valveNumber, open);
+}
+
+/**
+ * @brief Open and/or close several valves at once. See Communicator::setValves and setValve.
+ */
+void ApplicationController::setValves(quint32 openMask, quint32 closeMask)
+{
+    qint64 now = LogClock::monotonicNanoseconds() / 1000000;
+    for (quint32 m = openMask | closeMask; m; m &= m - 1) {
+        int i = qCountTrailingZeroBits(m);
+        mDeviceState.commandValve(i + 1, openMask & (1u << i), now);
+    }
+    mDirtyValves |= openMask | closeMask;
+    watchCommands();
+
+    mCommunicator->setValves(openMask, closeMask);
+}
+
+/**
+ * @brief Switch a pump on or off. See setValve.
+ */
+void ApplicationController::setPump(uint pumpNumber, bool on)
+{
+    if (pumpNumber >= 1 && pumpNumber <= N_PUMPS) {
+        mDeviceState.commandPump(pumpNumber, on, LogClock::monotonicNanoseconds() / 1000000);
+        mDirtyPumps |= 1u << (pumpNumber - 1);
+        watchCommands();
+    }
+
+    mCommunicator->setPump(pumpNumber, on);
+}
+
+/**
+ * @brief Set the setpoint of a pressure controller, as a fraction of its range. See setValve.
+ */
+void ApplicationController::setPressure(uint controllerNumber, double pressure)
+{
+    if (controllerNumber >= 1 && controllerNumber <= N_PRS && pressure >= 0. && pressure <= 1.) {
+        mDeviceState.commandSetpoint(controllerNumber, pressure, LogClock::monotonicNanoseconds() / 1000000);
+        mDirtySetpoints |= 1u << (controllerNumber - 1);
+        watchCommands();
+    }
+
+    mCommunicator->setPressure(controllerNumber, pressure);
+}
+
+/**
+ * @brief Update the GUI with new commands, and check regularly whether they are confirmed
+ */
+void ApplicationController::watchCommands()
+{
+    scheduleGuiUpdate();
+    if (!mConfirmationTimer.isActive())
+        mConfirmationTimer.start();
+}
+
+/**
+ * @brief Flag the commands that the device did not confirm in time
+ */
+void ApplicationController::expireCommands()
+{
+    qint64 now = LogClock::monotonicNanoseconds() / 1000000;
+
+    quint32 valves = mDeviceState.expireValveCommands(now, mConfirmationTimeout);
+    quint32 pumps = mDeviceState.expirePumpCommands(now, mConfirmationTimeout);
+    quint32 setpoints = mDeviceState.expireSetpointCommands(now, mConfirmationTimeout);
+
+    for (quint32 m = valves; m; m &= m - 1)
+        UFCS_WARNING(lcApplication) << "Valve" << qCountTrailingZeroBits(m) + 1 << "command was not confirmed by the device";
+    for (quint32 m = pumps; m; m &= m - 1)
+        UFCS_WARNING(lcApplication) << "Pump" << qCountTrailingZeroBits(m) + 1 << "command was not confirmed by the device";
+    for (quint32 m = setpoints; m; m &= m - 1)
+        UFCS_WARNING(lcApplication) << "Pressure controller" << qCountTrailingZeroBits(m) + 1
+                                    << "setpoint was not confirmed by the device";
+
+    if (valves | pumps | setpoints) {
+        mDirtyValves |= valves;
+        mDirtyPumps |= pumps;
+        mDirtySetpoints |= setpoints;
+        scheduleGuiUpdate();
+    }
+
+    if (!mDeviceState.hasPendingCommands())
+        mConfirmationTimer.stop();
+}
+
 void ApplicationController::onValveStateChanged(int valveNumber, bool open)
 {
-    qInfo() << "Valve" << valveNumber << (open ? "opened" : "closed");
+    if (valveNumber < 1 || valveNumber > N_VALVES)
+        return;
 
-    if (mQmlValveSwitches.contains(valveNumber)) {
-        for (auto v : mQmlValveSwitches[valveNumber])
-            v->setState(open);
+    // The microcontroller echoes every valve command, and sends the state of all valves on connection,
+    // so only actual changes are logged.
+    if (mDeviceState.setValveState(valveNumber, open)) {
+        StructuredLog::logEvent(QtInfoMsg, LogRecord::Application, LogRecord::ValveChanged, valveNumber, open,
+                                QString("Valve %1 %2").arg(valveNumber).arg(open ? "opened" : "closed"));
+        if (mExporter)
+            mExporter->recordValve(valveNumber, open);
     }
+
+    mDirtyValves |= 1u << (valveNumber - 1);
+    scheduleGuiUpdate();
 }
 
 void ApplicationController::onPumpStateChanged(int pumpNumber, bool on)
 {
-    qInfo() << "Pump" << pumpNumber << "switched" << (on ? "on" : "off");
+    if (pumpNumber < 1 || pumpNumber > N_PUMPS)
+        return;
+
+    mDeviceState.setPumpState(pumpNumber, on);
 
-    if (mQmlPumpSwitches.contains(pumpNumber))
-        mQmlPumpSwitches[pumpNumber]->setState(on);
+    StructuredLog::logEvent(QtInfoMsg, LogRecord::Application, LogRecord::PumpChanged, pumpNumber, on,
+                            QString("Pump %1 switched %2").arg(pumpNumber).arg(on ? "on" : "off"));
+    if (mExporter)
+        mExporter->recordPump(pumpNumber, on);
+
+    mDirtyPumps |= 1u << (pumpNumber - 1);
+    scheduleGuiUpdate();
 }
 
 void ApplicationController::onPressureChanged(int controllerNumber, double pressure)
 {
-    //qInfo() << "Measured pressure (normalized) on controller" << controllerNumber << ":" << pressure;
+    if (controllerNumber < 1 || controllerNumber > N_PRS)
+        return;
+
+    mDeviceState.setMeasuredPressure(controllerNumber, pressure);
+    double psi = mDeviceState.toPsi(controllerNumber, pressure);
+    mRoutineController->setMeasuredPressure(controllerNumber, psi);
+
+    mPressureSeries->append(controllerNumber, psi);
 
-    if (mQmlPressureControllers.contains(controllerNumber)) {
-        for (auto p : mQmlPressureControllers[controllerNumber])
-            p->setMeasuredValue(pressure);
+    if (mExporter)
+        mExporter->recordPressure(controllerNumber, psi);
+
+    if (mPressureRecorder) {
+        mPressureRecorder->setRange(controllerNumber, mDeviceState.minPressure(controllerNumber),
+                                    mDeviceState.maxPressure(controllerNumber));
+        mPressureRecorder->addSample(controllerNumber, pressure);
     }
+
+    // Measurements are received several times per second, so only a sample of them is logged
+    int suppressed = mPressureLogLimiters[controllerNumber - 1].tryAcquire();
+    if (suppressed >= 0)
+        StructuredLog::logEvent(QtDebugMsg, LogRecord::Application, LogRecord::PressureMeasured, controllerNumber, psi,
+                                QString("Measured pressure on controller %1: %2 PSI").arg(controllerNumber).arg(psi));
+
+    mDirtyMeasuredPressures |= 1u << (controllerNumber - 1);
+    scheduleGuiUpdate();
 }
 
 void ApplicationController::onPressureSetpointChanged(int controllerNumber, double pressure)
 {
-    if (mQmlPressureControllers.contains(controllerNumber)) {
-        for (auto p : mQmlPressureControllers[controllerNumber])
-            p->setSetPoint(pressure);
-    }
+    if (controllerNumber < 1 || controllerNumber > N_PRS)
+        return;
+
+    mDeviceState.setSetpoint(controllerNumber, pressure);
+    double psi = mDeviceState.toPsi(controllerNumber, pressure);
+    StructuredLog::logEvent(QtDebugMsg, LogRecord::Application, LogRecord::PressureSetpointChanged, controllerNumber, psi,
+                            QString("Pressure controller %1 setpoint changed to %2 PSI").arg(controllerNumber).arg(psi));
+
+    mPressureSeries->setSetpoint(controllerNumber, psi);
+
+    if (mExporter)
+        mExporter->recordSetpoint(controllerNumber, psi);
+
+    if (mPressureRecorder)
+        mPressureRecorder->setSetpoint(controllerNumber, pressure);
+
+    mDirtySetpoints |= 1u << (controllerNumber - 1);
+    scheduleGuiUpdate();
 }
 
 void ApplicationController::onUptimeChanged(ulong seconds)
@@ -402,15 +810,95 @@ void ApplicationController::onUptimeChanged(ulong seconds)
     int h = seconds/3600;
     int m = (seconds % 3600)/60;
     int s = seconds % 60;
-    qInfo() << "Current uptime:" << h << "h" << m << "min" << s << "s";
+    UFCS_INFO(lcApplication) << "Current uptime:" << h << "h" << m << "min" << s << "s";
+}
+
+/**
+ * @brief Use the capabilities reported by the device, and cache them for the next time the application starts
+ */
+void ApplicationController::onCapabilitiesReceived(DeviceCapabilities capabilities)
+{
+    UFCS_INFO(lcApplication) << "Device" << capabilities.deviceId << "- firmware version" << capabilities.firmwareVersion
+                             << "-" << capabilities.valveCount << "valves," << capabilities.pumpCount << "pumps,"
+                             << capabilities.controllerCount << "pressure controllers";
+
+    mDeviceState.setCapabilities(capabilities);
+    updatePressureSteps();
+
+    if (!capabilities.deviceId.isEmpty()) {
+        QString key = settingsKey(capabilities.deviceId);
+
+        QString group = "devices/" + key + "/";
+
+        mSettings->setValue("devices/lastDevice", key);
+        mSettings->setValue(group + "valveCount", capabilities.valveCount);
+        mSettings->setValue(group + "pumpCount", capabilities.pumpCount);
+        mSettings->setValue(group + "controllerCount", capabilities.controllerCount);
+        mSettings->setValue(group + "firmwareVersion", capabilities.firmwareVersion);
+        for (int i(0); i < capabilities.controllerCount; ++i) {
+            mSettings->setValue(group + QString("minPressure%1").arg(i + 1), capabilities.minPressure[i]);
+            mSettings->setValue(group + QString("maxPressure%1").arg(i + 1), capabilities.maxPressure[i]);
+        }
+    }
+
+    emit deviceCapabilitiesChanged();
+}
+
+/**
+ * @brief Return the resolution of pressures exchanged with the device, which depends on the protocol version
+ */
+int ApplicationController::pressureSteps() const
+{
+    return mCommunicator->protocolVersion() >= 2 ? PR_MAX_VALUE_V2 : PR_MAX_VALUE;
+}
+
+void ApplicationController::updatePressureSteps()
+{
+    if (mDeviceState.setPressureSteps(pressureSteps())) {
+        mDirtyMeasuredPressures = ~0u;
+        scheduleGuiUpdate();
+    }
 }
 
 void ApplicationController::onCommunicatorStatusChanged(Communicator::ConnectionStatus newStatus)
 {
-    qDebug() << "App controller: communicator status changed to" << mCommunicator->getConnectionStatusString();
+    UFCS_DEBUG(lcApplication) << "App controller: communicator status changed to"
+                              << mCommunicator->getConnectionStatusString();
 
-    if (newStatus == Communicator::Connected)
+    if (newStatus == Communicator::Connected) {
+        StartupProfile::mark("Connected");
+        mCommunicator->requestCapabilities();
         mCommunicator->requestStatus();
+    }
+    else if (newStatus == Communicator::Disconnected)
+        updatePressureSteps();
 
     emit connectionStatusChanged(mCommunicator->getConnectionStatusString());
 }
+
+/**
+ * @brief Update the GUI elements of all components that changed since the last update, within the next frame
+ */
+void ApplicationController::scheduleGuiUpdate()
+{
+    if (!mGuiUpdateTimer.isActive())
+        mGuiUpdateTimer.start();
+}
+
+/**
+ * @brief Notify the GUI of the components that changed since the last update
+ */
+void ApplicationController::updateGui()
+{
+    quint32 valves = mDirtyValves;
+    quint32 pumps = mDirtyPumps;
+    quint32 setpoints = mDirtySetpoints;
+    quint32 measuredPressures = mDirtyMeasuredPressures;
+
+    mDirtyValves = 0;
+    mDirtyPumps = 0;
+    mDirtySetpoints = 0;
+    mDirtyMeasuredPressures = 0;
+
+    mDeviceState.notifyChanged(valves, pumps, setpoints, measuredPressures);
+}
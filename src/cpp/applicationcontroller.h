@@ -3,11 +3,20 @@
 
 #include <QObject>
 #include <QQmlEngine>
+#include <QTimer>
 
 #include "bluetoothcommunicator.h"
 #include "serialcommunicator.h"
 
 #include "routinecontroller.h"
+#include "multiplexer.h"
+#include "logmodel.h"
+#include "logging.h"
+#include "pressurerecorder.h"
+#include "pressuretimeseries.h"
+#include "experimentexporter.h"
+#include "devicestate.h"
+#include "settingscache.h"
 
 /*
  * ApplicationController is the backend of the application. Either the brains of the operation or middle management,
@@ -15,22 +24,34 @@
  *
  * It relays commands between the user interface and the serial communicator, saves and loads settings, etc.
  *
- * To be able to update GUI elements based on information received from the microcontroller, AC has QMaps of
- * components, with a label (the valve number, for example) referring to a pointer to a GUI Helper object.
- * These are the backend of the controls (valve switches, pump switches and pressure controllers) shown in the GUI.
+ * The last known state of the device is held in a DeviceState, along with the device's capabilities (number of
+ * components and pressure ranges), which the device reports on connection and AC caches in the settings.
+ *
+ * The DeviceState is exposed to QML (Backend.deviceState), and the controls shown in the GUI (valve switches, pump
+ * switches and pressure controllers) read the state of their component from it by number, through GUI helper objects
+ * (see guihelper.h). The microcontroller reports the state of many components at once (e.g. all valves, in reply to a
+ * status request), so the GUI is not notified immediately: the components that changed are marked in bitsets, and
+ * DeviceState::changed() is emitted for all of them together at most once per display frame (see
+ * GUI_UPDATE_INTERVAL), so that a burst of changes costs a single repaint. Commands sent to the device are shown in the
+ * GUI immediately, as pending until the device confirms them (see DeviceState).
+ *
+ * AC also holds the multiplexer definitions (see Multiplexer), which are used both by the multiplexer controls in
+ * the GUI and by RoutineController, and the model of recent log messages shown in the GUI (see LogModel). Measured
+ * pressures are kept in memory for the live charts (see PressureTimeSeries), and recorded to disk by a
+ * PressureRecorder, unless disabled in the settings. Routine runs are exported along with the device state by an
+ * ExperimentExporter.
  *
  * */
 
-class PCHelper;
-class ValveSwitchHelper;
-class PumpSwitchHelper;
-
 class ApplicationController : public QObject
 {
     Q_OBJECT
 
     Q_PROPERTY(QString connectionStatus READ connectionStatus NOTIFY connectionStatusChanged)
-    Q_PROPERTY(QVariantList logMessageList READ log NOTIFY newLogMessage)
+    Q_PROPERTY(LogModel* logModel READ logModel CONSTANT)
+    Q_PROPERTY(PressureTimeSeries* pressureSeries READ pressureSeries CONSTANT)
+    Q_PROPERTY(DeviceState* deviceState READ deviceState CONSTANT)
+    Q_PROPERTY(int logCapacity READ logCapacity WRITE setLogCapacity)
     Q_PROPERTY(QString appVersion READ appVersion)
     Q_PROPERTY(bool darkMode READ isDarkModeEnabled WRITE setDarkModeEnabled NOTIFY darkModeChanged)
     Q_PROPERTY(int windowWidth READ windowWidth WRITE setWindowWidth NOTIFY windowWidthChanged)
@@ -39,31 +60,42 @@ class ApplicationController : public QObject
     Q_PROPERTY(int baudRate READ serialBaudRate WRITE setSerialBaudRate)
     Q_PROPERTY(bool bluetoothEnabled READ isBluetoothEnabled CONSTANT)
     Q_PROPERTY(bool denseThemeEnabled READ isDenseThemeEnabled WRITE setDenseThemeEnabled NOTIFY denseThemeChanged)
+    Q_PROPERTY(bool binaryLogEnabled READ isBinaryLogEnabled WRITE setBinaryLogEnabled)
+    Q_PROPERTY(bool pressureHistoryEnabled READ isPressureHistoryEnabled WRITE setPressureHistoryEnabled)
+    Q_PROPERTY(bool exportEnabled READ isExportEnabled WRITE setExportEnabled)
+    Q_PROPERTY(QString exportDirectory READ exportDirectory CONSTANT)
+    Q_PROPERTY(QString firmwareVersion READ firmwareVersion NOTIFY deviceCapabilitiesChanged)
 
 
 public:
     ApplicationController(QObject *parent = nullptr);
     virtual ~ApplicationController();
 
+    void shutdown();
+
     Q_INVOKABLE void connect();
     Q_INVOKABLE void requestRefresh() { mCommunicator->requestStatus(); }
 
-    int nValves();
-    int nPumps();
-    int nPressureControllers();
-    double minPressure(int controllerNumber);
-    double maxPressure(int controllerNumber);
+    virtual int nValves();
+    virtual int nPumps();
+    virtual int nPressureControllers();
+    virtual double minPressure(int controllerNumber);
+    virtual double maxPressure(int controllerNumber);
 
     QString appVersion() { return GIT_VERSION; }
-    QString connectionStatus();
 
-    Q_INVOKABLE void registerPCHelper(int controllerNumber, PCHelper* instance);
-    Q_INVOKABLE void registerValveSwitchHelper(int valveNumber, ValveSwitchHelper* instance);
-    Q_INVOKABLE void registerPumpSwitchHelper(int pumpNumber, PumpSwitchHelper* instance);
+    Q_INVOKABLE QVariantList startupPhases();
+    Q_INVOKABLE void recordScreenLoad(QString const& screen, double duration);
+
+    QString firmwareVersion();
+    QString connectionStatus();
 
     RoutineController* routineController() { return mRoutineController; }
+    DeviceState* deviceState() { return &mDeviceState; }
+    PressureRecorder* pressureRecorder() { return mPressureRecorder; }
+    PressureTimeSeries* pressureSeries() { return mPressureSeries; }
 
-    QVariantList log() { return mLog; }
+    LogModel* logModel() { return mLogModel; }
 
     bool isBluetoothEnabled() { return mBluetoothEnabled; }
 
@@ -95,24 +127,55 @@ public:
     Q_INVOKABLE void setCurrentGraphicalControlScreen(QString label);
     Q_INVOKABLE QUrl currentGraphicalControlScreenURL();
 
+    Q_INVOKABLE QStringList multiplexerChannels(QString multiplexerName);
+    Q_INVOKABLE bool setMultiplexer(QString multiplexerName, QString channelLabel);
+    const Multiplexer* multiplexer(QString const& name) const;
+    virtual const Multiplexer* routineMultiplexer(bool inputMultiplexer);
+
     uint serialBaudRate();
     void setSerialBaudRate(int rate);
 
-    QSettings* settings() { return mSettings; }
+    int logCapacity();
+    void setLogCapacity(int capacity);
+
+    bool isBinaryLogEnabled();
+    void setBinaryLogEnabled(bool enabled);
+
+    bool isPressureHistoryEnabled();
+    void setPressureHistoryEnabled(bool enabled);
+
+    bool isExportEnabled();
+    void setExportEnabled(bool enabled);
+    QString exportDirectory();
+
+    SettingsCache* settings() { return mSettings; }
+
+#ifdef TESTING
+    void setCommunicator(Communicator* communicator);
+#endif
 
 public slots:
-    void setValve(uint valveNumber, bool open) { mCommunicator->setValve(valveNumber, open); }
-    void setPump(uint pumpNumber, bool on) { mCommunicator->setPump(pumpNumber, on); }
-    void setPressure(uint controllerNumber, double pressure) { mCommunicator->setPressure(controllerNumber, pressure); }
-    void addToLog(QVariant entry);
+    void setValve(uint valveNumber, bool open);
+    void setValves(quint32 openMask, quint32 closeMask);
+    void setPump(uint pumpNumber, bool on);
+    void setPressure(uint controllerNumber, double pressure);
+
+    /// Minimum time between GUI updates, in ms (one frame at 60 Hz)
+    static const int GUI_UPDATE_INTERVAL = 16;
+
+    /// How often commands waiting for confirmation are checked for timeouts, in ms
+    static const int CONFIRMATION_CHECK_INTERVAL = 250;
+
+    /// How often the pressure history is checked for chunks to write, in ms (see PressureRecorder::flushExpired)
+    static const int PRESSURE_FLUSH_INTERVAL = 5000;
 
 signals:
     void connectionStatusChanged(QString newStatus);
-    void newLogMessage(QVariant newMessage);
     void darkModeChanged(bool enabled);
     void denseThemeChanged(bool enabled);
     void windowWidthChanged(int width);
     void windowHeightChanged(int height);
+    void deviceCapabilitiesChanged();
 
 private slots:
     void onValveStateChanged(int valveNumber, bool open);
@@ -120,23 +183,62 @@ private slots:
     void onPressureChanged(int controllerNumber, double pressure);
     void onPressureSetpointChanged(int controllerNumber, double pressure);
     void onUptimeChanged(ulong seconds);
+    void onCapabilitiesReceived(DeviceCapabilities capabilities);
 
     void onCommunicatorStatusChanged(BluetoothCommunicator::ConnectionStatus newStatus);
 
+    void updateGui();
+    void expireCommands();
+
 private:
+    void connectCommunicator();
+    void scheduleGuiUpdate();
+    void watchCommands();
+    int pressureSteps() const;
+    void updatePressureSteps();
+    DeviceCapabilities cachedCapabilities(QString const& deviceKey);
+    static QString settingsKey(QString const& deviceId);
+
     /// True if the communicator uses bluetooth; false if USB
     bool mBluetoothEnabled;
 
     Communicator * mCommunicator;
     RoutineController * mRoutineController;
 
-    QMap<int, QList<PCHelper*> > mQmlPressureControllers;
-    QMap<int, QList<ValveSwitchHelper*> > mQmlValveSwitches;
-    QMap<int, PumpSwitchHelper*> mQmlPumpSwitches;
+    DeviceState mDeviceState;
+
+    /// Components whose GUI elements need to be updated (bit 0 corresponds to component number 1)
+    quint32 mDirtyValves;
+    quint32 mDirtyPumps;
+    quint32 mDirtyMeasuredPressures;
+    quint32 mDirtySetpoints;
+    QTimer mGuiUpdateTimer;
+
+    /// Commands that the device doesn't confirm within this time (in ms) are flagged as unconfirmed in the GUI
+    qint64 mConfirmationTimeout;
+    QTimer mConfirmationTimer;
+
+    /// Multiplexer definitions, with their names as keys
+    QMap<QString, Multiplexer> mMultiplexers;
+
+    /// The most recent log messages, for display in the GUI
+    LogModel* mLogModel;
+
+    /// Measured pressures are logged at a limited rate, for each controller
+    LogRateLimiter mPressureLogLimiters[N_PRS];
+
+    /// Pressure history, or nullptr if it is disabled
+    PressureRecorder* mPressureRecorder;
+    QTimer mPressureFlushTimer;
+
+    /// Recent pressure history, for the live charts
+    PressureTimeSeries* mPressureSeries;
 
-    QVariantList mLog;
+    /// Exports routine runs, or nullptr if it is disabled
+    ExperimentExporter* mExporter;
 
-    QSettings * mSettings;
+    /// Settings are read from memory, and written in the background
+    SettingsCache* mSettings;
 };
 
 #endif // APPLICATIONCONTROLLER_H
@@ -19,6 +19,17 @@ BluetoothCommunicator::~BluetoothCommunicator()
     // TODO: close and kill socket, if necessary
 }
 
+/**
+ * @brief Return the minimum time between two setpoints sent to the same controller, in ms
+ *
+ * The serial port profile delivers data in packets, with a latency of tens of milliseconds; setpoints sent faster
+ * than that would only queue up in the socket's buffers.
+ */
+int BluetoothCommunicator::setpointInterval() const
+{
+    return 50;
+}
+
 /**
  * @brief Connect to the ESP32, if it's available
  *
@@ -28,7 +39,7 @@ void BluetoothCommunicator::connect()
 {
     setConnectionStatus(Connecting);
 
-    QSettings* settings = appController->settings();
+    SettingsCache* settings = appController->settings();
 
     if (settings->contains("controllerUuid") && settings->contains("controllerAddress")
             && !mFailedToConnectToSavedDevice)
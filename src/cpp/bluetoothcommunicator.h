@@ -30,6 +30,8 @@ public:
     BluetoothCommunicator(ApplicationController* applicationController);
     ~BluetoothCommunicator();
 
+    int setpointInterval() const;
+
 public slots:
     void connect();
     void connect(const QBluetoothServiceInfo &serviceInfo);
@@ -1,11 +1,25 @@
 #include "communicator.h"
 #include "applicationcontroller.h"
+#include "logging.h"
+
+#include <limits>
 
 
 Communicator::Communicator(ApplicationController* applicationController)
     : mConnectionStatus(Disconnected)
+    , mProtocolVersion(1)
     , appController(applicationController)
+    , mPendingSetpointMask(0)
+    , mPendingSetpoints()
+    , mCoalescedSetpoints(0)
 {
+    // Long enough ago for the first setpoints to be sent right away, whatever the interval
+    for (qint64& t : mLastSetpointTimes)
+        t = std::numeric_limits<qint64>::min() / 2;
+    mClock.start();
+
+    mSetpointTimer.setSingleShot(true);
+    QObject::connect(&mSetpointTimer, &QTimer::timeout, this, &Communicator::sendPendingSetpoints);
 }
 
 Communicator::~Communicator()
@@ -41,16 +55,36 @@ QString Communicator::getConnectionStatusString() const
  */
 void Communicator::setValve(uint valveNumber, bool open)
 {
-    qDebug() << "Communicator: setting valve" << valveNumber << (open ? "open" : "closed");
+    UFCS_DEBUG(lcCommunicator) << "Communicator: setting valve" << valveNumber << (open ? "open" : "closed");
 
-    QByteArray message;
-    message.push_back(VALVE);
-    message.push_back(1);
-    message.push_back((uint8_t)valveNumber);
-    message.push_back(1);
-    message.push_back((uint8_t)open);
+    flushPendingSetpoints();
+    sendMessage(valveMessage(valveNumber, open));
+}
 
-    sendMessage(frameMessage(message));
+/**
+ * @brief Open and/or close several valves at once
+ * @param openMask The valves to open. Bit 0 corresponds to valve 1, bit 1 to valve 2, etc.
+ * @param closeMask The valves to close, using the same convention as openMask
+ *
+ * Valves that are in neither mask are left untouched. One VALVE command is generated per valve,
+ * but all of them are sent to the microcontroller in a single write.
+ */
+void Communicator::setValves(quint32 openMask, quint32 closeMask)
+{
+    UFCS_DEBUG(lcCommunicator) << "Communicator: setting valves. Open:" << QString::number(openMask, 2)
+             << "closed:" << QString::number(closeMask, 2);
+
+    QByteArray messages;
+    for (uint i(0); i < N_VALVES; ++i) {
+        quint32 bit = 1u << i;
+        if ((openMask | closeMask) & bit)
+            messages.append(valveMessage(i + 1, (openMask & bit) != 0));
+    }
+
+    if (!messages.isEmpty()) {
+        flushPendingSetpoints();
+        sendMessage(messages);
+    }
 }
 
 /**
@@ -60,7 +94,7 @@ void Communicator::setValve(uint valveNumber, bool open)
  */
 void Communicator::setPump(uint pumpNumber, bool on)
 {
-    qDebug() << "Communicator: setting pump" << pumpNumber << (on ? "on" : "off");
+    UFCS_DEBUG(lcCommunicator) << "Communicator: setting pump" << pumpNumber << (on ? "on" : "off");
 
     QByteArray message;
     message.push_back(PUMP);
@@ -69,6 +103,7 @@ void Communicator::setPump(uint pumpNumber, bool on)
     message.push_back(1);
     message.push_back((uint8_t)on);
 
+    flushPendingSetpoints();
     sendMessage(frameMessage(message));
 }
 
@@ -76,23 +111,110 @@ void Communicator::setPump(uint pumpNumber, bool on)
  * @brief Set the pressure setpoint of a given controller
  * @param controllerNumber The controller number
  * @param pressure A double between 0 and 1.0, with 0 being the minimum and 1 being the maximum pressures allowed by the controller
+ *
+ * If a setpoint was sent to this controller less than setpointInterval() ms ago, this one is sent when the interval
+ * has elapsed, unless a newer one replaces it by then.
  */
 void Communicator::setPressure(uint controllerNumber, double pressure)
 {
-    qDebug() << "Communicator: setting pressure controller" << controllerNumber << " to " << pressure;
+    UFCS_DEBUG(lcCommunicator) << "Communicator: setting pressure controller" << controllerNumber << " to " << pressure;
 
     if (pressure < 0. || pressure > 1.) {
-        qWarning() << "Pressure invalid. Must be between 0 and 1.";
+        UFCS_WARNING(lcCommunicator) << "Pressure invalid. Must be between 0 and 1.";
+        return;
+    }
+
+    // Invalid controller numbers are passed on as is; the microcontroller reports the error
+    if (controllerNumber < 1 || controllerNumber > N_PRS) {
+        sendSetpoint(controllerNumber, pressure);
         return;
     }
-    uint8_t sp = pressure*PR_MAX_VALUE;
 
+    int i = controllerNumber - 1;
+    quint32 bit = 1u << i;
+    qint64 wait = mLastSetpointTimes[i] + setpointInterval() - mClock.elapsed();
+
+    if (!(mPendingSetpointMask & bit) && wait <= 0) {
+        sendSetpoint(controllerNumber, pressure);
+        mLastSetpointTimes[i] = mClock.elapsed();
+        return;
+    }
+
+    if (mPendingSetpointMask & bit)
+        mCoalescedSetpoints++;
+
+    mPendingSetpoints[i] = pressure;
+    mPendingSetpointMask |= bit;
+
+    if (!mSetpointTimer.isActive() || mSetpointTimer.remainingTime() > wait)
+        mSetpointTimer.start(int(qMax<qint64>(0, wait)));
+}
+
+/**
+ * @brief Send the setpoints that have waited for setpointInterval(), and schedule the others
+ */
+void Communicator::sendPendingSetpoints()
+{
+    qint64 now = mClock.elapsed();
+    qint64 nextWait = -1;
+
+    for (quint32 m = mPendingSetpointMask; m; m &= m - 1) {
+        int i = qCountTrailingZeroBits(m);
+        qint64 wait = mLastSetpointTimes[i] + setpointInterval() - now;
+
+        if (wait <= 0) {
+            mPendingSetpointMask &= ~(1u << i);
+            sendSetpoint(i + 1, mPendingSetpoints[i]);
+            mLastSetpointTimes[i] = now;
+        }
+        else if (nextWait < 0 || wait < nextWait)
+            nextWait = wait;
+    }
+
+    if (nextWait >= 0)
+        mSetpointTimer.start(int(nextWait));
+}
+
+/**
+ * @brief Send all waiting setpoints now, e.g. before another command, to preserve the order of commands
+ */
+void Communicator::flushPendingSetpoints()
+{
+    if (!mPendingSetpointMask)
+        return;
+
+    qint64 now = mClock.elapsed();
+    for (quint32 m = mPendingSetpointMask; m; m &= m - 1) {
+        int i = qCountTrailingZeroBits(m);
+        sendSetpoint(i + 1, mPendingSetpoints[i]);
+        mLastSetpointTimes[i] = now;
+    }
+
+    mPendingSetpointMask = 0;
+    mSetpointTimer.stop();
+}
+
+/**
+ * @brief Build and send a PRESSURE command
+ */
+void Communicator::sendSetpoint(uint controllerNumber, double pressure)
+{
     QByteArray message;
     message.push_back(PRESSURE);
     message.push_back(1);
     message.push_back((uint8_t)controllerNumber);
-    message.push_back(1);
-    message.push_back(sp);
+
+    if (mProtocolVersion >= 2) {
+        quint16 sp = qRound(pressure*PR_MAX_VALUE_V2);
+        message.push_back(2);
+        message.push_back(uint8_t(sp >> 8));
+        message.push_back(uint8_t(sp));
+    }
+    else {
+        uint8_t sp = pressure*PR_MAX_VALUE;
+        message.push_back(1);
+        message.push_back(sp);
+    }
 
     sendMessage(frameMessage(message));
 }
@@ -102,12 +224,27 @@ void Communicator::setPressure(uint controllerNumber, double pressure)
  */
 void Communicator::requestStatus()
 {
-    qDebug() << "Communicator: requesting status of all components";
+    UFCS_DEBUG(lcCommunicator) << "Communicator: requesting status of all components";
     QByteArray message;
     message.push_back(STATUS);
     sendMessage(frameMessage(message));
 }
 
+/**
+ * @brief Request the capabilities of the device: number of components, pressure ranges and firmware version
+ *
+ * The request also offers the latest protocol version supported by the application; see the class description.
+ */
+void Communicator::requestCapabilities()
+{
+    UFCS_DEBUG(lcCommunicator) << "Communicator: requesting device capabilities";
+    QByteArray message;
+    message.push_back(CAPABILITIES);
+    message.push_back(1);
+    message.push_back(PROTOCOL_VERSION);
+    sendMessage(frameMessage(message));
+}
+
 /**
  * @brief Frame a message, i.e. add start and stop bytes, and escapes
  * @param message The message to be framed
@@ -128,35 +265,118 @@ QByteArray Communicator::frameMessage(QByteArray message)
     return framedMessage;
 }
 
+/**
+ * @brief Build a (framed) VALVE command
+ * @param valveNumber The valve number
+ * @param open If true, the valve is to be opened; otherwise, it is to be closed
+ */
+QByteArray Communicator::valveMessage(uint valveNumber, bool open)
+{
+    QByteArray message;
+    message.push_back(VALVE);
+    message.push_back(1);
+    message.push_back((uint8_t)valveNumber);
+    message.push_back(1);
+    message.push_back((uint8_t)open);
+
+    return frameMessage(message);
+}
+
 /**
  * @brief Display a log message received from the microcontroller
  * @param level How bad it is
  * @param message The message that was received
  *
- * The message is passed to qCritical, qWarning etc. based on its level
+ * The message is logged in the lcMicrocontroller category, with the corresponding level
  */
 void Communicator::logMicrocontrollerMessage(LogLevel level, const QByteArray &message)
 {
     switch (level) {
         case LOG_FATAL:
         case LOG_ERROR:
-            qCritical().noquote() << "Microcontroller: " << message;
+            UFCS_CRITICAL(lcMicrocontroller).noquote() << "Microcontroller: " << message;
             break;
         case LOG_WARNING:
-            qWarning().noquote() << "Microcontroller: " << message;
+            UFCS_WARNING(lcMicrocontroller).noquote() << "Microcontroller: " << message;
             break;
         case LOG_INFO:
-            qInfo().noquote() << "Microcontroller: " << message;
+            UFCS_INFO(lcMicrocontroller).noquote() << "Microcontroller: " << message;
             break;
         case LOG_DEBUG:
-            qDebug().noquote() << "Microcontroller: " << message;
+            UFCS_DEBUG(lcMicrocontroller).noquote() << "Microcontroller: " << message;
             break;
         default:
-            qDebug().noquote() << "Message from microcontroller with unknown level:" << message;
+            UFCS_DEBUG(lcMicrocontroller).noquote() << "Message from microcontroller with unknown level:" << message;
             break;
     }
 }
 
+/**
+ * @brief Decode the parameters of a CAPABILITIES command
+ * @return False if the parameters are invalid
+ *
+ * The parameters are: the number of valves, pumps and pressure controllers (one byte each), the firmware version and
+ * the device identifier (strings), then one 8-byte parameter per pressure controller with its minimum and maximum
+ * pressures, in thousandths of PSI (signed 32-bit, most significant byte first, like UPTIME). Devices that support
+ * protocol version 2 add the version they chose (one byte); it is 1 otherwise.
+ */
+bool Communicator::parseCapabilities(const QList<QByteArray> &parameters, DeviceCapabilities &capabilities)
+{
+    if (parameters.size() < 5 || parameters[0].length() != 1 || parameters[1].length() != 1 || parameters[2].length() != 1)
+        return false;
+
+    capabilities.valveCount = uint8_t(parameters[0][0]);
+    capabilities.pumpCount = uint8_t(parameters[1][0]);
+    capabilities.controllerCount = uint8_t(parameters[2][0]);
+    capabilities.firmwareVersion = QString::fromUtf8(parameters[3]);
+    capabilities.deviceId = QString::fromUtf8(parameters[4]);
+
+    if (capabilities.valveCount > N_VALVES || capabilities.pumpCount > N_PUMPS || capabilities.controllerCount > N_PRS) {
+        UFCS_WARNING(lcCommunicator) << "Device has more components than supported:" << capabilities.valveCount
+                                     << "valves," << capabilities.pumpCount << "pumps,"
+                                     << capabilities.controllerCount << "pressure controllers";
+        capabilities.valveCount = qMin(capabilities.valveCount, N_VALVES);
+        capabilities.pumpCount = qMin(capabilities.pumpCount, N_PUMPS);
+        capabilities.controllerCount = qMin(capabilities.controllerCount, N_PRS);
+    }
+
+    int nRanges = uint8_t(parameters[2][0]);
+    if (parameters.size() != 5 + nRanges && parameters.size() != 6 + nRanges)
+        return false;
+
+    if (parameters.size() == 6 + nRanges) {
+        if (parameters.last().length() != 1 || uint8_t(parameters.last()[0]) < 1)
+            return false;
+        capabilities.protocolVersion = qMin(int(uint8_t(parameters.last()[0])), PROTOCOL_VERSION);
+    }
+
+    for (int i(0); i < capabilities.controllerCount; ++i) {
+        QByteArray const& range = parameters[5 + i];
+        if (range.length() != 8)
+            return false;
+
+        auto int32 = [&range](int offset) {
+            return qint32(quint32(uint8_t(range[offset])) << 24 | quint32(uint8_t(range[offset + 1])) << 16
+                          | quint32(uint8_t(range[offset + 2])) << 8 | quint32(uint8_t(range[offset + 3])));
+        };
+        capabilities.minPressure[i] = int32(0) / 1000.;
+        capabilities.maxPressure[i] = int32(4) / 1000.;
+
+        if (capabilities.maxPressure[i] <= capabilities.minPressure[i])
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Decode a 16-bit value (most significant byte first) starting at offset
+ */
+quint16 Communicator::uint16(const QByteArray &data, int offset)
+{
+    return quint16(uint8_t(data[offset]) << 8 | uint8_t(data[offset + 1]));
+}
+
 /**
  * @brief Parse the buffer to remove escape characters, start and stop bytes
  * @returns The first valid message found (or an empty QByteArray if no valid message is found)
@@ -236,7 +456,7 @@ void Communicator::parseDecodedBuffer(QByteArray buffer)
     // With one or more parameters.
 
     if (buffer.size() < 2) {
-        qWarning() << "parseDecodedBuffer called when the buffer is too short to contain a message";
+        UFCS_WARNING(lcCommunicator) << "parseDecodedBuffer called when the buffer is too short to contain a message";
         return;
     }
 
@@ -256,7 +476,7 @@ void Communicator::parseDecodedBuffer(QByteArray buffer)
                 parameters.push_back(paramData);
             }
             else {
-                qWarning() << "Command parameter incomplete; ignoring command";
+                LOG_RATE_LIMITED(UFCS_WARNING(lcCommunicator), 1, 5) << "Command parameter incomplete; ignoring command";
                 return;
             }
             i += paramSize;
@@ -264,7 +484,7 @@ void Communicator::parseDecodedBuffer(QByteArray buffer)
         handleCommand(command, parameters);
     }
     else
-        qDebug() << "Unknown command received. Full buffer: " << buffer;
+        LOG_RATE_LIMITED(UFCS_DEBUG(lcCommunicator), 1, 5) << "Unknown command received. Full buffer: " << buffer;
 }
 
 /**
@@ -284,9 +504,9 @@ void Communicator::handleCommand(uint8_t command, QList<QByteArray> parameters)
             // Should have 2 one-byte parameters: valve number and valve state.
             // State is 0 (closed) or 1 (open)
             if (nParameters != 2)
-                qWarning() << "Invalid number of parameters for VALVE command:" << nParameters;
+                UFCS_WARNING(lcCommunicator) << "Invalid number of parameters for VALVE command:" << nParameters;
             else if (parameters[0].length() != 1 || parameters[1].length() != 1)
-                qWarning() << "Invalid parameter sizes for VALVE command";
+                UFCS_WARNING(lcCommunicator) << "Invalid parameter sizes for VALVE command";
             else
                 emit valveStateChanged((uint8_t)parameters[0][0], (bool)parameters[1][0]);
             break;
@@ -294,35 +514,58 @@ void Communicator::handleCommand(uint8_t command, QList<QByteArray> parameters)
         case PUMP:
             // Should have 2 one-byte parameters: number and state (0 (off) or 1 (on))
             if (nParameters != 2)
-                qWarning() << "Invalid number of parameters for PUMP command:" << nParameters;
+                UFCS_WARNING(lcCommunicator) << "Invalid number of parameters for PUMP command:" << nParameters;
             else if (parameters[0].length() != 1 || parameters[1].length() != 1)
-                qWarning() << "Invalid parameter sizes for PUMP command";
+                UFCS_WARNING(lcCommunicator) << "Invalid parameter sizes for PUMP command";
             else
                 emit pumpStateChanged((uint8_t)parameters[0][0], (bool)parameters[1][0]);
             break;
 
         case PRESSURE:
-            // Should have 3 one-byte parameters: number, setpoint and measured value
+            // Should have 3 parameters: number (one byte), setpoint and measured value (one byte each in protocol
+            // version 1, two bytes each in version 2)
             if (nParameters != 3)
-                qWarning() << "Invalid number of parameters for PRESSURE command:" << nParameters;
-            else if (parameters[0].length() != 1 || parameters[1].length() != 1 || parameters[2].length() != 1)
-                qWarning() << "Invalid parameter sizes for PRESSURE command";
+                UFCS_WARNING(lcCommunicator) << "Invalid number of parameters for PRESSURE command:" << nParameters;
+            else if (parameters[0].length() != 1 || parameters[1].length() != parameters[2].length()
+                     || (parameters[1].length() != 1 && parameters[1].length() != 2))
+                UFCS_WARNING(lcCommunicator) << "Invalid parameter sizes for PRESSURE command";
             else {
                 uint8_t number = parameters[0][0];
-                uint8_t sp = parameters[1][0];
-                uint8_t pv = parameters[2][0];
 
-                emit pressureSetpointChanged(number, double(sp)/PR_MAX_VALUE);
-                emit pressureChanged(number, double(pv)/PR_MAX_VALUE);
+                if (parameters[1].length() == 1) {
+                    uint8_t sp = parameters[1][0];
+                    uint8_t pv = parameters[2][0];
+
+                    emit pressureSetpointChanged(number, double(sp)/PR_MAX_VALUE);
+                    emit pressureChanged(number, double(pv)/PR_MAX_VALUE);
+                }
+                else {
+                    emit pressureSetpointChanged(number, double(uint16(parameters[1], 0))/PR_MAX_VALUE_V2);
+                    emit pressureChanged(number, double(uint16(parameters[2], 0))/PR_MAX_VALUE_V2);
+                }
+            }
+            break;
+
+        case TELEMETRY:
+            // Protocol version 2. One parameter, with 5 bytes per controller: number, setpoint and measured value
+            if (nParameters != 1 || parameters[0].length() == 0 || parameters[0].length() % 5 != 0)
+                UFCS_WARNING(lcCommunicator) << "Invalid parameters for TELEMETRY command";
+            else {
+                QByteArray const& data = parameters[0];
+                for (int i(0); i < data.length(); i += 5) {
+                    uint8_t number = data[i];
+                    emit pressureSetpointChanged(number, double(uint16(data, i + 1))/PR_MAX_VALUE_V2);
+                    emit pressureChanged(number, double(uint16(data, i + 3))/PR_MAX_VALUE_V2);
+                }
             }
             break;
 
         case UPTIME:
             // Should have one 4-byte parameter
             if (nParameters != 1)
-                qWarning() << "Invalid number of parameters for UPTIME command:" << nParameters;
+                UFCS_WARNING(lcCommunicator) << "Invalid number of parameters for UPTIME command:" << nParameters;
             else if (parameters[0].length() != 4)
-                qWarning() << "Invalid parameter size for UPTIME command";
+                UFCS_WARNING(lcCommunicator) << "Invalid parameter size for UPTIME command";
             else {
                 uint8_t value0 = parameters[0][0];
                 uint8_t value1 = parameters[0][1];
@@ -335,17 +578,32 @@ void Communicator::handleCommand(uint8_t command, QList<QByteArray> parameters)
             break;
 
         case ERROR:
-            qDebug() << "Error received";
+            UFCS_DEBUG(lcCommunicator) << "Error received";
             break;
 
         case LOG:
             if (nParameters != 2)
-                qWarning() << "Invalid number of parameters for LOG command" << nParameters;
+                UFCS_WARNING(lcCommunicator) << "Invalid number of parameters for LOG command" << nParameters;
             else
                 logMicrocontrollerMessage(LogLevel((uint8_t)parameters[0][0]), parameters[1]);
             break;
+
+        case CAPABILITIES:
+        {
+            DeviceCapabilities capabilities;
+            if (parseCapabilities(parameters, capabilities)) {
+                if (capabilities.protocolVersion != mProtocolVersion)
+                    UFCS_INFO(lcCommunicator) << "Using protocol version" << capabilities.protocolVersion;
+                mProtocolVersion = capabilities.protocolVersion;
+                emit capabilitiesReceived(capabilities);
+            }
+            else
+                UFCS_WARNING(lcCommunicator) << "Invalid parameters for CAPABILITIES command";
+            break;
+        }
+
         default:
-            qWarning() << "Unknown command received:" << int(command);
+            UFCS_WARNING(lcCommunicator) << "Unknown command received:" << int(command);
             break;
     }
 
@@ -356,6 +614,13 @@ void Communicator::handleCommand(uint8_t command, QList<QByteArray> parameters)
 void Communicator::setConnectionStatus(ConnectionStatus status)
 {
     if (status != mConnectionStatus) {
+        // Setpoints given while connected are not sent to a device connected later
+        if (status == Disconnected) {
+            mPendingSetpointMask = 0;
+            mSetpointTimer.stop();
+            mProtocolVersion = 1;
+        }
+
         mConnectionStatus = status;
         emit connectionStatusChanged(status);
     }
@@ -4,6 +4,7 @@
 #include <QtCore>
 
 #include "constants.h"
+#include "devicestate.h"
 
 class ApplicationController;
 
@@ -20,8 +21,8 @@ class ApplicationController;
  * functions, or better, by connecting to the connectionStatusChanged signal.
  *
  * The interface to the actual functionality of the microcontroller is provided by the setValve,
- * setPump, setPressure, and requestStatus functions.
- * The first three tell the microcontroller to do something, e.g toggle a valve, while the
+ * setValves, setPump, setPressure, and requestStatus functions.
+ * The first four tell the microcontroller to do something, e.g toggle a valve, while the
  * requestStatus function requests an update of all components' statuses.
  *
  * The signals valveStateChanged, pumpStateChanged, pressureChanged and pressureSetpointChanged
@@ -29,7 +30,16 @@ class ApplicationController;
  * Connect to these to know the current status of the hardware.
  *
  * In order to know how many components are available, and what pressures are supported by the pressure controllers,
- * use the nValves, nPumps, nPressureControllers, minPressure and maxPressure functions.
+ * call requestCapabilities(); the reply is passed on by the capabilitiesReceived signal. Firmware that predates the
+ * CAPABILITIES command does not reply, in which case the values in constants.h apply (see DeviceCapabilities).
+ * ApplicationController caches the capabilities of each device, and exposes them through the nValves, nPumps,
+ * nPressureControllers, minPressure and maxPressure functions.
+ *
+ * Setpoints are sent at most once every setpointInterval() ms per controller, so that dragging a slider (which calls
+ * setPressure for every intermediate value) doesn't build up a backlog on the link. A setpoint that arrives sooner is
+ * held back, replacing any setpoint already waiting for that controller, and sent once the interval has elapsed: only
+ * the latest value is kept, and it is always delivered. Waiting setpoints are sent before any other command, so that
+ * commands reach the microcontroller in the order they were given.
  *
  * Valves, pumps and pressure controllers are 1-indexed. I.e valveNumber will be between 1 and 32;
  * pumpNumber between 1 and 2; controllerNumber between 1 and 3.
@@ -40,6 +50,16 @@ class ApplicationController;
  *
  * Param size and param data can be repeated if the command needs several parameters.
  *
+ * Two versions of the protocol exist; they differ only in how pressures are encoded. In version 1, pressures are one
+ * byte (0 to PR_MAX_VALUE), and the device sends one PRESSURE command per controller. In version 2, pressures are
+ * 16-bit (0 to PR_MAX_VALUE_V2, most significant byte first) in PRESSURE commands, and the device reports all of its
+ * controllers in a single TELEMETRY command, whose only parameter holds 5 bytes per controller: number, setpoint and
+ * measured value. PRESSURE commands received from the device are decoded according to the size of their parameters.
+ *
+ * The version is negotiated when the capabilities are requested: the host sends the latest version it supports
+ * (PROTOCOL_VERSION) as a parameter of CAPABILITIES, and the device replies with the version it will use. Until then,
+ * or if the device doesn't say (firmware that predates version 2), version 1 is used.
+ *
  * On the decoding side, messages are received by whatever mechanism the subclasses
  * (Serial/BluetoothCommunicator) uses; they are added to mBuffer, then the following methods
  * are called: decodeBuffer -> parseDecodedBuffer -> handleCommand.
@@ -61,14 +81,26 @@ public:
 
     ConnectionStatus getConnectionStatus() const;
     QString getConnectionStatusString() const;
+    int protocolVersion() const { return mProtocolVersion; }
+
+    /// Default minimum time between two setpoints sent to the same pressure controller, in ms
+    static const int SETPOINT_INTERVAL = 20;
+
+    /// Minimum time between two setpoints sent to the same pressure controller, in ms. Backends override this
+    /// according to the rate their link can sustain.
+    virtual int setpointInterval() const { return SETPOINT_INTERVAL; }
+
+    quint64 coalescedSetpoints() const { return mCoalescedSetpoints; }
 
 
 public slots:
     virtual void connect() = 0;
     void setValve(uint valveNumber, bool open);
+    void setValves(quint32 openMask, quint32 closeMask);
     void setPressure(uint controllerNumber, double pressure);
     void setPump(uint pumpNumber, bool on);
     void requestStatus();
+    void requestCapabilities();
 
 signals:
     void valveStateChanged(uint valveNumber, bool open);
@@ -76,17 +108,29 @@ signals:
     void pressureChanged(uint controllerNumber, double pressure);
     void pressureSetpointChanged(uint controllerNumber, double pressure);
     void uptimeChanged(ulong seconds);
+    void capabilitiesReceived(DeviceCapabilities capabilities);
 
     void connectionStatusChanged(ConnectionStatus newStatus);
 
+private slots:
+    void sendPendingSetpoints();
+
 protected:
     void setConnectionStatus(ConnectionStatus status);
     QByteArray frameMessage(QByteArray message);
+    QByteArray valveMessage(uint valveNumber, bool open);
     virtual void sendMessage(QByteArray message) = 0;
     void logMicrocontrollerMessage(LogLevel level, QByteArray const& message);
+    bool parseCapabilities(QList<QByteArray> const& parameters, DeviceCapabilities& capabilities);
+    static quint16 uint16(QByteArray const& data, int offset);
+    void sendSetpoint(uint controllerNumber, double pressure);
+    void flushPendingSetpoints();
 
     ConnectionStatus mConnectionStatus;
 
+    /// Version of the protocol used with the connected device
+    int mProtocolVersion;
+
     /// The buffer of incoming data, populated by the serial port backend
     QByteArray mBuffer;
 
@@ -102,6 +146,17 @@ protected:
 
     ApplicationController* appController;
 
+    // Setpoint coalescing (see setpointInterval)
+    QElapsedTimer mClock;
+    QTimer mSetpointTimer;
+    /// Controllers that have a setpoint waiting to be sent (bit 0 corresponds to controller 1)
+    quint32 mPendingSetpointMask;
+    double mPendingSetpoints[N_PRS];
+    /// When the last setpoint was sent to each controller, in ms on mClock
+    qint64 mLastSetpointTimes[N_PRS];
+    /// Number of setpoints that were replaced by a newer one before being sent
+    quint64 mCoalescedSetpoints;
+
 #ifdef TESTING
     friend class TestCommunicator;
 #endif
@@ -5,7 +5,12 @@
 typedef unsigned char uint8_t;
 #endif
 
+/// Full scale of pressure values: 8-bit in protocol version 1, 16-bit in version 2 (see Communicator)
 #define PR_MAX_VALUE UINT8_MAX
+#define PR_MAX_VALUE_V2 UINT16_MAX
+
+/// Latest version of the communication protocol supported by the application
+#define PROTOCOL_VERSION 2
 
 /// Number of valves, pressure regulators, and pumps defined below
 #define N_VALVES 32
@@ -29,6 +34,8 @@ enum Command : uint8_t {
     UPTIME,
     ERROR,
     LOG,
+    CAPABILITIES,
+    TELEMETRY,
     NUM_COMMANDS
 };
 
@@ -0,0 +1,332 @@
+#include "devicestate.h"
+
+#include <cmath>
+
+static_assert(N_VALVES <= 32 && N_PUMPS <= 32 && N_PRS <= 32, "Valve and pump states are stored in 32-bit bitsets");
+
+DeviceCapabilities::DeviceCapabilities()
+    : valveCount(0)
+    , pumpCount(0)
+    , controllerCount(0)
+    , minPressure()
+    , maxPressure()
+    , protocolVersion(1)
+{
+}
+
+/**
+ * @brief Return the capabilities defined in constants.h, for devices that don't report theirs
+ */
+DeviceCapabilities DeviceCapabilities::defaults()
+{
+    static_assert(N_PRS == 3, "Default pressure ranges are defined for 3 pressure controllers");
+
+    DeviceCapabilities c;
+    c.valveCount = N_VALVES;
+    c.pumpCount = N_PUMPS;
+    c.controllerCount = N_PRS;
+
+    c.minPressure[0] = PR1_MIN_PRESSURE;
+    c.minPressure[1] = PR2_MIN_PRESSURE;
+    c.minPressure[2] = PR3_MIN_PRESSURE;
+    c.maxPressure[0] = PR1_MAX_PRESSURE;
+    c.maxPressure[1] = PR2_MAX_PRESSURE;
+    c.maxPressure[2] = PR3_MAX_PRESSURE;
+
+    return c;
+}
+
+DeviceState::Switches::Switches()
+    : known(0)
+    , states(0)
+    , pending(0)
+    , commanded(0)
+    , unconfirmed(0)
+    , commandTimes()
+{
+}
+
+/**
+ * @brief Update the reported state of a component, confirming the pending command if there is one
+ * @return True if the state changed, or was not known before
+ */
+bool DeviceState::Switches::report(int number, bool value)
+{
+    quint32 b = bit(number);
+    bool changed = !(known & b) || (bool(states & b) != value);
+
+    known |= b;
+    if (value)
+        states |= b;
+    else
+        states &= ~b;
+
+    if (bool(commanded & b) == value) {
+        pending &= ~b;
+        unconfirmed &= ~b;
+    }
+
+    return changed;
+}
+
+void DeviceState::Switches::command(int number, bool value, qint64 time)
+{
+    quint32 b = bit(number);
+
+    pending |= b;
+    unconfirmed &= ~b;
+    if (value)
+        commanded |= b;
+    else
+        commanded &= ~b;
+
+    commandTimes[number - 1] = time;
+}
+
+/**
+ * @brief Drop the commands that were sent more than timeout ago, and flag their components as unconfirmed
+ * @return The components whose commands were dropped
+ */
+quint32 DeviceState::Switches::expire(qint64 time, qint64 timeout)
+{
+    quint32 expired = 0;
+    for (quint32 p = pending; p; p &= p - 1) {
+        int i = qCountTrailingZeroBits(p);
+        if (time - commandTimes[i] >= timeout)
+            expired |= 1u << i;
+    }
+
+    pending &= ~expired;
+    unconfirmed |= expired;
+    return expired;
+}
+
+DeviceState::DeviceState(QObject *parent)
+    : QObject(parent)
+    , mCapabilities(DeviceCapabilities::defaults())
+    , mPressureSteps(PR_MAX_VALUE)
+{
+    for (Controller& c : mControllers)
+        c = Controller {0, 0, 0, false, false, 0};
+}
+
+/**
+ * @brief Set the components and pressure ranges of the device. Counts are limited to the maximums in constants.h.
+ */
+void DeviceState::setCapabilities(const DeviceCapabilities &capabilities)
+{
+    mCapabilities = capabilities;
+    mCapabilities.valveCount = qBound(0, capabilities.valveCount, N_VALVES);
+    mCapabilities.pumpCount = qBound(0, capabilities.pumpCount, N_PUMPS);
+    mCapabilities.controllerCount = qBound(0, capabilities.controllerCount, N_PRS);
+}
+
+/**
+ * @brief Return true if any command is waiting for confirmation
+ */
+bool DeviceState::hasPendingCommands() const
+{
+    if (mValves.pending || mPumps.pending)
+        return true;
+
+    for (Controller const& c : mControllers) {
+        if (c.setpointPending)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Update the state of a valve, as reported by the device
+ * @return True if the state changed, or was not known before
+ */
+bool DeviceState::setValveState(int valveNumber, bool open)
+{
+    if (!isValid(valveNumber, N_VALVES))
+        return false;
+
+    return mValves.report(valveNumber, open);
+}
+
+/**
+ * @brief Record that a valve was commanded to open or close
+ * @param time When the command was sent, in ms (on any clock, as long as expireValveCommands uses the same)
+ */
+void DeviceState::commandValve(int valveNumber, bool open, qint64 time)
+{
+    if (isValid(valveNumber, N_VALVES))
+        mValves.command(valveNumber, open, time);
+}
+
+/**
+ * @brief Update the state of a pump, as reported by the device
+ * @return True if the state changed, or was not known before
+ */
+bool DeviceState::setPumpState(int pumpNumber, bool on)
+{
+    if (!isValid(pumpNumber, N_PUMPS))
+        return false;
+
+    return mPumps.report(pumpNumber, on);
+}
+
+/**
+ * @brief Record that a pump was commanded to switch on or off. See commandValve.
+ */
+void DeviceState::commandPump(int pumpNumber, bool on, qint64 time)
+{
+    if (isValid(pumpNumber, N_PUMPS))
+        mPumps.command(pumpNumber, on, time);
+}
+
+/**
+ * @brief Return the minimum pressure (in PSI) of the given controller
+ */
+double DeviceState::minPressure(int controllerNumber) const
+{
+    return isValid(controllerNumber, N_PRS) ? mCapabilities.minPressure[controllerNumber - 1] : 0;
+}
+
+/**
+ * @brief Return the maximum pressure (in PSI) of the given controller
+ */
+double DeviceState::maxPressure(int controllerNumber) const
+{
+    return isValid(controllerNumber, N_PRS) ? mCapabilities.maxPressure[controllerNumber - 1] : 0;
+}
+
+/**
+ * @brief Convert a pressure from a fraction of the controller's range (0 to 1) to PSI
+ */
+double DeviceState::toPsi(int controllerNumber, double value) const
+{
+    if (!isValid(controllerNumber, N_PRS))
+        return 0;
+
+    double min = mCapabilities.minPressure[controllerNumber - 1];
+    double max = mCapabilities.maxPressure[controllerNumber - 1];
+    return min + value * (max - min);
+}
+
+/**
+ * @brief Update the measured pressure of a controller, as a fraction of its range
+ * @return True if the value changed
+ */
+bool DeviceState::setMeasuredPressure(int controllerNumber, double value)
+{
+    if (!isValid(controllerNumber, N_PRS))
+        return false;
+
+    double& measured = mControllers[controllerNumber - 1].measured;
+    bool changed = measured != value;
+    measured = value;
+    return changed;
+}
+
+/**
+ * @brief Update the setpoint of a controller, as reported by the device, as a fraction of its range
+ * @return True if the value changed
+ */
+bool DeviceState::setSetpoint(int controllerNumber, double value)
+{
+    if (!isValid(controllerNumber, N_PRS))
+        return false;
+
+    Controller& c = mControllers[controllerNumber - 1];
+    bool changed = c.setpoint != value;
+    c.setpoint = value;
+
+    if (std::abs(c.commandedSetpoint - value) <= SETPOINT_TOLERANCE) {
+        c.setpointPending = false;
+        c.setpointUnconfirmed = false;
+    }
+
+    return changed;
+}
+
+double DeviceState::measuredPressure(int controllerNumber) const
+{
+    return isValid(controllerNumber, N_PRS) ? mControllers[controllerNumber - 1].measured : 0;
+}
+
+double DeviceState::setpoint(int controllerNumber) const
+{
+    return isValid(controllerNumber, N_PRS) ? mControllers[controllerNumber - 1].setpoint : 0;
+}
+
+/**
+ * @brief Record that a new setpoint was sent to a controller. See commandValve.
+ */
+void DeviceState::commandSetpoint(int controllerNumber, double value, qint64 time)
+{
+    if (!isValid(controllerNumber, N_PRS))
+        return;
+
+    Controller& c = mControllers[controllerNumber - 1];
+    c.commandedSetpoint = value;
+    c.setpointPending = true;
+    c.setpointUnconfirmed = false;
+    c.commandTime = time;
+}
+
+bool DeviceState::isSetpointPending(int controllerNumber) const
+{
+    return isValid(controllerNumber, N_PRS) && mControllers[controllerNumber - 1].setpointPending;
+}
+
+bool DeviceState::isSetpointUnconfirmed(int controllerNumber) const
+{
+    return isValid(controllerNumber, N_PRS) && mControllers[controllerNumber - 1].setpointUnconfirmed;
+}
+
+/**
+ * @brief Return the commanded setpoint if it is pending, or the reported one otherwise
+ */
+double DeviceState::displayedSetpoint(int controllerNumber) const
+{
+    if (!isValid(controllerNumber, N_PRS))
+        return 0;
+
+    Controller const& c = mControllers[controllerNumber - 1];
+    return c.setpointPending ? c.commandedSetpoint : c.setpoint;
+}
+
+/**
+ * @brief Drop setpoint commands sent more than timeout ago. See Switches::expire.
+ * @return The controllers whose commands were dropped (bit 0 corresponds to controller 1)
+ */
+quint32 DeviceState::expireSetpointCommands(qint64 time, qint64 timeout)
+{
+    quint32 expired = 0;
+    for (int i(0); i < N_PRS; ++i) {
+        Controller& c = mControllers[i];
+        if (c.setpointPending && time - c.commandTime >= timeout) {
+            c.setpointPending = false;
+            c.setpointUnconfirmed = true;
+            expired |= 1u << i;
+        }
+    }
+    return expired;
+}
+
+/**
+ * @brief Set the resolution of pressures: PR_MAX_VALUE or PR_MAX_VALUE_V2, depending on the protocol version
+ * @return True if it changed
+ */
+bool DeviceState::setPressureSteps(int steps)
+{
+    if (steps <= 0 || steps == mPressureSteps)
+        return false;
+
+    mPressureSteps = steps;
+    return true;
+}
+
+/**
+ * @brief Emit changed() for the given components, if there are any
+ */
+void DeviceState::notifyChanged(quint32 valves, quint32 pumps, quint32 setpoints, quint32 measuredPressures)
+{
+    if (valves | pumps | setpoints | measuredPressures)
+        emit changed(valves, pumps, setpoints, measuredPressures);
+}
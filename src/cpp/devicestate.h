@@ -0,0 +1,194 @@
+#ifndef DEVICESTATE_H
+#define DEVICESTATE_H
+
+#include <QtCore>
+
+#include "constants.h"
+
+/**
+ * @brief What a device (i.e. microcontroller and the hardware connected to it) supports, as reported in its reply to
+ * the CAPABILITIES command
+ *
+ * Counts never exceed the compile-time maximums in constants.h (N_VALVES, N_PUMPS, N_PRS), which size the buffers.
+ * Devices whose firmware predates the command are assumed to have the components and pressure ranges defined in
+ * constants.h (see defaults()).
+ */
+struct DeviceCapabilities
+{
+    DeviceCapabilities();
+    static DeviceCapabilities defaults();
+
+    int valveCount;
+    int pumpCount;
+    int controllerCount;
+
+    /// Pressure range of each controller, in PSI
+    double minPressure[N_PRS];
+    double maxPressure[N_PRS];
+
+    QString firmwareVersion;
+
+    /// Version of the communication protocol chosen by the device (see Communicator)
+    int protocolVersion;
+
+    /// Identifies the device, so that its capabilities can be cached. Empty if the device did not report them.
+    QString deviceId;
+};
+
+Q_DECLARE_METATYPE(DeviceCapabilities)
+
+/**
+ * @brief Last known state of every valve, pump and pressure controller of the device
+ *
+ * Components are identified by their number, starting at 1 (as in the GUI and in routines). The state is stored in
+ * fixed-size arrays indexed by component number, and valve and pump states in bitsets (bit 0 corresponds to valve 1),
+ * so that updates and lookups are array accesses, without allocation.
+ *
+ * The components that exist, and the range of each pressure controller, are given by the device's capabilities (see
+ * DeviceCapabilities). A component is "known" once the microcontroller has reported its state. Pressures are stored
+ * as received from the microcontroller, i.e. as a fraction of the controller's range (0 to 1).
+ *
+ * Commands sent to the device are tracked until the device confirms them, so that the GUI can show the commanded
+ * state immediately (see the displayed...() functions), marked as pending. A command is confirmed when the device
+ * reports the commanded state; reports of another state (e.g. a status reply sent before the command was received)
+ * leave it pending. Commands that are still pending after a timeout are dropped by expire...(), and the component
+ * is flagged as unconfirmed until the next command, or until the device reports the commanded state after all.
+ *
+ * Component numbers out of range are ignored by setters, and return a default value from getters.
+ *
+ * The GUI reads the state by component number (see the helpers in guihelper.h, which QML binds to the application
+ * controller's DeviceState). The state is updated as messages arrive, but the changed() signal is only emitted by
+ * notifyChanged(), which ApplicationController calls at most once per frame with the components that changed.
+ */
+class DeviceState : public QObject
+{
+    Q_OBJECT
+
+public:
+    DeviceState(QObject* parent = nullptr);
+
+    void setCapabilities(DeviceCapabilities const& capabilities);
+    DeviceCapabilities const& capabilities() const { return mCapabilities; }
+
+    bool hasPendingCommands() const;
+
+    // Valves
+
+    bool isValveDefined(int valveNumber) const { return isValid(valveNumber, mCapabilities.valveCount); }
+    Q_INVOKABLE int valveCount() const { return mCapabilities.valveCount; }
+
+    bool setValveState(int valveNumber, bool open);
+    Q_INVOKABLE bool isValveKnown(int valveNumber) const { return mValves.test(mValves.known, valveNumber); }
+    bool valveState(int valveNumber) const { return mValves.test(mValves.states, valveNumber); }
+
+    /// Open valves (bit 0 corresponds to valve 1)
+    quint32 valveStates() const { return mValves.states; }
+
+    void commandValve(int valveNumber, bool open, qint64 time);
+    Q_INVOKABLE bool isValvePending(int valveNumber) const { return mValves.test(mValves.pending, valveNumber); }
+    Q_INVOKABLE bool isValveUnconfirmed(int valveNumber) const
+    { return mValves.test(mValves.unconfirmed, valveNumber); }
+    Q_INVOKABLE bool displayedValveState(int valveNumber) const
+    { return mValves.test(mValves.displayed(), valveNumber); }
+    quint32 expireValveCommands(qint64 time, qint64 timeout) { return mValves.expire(time, timeout); }
+
+    // Pumps
+
+    bool isPumpDefined(int pumpNumber) const { return isValid(pumpNumber, mCapabilities.pumpCount); }
+    Q_INVOKABLE int pumpCount() const { return mCapabilities.pumpCount; }
+
+    bool setPumpState(int pumpNumber, bool on);
+    Q_INVOKABLE bool isPumpKnown(int pumpNumber) const { return mPumps.test(mPumps.known, pumpNumber); }
+    bool pumpState(int pumpNumber) const { return mPumps.test(mPumps.states, pumpNumber); }
+
+    void commandPump(int pumpNumber, bool on, qint64 time);
+    Q_INVOKABLE bool isPumpPending(int pumpNumber) const { return mPumps.test(mPumps.pending, pumpNumber); }
+    Q_INVOKABLE bool isPumpUnconfirmed(int pumpNumber) const { return mPumps.test(mPumps.unconfirmed, pumpNumber); }
+    Q_INVOKABLE bool displayedPumpState(int pumpNumber) const { return mPumps.test(mPumps.displayed(), pumpNumber); }
+    quint32 expirePumpCommands(qint64 time, qint64 timeout) { return mPumps.expire(time, timeout); }
+
+    // Pressure controllers
+
+    bool isControllerDefined(int controllerNumber) const { return isValid(controllerNumber, mCapabilities.controllerCount); }
+    Q_INVOKABLE int controllerCount() const { return mCapabilities.controllerCount; }
+
+    Q_INVOKABLE double minPressure(int controllerNumber) const;
+    Q_INVOKABLE double maxPressure(int controllerNumber) const;
+    double toPsi(int controllerNumber, double value) const;
+
+    bool setMeasuredPressure(int controllerNumber, double value);
+    bool setSetpoint(int controllerNumber, double value);
+    Q_INVOKABLE double measuredPressure(int controllerNumber) const;
+    double setpoint(int controllerNumber) const;
+
+    void commandSetpoint(int controllerNumber, double value, qint64 time);
+    Q_INVOKABLE bool isSetpointPending(int controllerNumber) const;
+    Q_INVOKABLE bool isSetpointUnconfirmed(int controllerNumber) const;
+    Q_INVOKABLE double displayedSetpoint(int controllerNumber) const;
+    quint32 expireSetpointCommands(qint64 time, qint64 timeout);
+
+    bool setPressureSteps(int steps);
+    /// Number of steps between the minimum and maximum pressure that the device can set and measure
+    Q_INVOKABLE int pressureSteps() const { return mPressureSteps; }
+
+    void notifyChanged(quint32 valves, quint32 pumps, quint32 setpoints, quint32 measuredPressures);
+
+    /// Largest difference between a commanded and reported setpoint for the command to be confirmed, as the device
+    /// reports setpoints with 8 bits of precision in version 1 of the protocol
+    static constexpr double SETPOINT_TOLERANCE = 1.0 / PR_MAX_VALUE;
+
+signals:
+    /// Emitted by notifyChanged(), with the components whose state changed (bit 0 corresponds to component 1).
+    /// Setpoints include whether they are pending or unconfirmed, and measured pressures include the resolution.
+    void changed(quint32 valves, quint32 pumps, quint32 setpoints, quint32 measuredPressures);
+
+private:
+    static const int MAX_SWITCHES = 32;
+
+    /// State of a set of on/off components (valves or pumps), stored as bitsets: bit 0 corresponds to component 1
+    struct Switches
+    {
+        Switches();
+
+        bool test(quint32 bits, int number) const { return isValid(number, MAX_SWITCHES) && (bits & bit(number)); }
+        bool report(int number, bool value);
+        void command(int number, bool value, qint64 time);
+        quint32 expire(qint64 time, qint64 timeout);
+
+        /// The commanded state of pending components, and the reported state of the others
+        quint32 displayed() const { return (states & ~pending) | (commanded & pending); }
+
+        quint32 known;
+        quint32 states;
+        quint32 pending;
+        quint32 commanded;
+        quint32 unconfirmed;
+
+        /// Time at which each pending command was sent
+        qint64 commandTimes[MAX_SWITCHES];
+    };
+
+    struct Controller
+    {
+        /// Between 0 and 1
+        double measured;
+        double setpoint;
+        double commandedSetpoint;
+
+        bool setpointPending;
+        bool setpointUnconfirmed;
+        qint64 commandTime;
+    };
+
+    static bool isValid(int number, int count) { return number >= 1 && number <= count; }
+    static quint32 bit(int number) { return 1u << (number - 1); }
+
+    DeviceCapabilities mCapabilities;
+
+    Switches mValves;
+    Switches mPumps;
+    Controller mControllers[N_PRS];
+    int mPressureSteps;
+};
+
+#endif // DEVICESTATE_H
@@ -0,0 +1,350 @@
+#include "experimentexporter.h"
+#include "logclock.h"
+
+namespace {
+
+QByteArray csvField(QString const& text)
+{
+    if (!text.contains(',') && !text.contains('"') && !text.contains('\n'))
+        return text.toUtf8();
+
+    QString escaped = text;
+    escaped.replace('"', "\"\"");
+    return "\"" + escaped.toUtf8() + "\"";
+}
+
+}
+
+/**
+ * @param directory Where the files are written
+ * @param capacity Maximum number of events waiting to be written; further events are dropped
+ */
+ExperimentExporter::ExperimentExporter(const QString &directory, int capacity)
+    : mDirectory(directory)
+    , mCapacity(qMax(1, capacity))
+    , mStopRequested(false)
+    , mBusy(false)
+    , mDropped(0)
+    , mUnreportedDrops(0)
+    , mRunStart(0)
+    , mCurrentStep(-1)
+{
+    mThread = std::thread([this] { run(); });
+}
+
+ExperimentExporter::~ExperimentExporter()
+{
+    stop();
+}
+
+/**
+ * @brief Write all pending events, close the current file (if a run is in progress) and stop the writer thread
+ *
+ * Events recorded afterwards are ignored.
+ */
+void ExperimentExporter::stop()
+{
+    if (!mThread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopRequested = true;
+    }
+    mWakeConditionVariable.notify_one();
+    mThread.join();
+
+    if (mFile.isOpen()) {
+        writeRow(LogClock::currentWallTime(), "run", 0, 0, "Application closed");
+        mFile.write(mBuffer);
+        mFile.close();
+    }
+}
+
+/**
+ * @brief Return the directory where the application exports runs by default
+ */
+QString ExperimentExporter::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation) + "/UFCS experiments";
+}
+
+/**
+ * @brief Start a new file for a routine run
+ */
+void ExperimentExporter::beginRun(const QString &routineName)
+{
+    post(Event::BeginRun, 0, 0, routineName);
+}
+
+/**
+ * @brief Close the file of the current run
+ */
+void ExperimentExporter::endRun()
+{
+    post(Event::EndRun);
+}
+
+/**
+ * @brief Record something happening to the run, e.g. "Paused"
+ */
+void ExperimentExporter::recordRunEvent(const QString &description)
+{
+    post(Event::RunEvent, 0, 0, description);
+}
+
+/**
+ * @brief Record the start of a routine step
+ * @param stepNumber Index of the step
+ * @param step The step, as written in the routine
+ */
+void ExperimentExporter::recordStep(int stepNumber, const QString &step)
+{
+    post(Event::Step, stepNumber, 0, step);
+}
+
+void ExperimentExporter::recordValve(int valveNumber, bool open)
+{
+    post(Event::Valve, valveNumber, open);
+}
+
+void ExperimentExporter::recordPump(int pumpNumber, bool on)
+{
+    post(Event::Pump, pumpNumber, on);
+}
+
+/**
+ * @brief Record a measured pressure, in PSI
+ */
+void ExperimentExporter::recordPressure(int controllerNumber, double pressure)
+{
+    post(Event::Pressure, controllerNumber, pressure);
+}
+
+/**
+ * @brief Record a pressure setpoint, in PSI
+ */
+void ExperimentExporter::recordSetpoint(int controllerNumber, double setpoint)
+{
+    post(Event::Setpoint, controllerNumber, setpoint);
+}
+
+/**
+ * @brief Block until all events recorded so far are written
+ */
+void ExperimentExporter::flush()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdleConditionVariable.wait(lock, [this] { return mQueue.empty() && !mBusy; });
+}
+
+/**
+ * @brief Return the path of the file of the current run, or of the last run
+ */
+QString ExperimentExporter::lastFilePath()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mLastFilePath;
+}
+
+/**
+ * @brief Return the number of events that were dropped because the queue was full
+ */
+quint64 ExperimentExporter::droppedEvents()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mDropped;
+}
+
+void ExperimentExporter::post(Event::Type type, int number, double value, const QString &text)
+{
+    Event event;
+    event.type = type;
+    event.timestamp = LogClock::currentWallTime();
+    event.number = number;
+    event.value = value;
+    event.text = text;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (mStopRequested)
+            return;
+
+        // The start and end of runs are never dropped, so that files are always closed
+        bool runBoundary = type == Event::BeginRun || type == Event::EndRun;
+        if (!runBoundary && int(mQueue.size()) >= mCapacity) {
+            mDropped++;
+            mUnreportedDrops++;
+            return;
+        }
+
+        mQueue.push_back(std::move(event));
+    }
+    mWakeConditionVariable.notify_one();
+}
+
+void ExperimentExporter::run()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (true) {
+        mWakeConditionVariable.wait(lock, [this] { return !mQueue.empty() || mStopRequested; });
+
+        if (mQueue.empty() && mStopRequested)
+            break;
+
+        std::deque<Event> batch;
+        batch.swap(mQueue);
+        quint64 drops = mUnreportedDrops;
+        mUnreportedDrops = 0;
+        mBusy = true;
+
+        lock.unlock();
+
+        for (Event const& event : batch) {
+            // Dropped events are reported before the file is closed
+            if (drops > 0 && event.type == Event::EndRun && mFile.isOpen()) {
+                writeRow(event.timestamp, "dropped", int(drops), 0, "Events dropped: the export could not keep up");
+                drops = 0;
+            }
+            process(event);
+        }
+
+        if (drops > 0 && mFile.isOpen())
+            writeRow(batch.back().timestamp, "dropped", int(drops), 0, "Events dropped: the export could not keep up");
+
+        if (mFile.isOpen() && !mBuffer.isEmpty()) {
+            mFile.write(mBuffer);
+            mFile.flush();
+        }
+        mBuffer.clear();
+
+        lock.lock();
+        mBusy = false;
+        mIdleConditionVariable.notify_all();
+    }
+}
+
+void ExperimentExporter::process(const Event &event)
+{
+    switch (event.type) {
+    case Event::BeginRun:
+        openFile(event);
+        break;
+
+    case Event::EndRun:
+        if (mFile.isOpen()) {
+            writeRow(event.timestamp, "run", 0, 0, "Finished");
+            mFile.write(mBuffer);
+            mBuffer.clear();
+            mFile.close();
+        }
+        break;
+
+    case Event::RunEvent:
+        if (mFile.isOpen())
+            writeRow(event.timestamp, "run", 0, 0, event.text);
+        break;
+
+    case Event::Step:
+        if (mFile.isOpen()) {
+            mCurrentStep = event.number;
+            writeRow(event.timestamp, "step", event.number, 0, event.text);
+        }
+        break;
+
+    case Event::Valve:
+        mValves[event.number] = event.value != 0;
+        if (mFile.isOpen())
+            writeRow(event.timestamp, "valve", event.number, event.value);
+        break;
+
+    case Event::Pump:
+        mPumps[event.number] = event.value != 0;
+        if (mFile.isOpen())
+            writeRow(event.timestamp, "pump", event.number, event.value);
+        break;
+
+    case Event::Pressure:
+        mPressures[event.number] = event.value;
+        if (mFile.isOpen())
+            writeRow(event.timestamp, "pressure", event.number, event.value);
+        break;
+
+    case Event::Setpoint:
+        mSetpoints[event.number] = event.value;
+        if (mFile.isOpen())
+            writeRow(event.timestamp, "setpoint", event.number, event.value);
+        break;
+    }
+}
+
+/**
+ * @brief Open the file for a new run, and write the header and the current device state
+ */
+void ExperimentExporter::openFile(const Event &event)
+{
+    if (mFile.isOpen()) {
+        writeRow(event.timestamp, "run", 0, 0, "Interrupted by a new run");
+        mFile.write(mBuffer);
+        mBuffer.clear();
+        mFile.close();
+    }
+
+    QString name = event.text.isEmpty() ? QString("routine") : event.text;
+    name.replace(QRegularExpression("[^A-Za-z0-9_-]"), "_");
+
+    QDir().mkpath(mDirectory);
+    QString baseName = QDir(mDirectory).absoluteFilePath(
+                name + "_" + QDateTime::fromMSecsSinceEpoch(event.timestamp).toString("yyyy-MM-dd_hh-mm-ss"));
+    QString path = baseName + ".csv";
+    for (int i(2); QFile::exists(path); ++i)
+        path = baseName + "_" + QString::number(i) + ".csv";
+
+    mFile.setFileName(path);
+    if (!mFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "Could not create export file" << path;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mLastFilePath = path;
+    }
+
+    qInfo() << "Exporting run to" << path;
+
+    mRunStart = event.timestamp;
+    mCurrentStep = -1;
+
+    mBuffer.append("timestamp,elapsed,step,event,number,value,text\n");
+    writeRow(event.timestamp, "run", 0, 0, event.text);
+
+    for (auto it = mValves.constBegin(); it != mValves.constEnd(); ++it)
+        writeRow(event.timestamp, "valve", it.key(), it.value());
+    for (auto it = mPumps.constBegin(); it != mPumps.constEnd(); ++it)
+        writeRow(event.timestamp, "pump", it.key(), it.value());
+    for (auto it = mSetpoints.constBegin(); it != mSetpoints.constEnd(); ++it)
+        writeRow(event.timestamp, "setpoint", it.key(), it.value());
+    for (auto it = mPressures.constBegin(); it != mPressures.constEnd(); ++it)
+        writeRow(event.timestamp, "pressure", it.key(), it.value());
+}
+
+void ExperimentExporter::writeRow(qint64 timestamp, const char *event, int number, double value, const QString &text)
+{
+    mBuffer.append(QByteArray::number(timestamp));
+    mBuffer.append(',');
+    mBuffer.append(QByteArray::number((timestamp - mRunStart) / 1000., 'f', 3));
+    mBuffer.append(',');
+    mBuffer.append(QByteArray::number(mCurrentStep));
+    mBuffer.append(',');
+    mBuffer.append(event);
+    mBuffer.append(',');
+    mBuffer.append(QByteArray::number(number));
+    mBuffer.append(',');
+    mBuffer.append(QByteArray::number(value, 'g', 10));
+    mBuffer.append(',');
+    mBuffer.append(csvField(text));
+    mBuffer.append('\n');
+}
@@ -0,0 +1,116 @@
+#ifndef EXPERIMENTEXPORTER_H
+#define EXPERIMENTEXPORTER_H
+
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <QtCore>
+
+/**
+ * @brief Exports the timeline of each routine run (device state and routine steps) to a CSV file, for analysis
+ *
+ * One file is written per run, named after the routine and the time it started. Each row is an event:
+ *
+ *     timestamp,elapsed,step,event,number,value,text
+ *
+ * - timestamp: ms since the epoch (UTC); elapsed: seconds since the run started
+ * - step: index of the routine step being executed when the event occurred (-1 before the first step)
+ * - event: "run" (start, end, pause...), "step", "valve", "pump", "pressure" (measured) or "setpoint"
+ * - number: the valve, pump or controller number, or the step index
+ * - value: 1/0 for valves (open/closed) and pumps (on/off), the pressure in PSI for pressure and setpoint events
+ * - text: the routine name for "run" events, the step itself for "step" events
+ *
+ * When a run starts, the last known state of every valve, pump and pressure controller is written first, so each
+ * file describes the full device state over the run.
+ *
+ * The record...() functions can be called from any thread (e.g. steps are recorded from the routine thread, so that
+ * their timestamps are accurate), and never block: events are pushed onto a bounded queue, and formatted and written
+ * by a background thread. If the queue is full (i.e. the disk can't keep up), events are dropped, and a "dropped"
+ * event with the number of dropped events is written instead, so memory use stays bounded.
+ */
+class ExperimentExporter
+{
+public:
+    ExperimentExporter(QString const& directory = defaultDirectory(), int capacity = DEFAULT_CAPACITY);
+    ~ExperimentExporter();
+
+    void beginRun(QString const& routineName);
+    void endRun();
+    void recordRunEvent(QString const& description);
+    void recordStep(int stepNumber, QString const& step);
+    void recordValve(int valveNumber, bool open);
+    void recordPump(int pumpNumber, bool on);
+    void recordPressure(int controllerNumber, double pressure);
+    void recordSetpoint(int controllerNumber, double setpoint);
+
+    void flush();
+    void stop();
+
+    QString lastFilePath();
+    quint64 droppedEvents();
+
+    static QString defaultDirectory();
+
+    /// Maximum number of events waiting to be written
+    static const int DEFAULT_CAPACITY = 65536;
+
+private:
+    struct Event
+    {
+        enum Type {
+            BeginRun,
+            EndRun,
+            RunEvent,
+            Step,
+            Valve,
+            Pump,
+            Pressure,
+            Setpoint
+        };
+
+        Type type;
+        qint64 timestamp;
+        int number;
+        double value;
+        QString text;
+    };
+
+    void post(Event::Type type, int number = 0, double value = 0, QString const& text = QString());
+    void run();
+    void process(Event const& event);
+    void openFile(Event const& event);
+    void writeRow(qint64 timestamp, const char* event, int number, double value, QString const& text = QString());
+
+    QString mDirectory;
+    int mCapacity;
+
+    /// Queue of events, protected by mMutex
+    std::mutex mMutex;
+    std::condition_variable mWakeConditionVariable;
+    std::condition_variable mIdleConditionVariable;
+    std::deque<Event> mQueue;
+    bool mStopRequested;
+    bool mBusy;
+    quint64 mDropped;
+    quint64 mUnreportedDrops;
+    QString mLastFilePath;
+
+    std::thread mThread;
+
+    // The following are only used by the writer thread
+
+    QFile mFile;
+    QByteArray mBuffer;
+    qint64 mRunStart;
+    int mCurrentStep;
+
+    /// Last known state of the device, written at the start of each run
+    QMap<int, bool> mValves;
+    QMap<int, bool> mPumps;
+    QMap<int, double> mPressures;
+    QMap<int, double> mSetpoints;
+};
+
+#endif // EXPERIMENTEXPORTER_H
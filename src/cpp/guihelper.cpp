@@ -1,40 +1,127 @@
 #include "guihelper.h"
-#include "applicationcontroller.h"
+#include "logging.h"
+
+#include <cmath>
+
+DeviceStateHelper::DeviceStateHelper()
+    : mNumber(0)
+{
+}
+
+/**
+ * @brief Show the state of the component from the given DeviceState, which is read immediately and then whenever
+ * the component changes
+ */
+void DeviceStateHelper::setDeviceState(DeviceState *state)
+{
+    if (mDeviceState == state)
+        return;
+
+    if (mDeviceState)
+        QObject::disconnect(mDeviceState, &DeviceState::changed, this, &DeviceStateHelper::onDeviceStateChanged);
+
+    mDeviceState = state;
+
+    if (state)
+        QObject::connect(state, &DeviceState::changed, this, &DeviceStateHelper::onDeviceStateChanged);
+
+    onDeviceStateChanged(~0u, ~0u, ~0u, ~0u);
+    emit deviceStateChanged();
+}
+
+/**
+ * @brief Set the number of the component shown by this helper, starting at 1. Its state is read immediately.
+ */
+void DeviceStateHelper::setNumber(int number)
+{
+    if (mNumber == number)
+        return;
+
+    mNumber = number;
+    onDeviceStateChanged(~0u, ~0u, ~0u, ~0u);
+    emit numberChanged(number);
+}
+
+void DeviceStateHelper::onDeviceStateChanged(quint32 valves, quint32 pumps, quint32 setpoints,
+                                             quint32 measuredPressures)
+{
+    // Component numbers are bits of the masks
+    if (mDeviceState && mNumber >= 1 && mNumber <= 32)
+        update(valves, pumps, setpoints, measuredPressures);
+}
 
 PCHelper::PCHelper()
     : mSetPoint(0)
     , mMeasuredValue(0)
     , mMinPressure(0)
     , mMaxPressure(0)
+    , mPending(false)
+    , mUnconfirmed(false)
+    , mSteps(PR_MAX_VALUE)
 {}
 
 /**
- * @brief Return the value in PSI of the controller's setpoint, rounded to 1 or 2 decimal places
+ * @brief Check that the range set in QML matches the range reported by the device
  */
-double PCHelper::setPointInPsi() const
+void PCHelper::componentComplete()
 {
+    if (!mDeviceState || mNumber < 1 || mNumber > mDeviceState->controllerCount())
+        return;
 
-    // Number of decimal points displayed. Since there are only 255 steps, it doesn't make
-    // sense to display 2 decimal points for pressure regulators with more than  25.5 PSI range.
+    if (mMinPressure != mDeviceState->minPressure(mNumber) || mMaxPressure != mDeviceState->maxPressure(mNumber))
+        UFCS_WARNING(lcApplication) << "The range of pressure controller" << mNumber << "in the GUI ("
+                                    << mMinPressure << "-" << mMaxPressure << "PSI) differs from the device's ("
+                                    << mDeviceState->minPressure(mNumber) << "-" << mDeviceState->maxPressure(mNumber)
+                                    << "PSI)";
+}
 
-    int decimals = 1;
-    if ((mMaxPressure - mMinPressure) < 25.5)
-        decimals = 2;
-    double precision = pow(10, decimals);
+void PCHelper::update(quint32 valves, quint32 pumps, quint32 setpoints, quint32 measuredPressures)
+{
+    Q_UNUSED(valves);
+    Q_UNUSED(pumps);
+
+    if (isSet(setpoints)) {
+        setSetPoint(mDeviceState->displayedSetpoint(mNumber));
+        setPending(mDeviceState->isSetpointPending(mNumber));
+        setUnconfirmed(mDeviceState->isSetpointUnconfirmed(mNumber));
+    }
+
+    if (isSet(measuredPressures)) {
+        setSteps(mDeviceState->pressureSteps());
+        setMeasuredValue(mDeviceState->measuredPressure(mNumber));
+    }
+}
+
+/**
+ * @brief Return the number of decimal places worth displaying, given the resolution of the device (1 to 3)
+ */
+int PCHelper::decimals() const
+{
+    double step = (mMaxPressure - mMinPressure) / mSteps;
+    if (step <= 0)
+        return 1;
+
+    return qBound(1, int(std::ceil(-std::log10(step) - 1e-9)), 3);
+}
+
+/**
+ * @brief Return the value in PSI of the controller's setpoint, rounded to the resolution of the device
+ */
+double PCHelper::setPointInPsi() const
+{
+    // E.g. with 255 steps, it doesn't make sense to display 2 decimal points for pressure regulators with more than
+    // 25.5 PSI range.
+    double precision = pow(10, decimals());
 
     return round(precision*(mSetPoint*(mMaxPressure - mMinPressure) + mMinPressure))/precision;
 }
 
 /**
- * @brief Return the value in PSI of the controller's measured pressure, rounded to 1 or 2 decimal places
+ * @brief Return the value in PSI of the controller's measured pressure, rounded to the resolution of the device
  */
 double PCHelper::measuredValueInPsi() const
 {
-    // Number of decimal points displayed
-    int decimals = 1;
-    if ((mMaxPressure - mMinPressure) < 25.5)
-        decimals = 2;
-    double precision = pow(10, decimals);
+    double precision = pow(10, decimals());
 
     return round(precision*(mMeasuredValue*(mMaxPressure - mMinPressure) + mMinPressure))/precision;
 }
@@ -96,6 +183,63 @@ void PCHelper::setMeasuredValueInPsi(double val)
     this->setMeasuredValue(pv);
 }
 
+void PCHelper::setPending(bool pending)
+{
+    if (mPending != pending) {
+        mPending = pending;
+        emit pendingChanged(pending);
+    }
+}
+
+void PCHelper::setUnconfirmed(bool unconfirmed)
+{
+    if (mUnconfirmed != unconfirmed) {
+        mUnconfirmed = unconfirmed;
+        emit unconfirmedChanged(unconfirmed);
+    }
+}
+
+/**
+ * @brief Set the resolution of the device: PR_MAX_VALUE or PR_MAX_VALUE_V2, depending on the protocol version
+ */
+void PCHelper::setSteps(int steps)
+{
+    if (steps > 0 && mSteps != steps) {
+        mSteps = steps;
+        emit stepsChanged(steps);
+        emit setPointChanged(mSetPoint);
+        emit measuredValueChanged(mMeasuredValue);
+    }
+}
+
+void ValveSwitchHelper::update(quint32 valves, quint32 pumps, quint32 setpoints, quint32 measuredPressures)
+{
+    Q_UNUSED(pumps);
+    Q_UNUSED(setpoints);
+    Q_UNUSED(measuredPressures);
+
+    if (!isSet(valves))
+        return;
+
+    setState(mDeviceState->displayedValveState(mNumber));
+    setPending(mDeviceState->isValvePending(mNumber));
+    setUnconfirmed(mDeviceState->isValveUnconfirmed(mNumber));
+}
+
+void PumpSwitchHelper::update(quint32 valves, quint32 pumps, quint32 setpoints, quint32 measuredPressures)
+{
+    Q_UNUSED(valves);
+    Q_UNUSED(setpoints);
+    Q_UNUSED(measuredPressures);
+
+    if (!isSet(pumps))
+        return;
+
+    setState(mDeviceState->displayedPumpState(mNumber));
+    setPending(mDeviceState->isPumpPending(mNumber));
+    setUnconfirmed(mDeviceState->isPumpUnconfirmed(mNumber));
+}
+
 void ValveSwitchHelper::setState(bool newState)
 {
     if (mState != newState) {
@@ -111,3 +255,35 @@ void PumpSwitchHelper::setState(bool newState)
         emit stateChanged(newState);
     }
 }
+
+void ValveSwitchHelper::setPending(bool pending)
+{
+    if (mPending != pending) {
+        mPending = pending;
+        emit pendingChanged(pending);
+    }
+}
+
+void ValveSwitchHelper::setUnconfirmed(bool unconfirmed)
+{
+    if (mUnconfirmed != unconfirmed) {
+        mUnconfirmed = unconfirmed;
+        emit unconfirmedChanged(unconfirmed);
+    }
+}
+
+void PumpSwitchHelper::setPending(bool pending)
+{
+    if (mPending != pending) {
+        mPending = pending;
+        emit pendingChanged(pending);
+    }
+}
+
+void PumpSwitchHelper::setUnconfirmed(bool unconfirmed)
+{
+    if (mUnconfirmed != unconfirmed) {
+        mUnconfirmed = unconfirmed;
+        emit unconfirmedChanged(unconfirmed);
+    }
+}
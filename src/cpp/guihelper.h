@@ -3,28 +3,89 @@
 
 #include <QObject>
 #include <QDebug>
+#include <QPointer>
+#include <QQmlParserStatus>
 
+#include "devicestate.h"
 
 /*
  * Collection of helper classes, to provide a bidirectional interface between the C++ backend and QML gui elements
  *
  * They are intended to be used as attributes of QML elements. For example PCHelper is registered to QML in main.cpp,
  * and should be instantiated within the actual graphical element it supports.
+ *
+ * Each helper shows one component, identified by its number, and reads its state from the application's DeviceState
+ * (Backend.deviceState) when it is bound to it, and then whenever the component changes. For example:
+ *
+ *     ValveSwitchHelper {
+ *         deviceState: Backend.deviceState
+ *         valveNumber: 3
+ *     }
+ *
+ * When the user changes a component, its helper shows the new state immediately, with "pending" set until the
+ * device confirms the change. If the device doesn't confirm it in time, the helper reverts to the state reported by
+ * the device, and "unconfirmed" is set (see DeviceState).
  */
 
+/**
+ * @brief Base of the helpers, which reads the state of a component from a DeviceState
+ */
+class DeviceStateHelper : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(DeviceState* deviceState READ deviceState WRITE setDeviceState NOTIFY deviceStateChanged)
+
+public:
+    DeviceStateHelper();
+
+    DeviceState* deviceState() const { return mDeviceState; }
+    int number() const { return mNumber; }
+
+public slots:
+    void setDeviceState(DeviceState* state);
+    void setNumber(int number);
+
+signals:
+    void deviceStateChanged();
+    void numberChanged(int number);
+
+protected:
+    /**
+     * @brief Read the state of the component from mDeviceState if it changed, i.e. if its bit is set in the
+     * corresponding mask (see DeviceState::changed). Only called when mDeviceState is set and mNumber is valid.
+     */
+    virtual void update(quint32 valves, quint32 pumps, quint32 setpoints, quint32 measuredPressures) = 0;
+
+    bool isSet(quint32 components) const { return components & (1u << (mNumber - 1)); }
+
+    QPointer<DeviceState> mDeviceState;
+
+    /// Number of the component, starting at 1; 0 if not set
+    int mNumber;
+
+private slots:
+    void onDeviceStateChanged(quint32 valves, quint32 pumps, quint32 setpoints, quint32 measuredPressures);
+};
+
 /**
  * @brief Backend for pressure controller GUI elements
  */
-class PCHelper : public QObject
+class PCHelper : public DeviceStateHelper, public QQmlParserStatus
 {
     Q_OBJECT
+    Q_INTERFACES(QQmlParserStatus)
 
+    Q_PROPERTY(int controllerNumber READ number WRITE setNumber NOTIFY numberChanged)
     Q_PROPERTY(double setPoint MEMBER mSetPoint NOTIFY setPointChanged)
     Q_PROPERTY(double measuredValue READ measuredValue WRITE setMeasuredValue NOTIFY measuredValueChanged)
     Q_PROPERTY(double setPointInPsi READ setPointInPsi NOTIFY setPointChanged)
     Q_PROPERTY(double measuredValueInPsi READ measuredValueInPsi NOTIFY measuredValueChanged)
     Q_PROPERTY(double minPressure MEMBER mMinPressure);
     Q_PROPERTY(double maxPressure MEMBER mMaxPressure);
+    Q_PROPERTY(bool pending READ pending NOTIFY pendingChanged)
+    Q_PROPERTY(bool unconfirmed READ unconfirmed NOTIFY unconfirmedChanged)
+    Q_PROPERTY(int steps READ steps NOTIFY stepsChanged)
 
 public:
     PCHelper();
@@ -34,63 +95,115 @@ public:
     double measuredValueInPsi() const;
     double minPressure() const { return mMinPressure; };
     double maxPressure() const { return mMaxPressure; };
+    bool pending() const { return mPending; }
+    bool unconfirmed() const { return mUnconfirmed; }
+    int steps() const { return mSteps; }
+
+    void classBegin() {}
+    void componentComplete();
 
 public slots:
     void setSetPoint(double val);
     void setSetPointInPsi(double val);
     void setMeasuredValue(double val);
     void setMeasuredValueInPsi(double val);
+    void setPending(bool pending);
+    void setUnconfirmed(bool unconfirmed);
+    void setSteps(int steps);
 
 signals:
     void setPointChanged (double val);
     void measuredValueChanged(double val);
+    void pendingChanged(bool pending);
+    void unconfirmedChanged(bool unconfirmed);
+    void stepsChanged(int steps);
+
+protected:
+    void update(quint32 valves, quint32 pumps, quint32 setpoints, quint32 measuredPressures);
 
 private:
+    int decimals() const;
+
     double mSetPoint;
     double mMeasuredValue;
 
     // Min and max pressure in PSI
     double mMinPressure;
     double mMaxPressure;
+
+    // True while a new setpoint is waiting for confirmation; true if the last one was never confirmed
+    bool mPending;
+    bool mUnconfirmed;
+
+    /// Number of steps between the minimum and maximum pressure that the device can set and measure
+    int mSteps;
 };
 
 
-class ValveSwitchHelper : public QObject
+class ValveSwitchHelper : public DeviceStateHelper
 {
     Q_OBJECT
 
+    Q_PROPERTY(int valveNumber READ number WRITE setNumber NOTIFY numberChanged)
     Q_PROPERTY(bool state READ state WRITE setState NOTIFY stateChanged)
+    Q_PROPERTY(bool pending READ pending NOTIFY pendingChanged)
+    Q_PROPERTY(bool unconfirmed READ unconfirmed NOTIFY unconfirmedChanged)
 
 public:
     bool state() { return mState; }
+    bool pending() const { return mPending; }
+    bool unconfirmed() const { return mUnconfirmed; }
 
 public slots:
     void setState(bool newState);
+    void setPending(bool pending);
+    void setUnconfirmed(bool unconfirmed);
 
 signals:
     void stateChanged(bool newState);
+    void pendingChanged(bool pending);
+    void unconfirmedChanged(bool unconfirmed);
+
+protected:
+    void update(quint32 valves, quint32 pumps, quint32 setpoints, quint32 measuredPressures);
 
 private:
-    bool mState; // true: open. false: closed
+    bool mState = false; // true: open. false: closed
+    bool mPending = false;
+    bool mUnconfirmed = false;
 };
 
-class PumpSwitchHelper : public QObject
+class PumpSwitchHelper : public DeviceStateHelper
 {
     Q_OBJECT
 
+    Q_PROPERTY(int pumpNumber READ number WRITE setNumber NOTIFY numberChanged)
     Q_PROPERTY(bool state READ state WRITE setState NOTIFY stateChanged)
+    Q_PROPERTY(bool pending READ pending NOTIFY pendingChanged)
+    Q_PROPERTY(bool unconfirmed READ unconfirmed NOTIFY unconfirmedChanged)
 
 public:
     bool state() { return mState; }
+    bool pending() const { return mPending; }
+    bool unconfirmed() const { return mUnconfirmed; }
 
 public slots:
     void setState(bool newState);
+    void setPending(bool pending);
+    void setUnconfirmed(bool unconfirmed);
 
 signals:
     void stateChanged(bool newState);
+    void pendingChanged(bool pending);
+    void unconfirmedChanged(bool unconfirmed);
+
+protected:
+    void update(quint32 valves, quint32 pumps, quint32 setpoints, quint32 measuredPressures);
 
 private:
-    bool mState; // true: on. false: off
+    bool mState = false; // true: on. false: off
+    bool mPending = false;
+    bool mUnconfirmed = false;
 };
 
 #endif // GUIHELPER_H
@@ -0,0 +1,180 @@
+#include "logarchiver.h"
+
+namespace {
+
+struct Crc32Table
+{
+    Crc32Table()
+    {
+        for (quint32 i(0); i < 256; ++i) {
+            quint32 c = i;
+            for (int k(0); k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            values[i] = c;
+        }
+    }
+
+    quint32 values[256];
+};
+
+quint32 crc32(QByteArray const& data)
+{
+    static const Crc32Table table;
+
+    quint32 crc = 0xFFFFFFFF;
+    const uchar* p = reinterpret_cast<const uchar*>(data.constData());
+    for (int i(0); i < data.size(); ++i)
+        crc = table.values[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+
+    return crc ^ 0xFFFFFFFF;
+}
+
+}
+
+LogRotationPolicy::LogRotationPolicy()
+    : maxSegmentSize(10*1024*1024)
+    , maxSegmentAge(24*3600)
+    , maxAge(30*24*3600)
+    , maxTotalSize(500*1024*1024)
+{
+}
+
+class LogArchiver::ArchiveTask : public QRunnable
+{
+public:
+    ArchiveTask(QStringList const& paths, QString const& directory, QStringList const& activePaths,
+                LogRotationPolicy const& policy)
+        : mPaths(paths)
+        , mDirectory(directory)
+        , mActivePaths(activePaths)
+        , mPolicy(policy)
+    {}
+
+    void run()
+    {
+        for (QString const& path : mPaths)
+            LogArchiver::compressFile(path);
+        LogArchiver::prune(mDirectory, mPolicy, mActivePaths);
+    }
+
+private:
+    QStringList mPaths;
+    QString mDirectory;
+    QStringList mActivePaths;
+    LogRotationPolicy mPolicy;
+};
+
+LogArchiver::LogArchiver()
+{
+    mPool.setMaxThreadCount(1);
+}
+
+LogArchiver::~LogArchiver()
+{
+    mPool.waitForDone();
+}
+
+void LogArchiver::setPolicy(const LogRotationPolicy &policy)
+{
+    mPolicy = policy;
+}
+
+/**
+ * @brief Compress the given files, then delete old files from the log directory, on the worker thread
+ * @param paths Closed log segments to compress
+ * @param directory The log directory
+ * @param activePaths Files currently being written, which must not be deleted
+ */
+void LogArchiver::archive(const QStringList &paths, const QString &directory, const QStringList &activePaths)
+{
+    mPool.start(new ArchiveTask(paths, directory, activePaths, mPolicy));
+}
+
+void LogArchiver::waitForDone()
+{
+    mPool.waitForDone();
+}
+
+/**
+ * @brief Return the data compressed in the gzip format
+ *
+ * qCompress produces a zlib stream (preceded by the uncompressed size); gzip uses the same deflate data, with a
+ * different header and trailer.
+ */
+QByteArray LogArchiver::gzip(const QByteArray &data)
+{
+    QByteArray zlib = qCompress(data, 6);
+
+    // Skip qCompress's 4-byte size and the 2-byte zlib header, and drop the 4-byte Adler-32 checksum
+    QByteArray deflated = zlib.mid(6, zlib.size() - 10);
+
+    QByteArray result;
+    result.reserve(deflated.size() + 18);
+
+    const char header[10] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 3};
+    result.append(header, sizeof(header));
+    result.append(deflated);
+
+    uchar trailer[8];
+    qToLittleEndian<quint32>(crc32(data), trailer);
+    qToLittleEndian<quint32>(quint32(data.size()), trailer + 4);
+    result.append(reinterpret_cast<const char*>(trailer), sizeof(trailer));
+
+    return result;
+}
+
+/**
+ * @brief Replace a file by its gzipped version (with the .gz suffix)
+ */
+bool LogArchiver::compressFile(const QString &path)
+{
+    QFile input(path);
+    if (!input.open(QIODevice::ReadOnly))
+        return false;
+
+    QByteArray compressed = gzip(input.readAll());
+    input.close();
+
+    QSaveFile output(path + ".gz");
+    if (!output.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not write compressed log file" << output.fileName();
+        return false;
+    }
+
+    output.write(compressed);
+    if (!output.commit()) {
+        qWarning() << "Could not write compressed log file" << output.fileName();
+        return false;
+    }
+
+    return QFile::remove(path);
+}
+
+/**
+ * @brief Delete log files that are too old, then the oldest ones until the directory is within its size limit
+ */
+void LogArchiver::prune(const QString &directory, const LogRotationPolicy &policy, const QStringList &activePaths)
+{
+    QDir dir(directory);
+    QFileInfoList files = dir.entryInfoList(QStringList() << "log_*", QDir::Files, QDir::Time | QDir::Reversed);
+
+    qint64 totalSize = 0;
+    for (QFileInfo const& file : files)
+        totalSize += file.size();
+
+    QDateTime now = QDateTime::currentDateTime();
+
+    for (QFileInfo const& file : files) {
+        if (activePaths.contains(file.absoluteFilePath()))
+            continue;
+
+        bool tooOld = policy.maxAge > 0 && file.lastModified().secsTo(now) > policy.maxAge;
+        bool tooBig = policy.maxTotalSize > 0 && totalSize > policy.maxTotalSize;
+
+        if (!tooOld && !tooBig)
+            continue;
+
+        if (QFile::remove(file.absoluteFilePath()))
+            totalSize -= file.size();
+    }
+}
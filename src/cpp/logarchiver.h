@@ -0,0 +1,54 @@
+#ifndef LOGARCHIVER_H
+#define LOGARCHIVER_H
+
+#include <QtCore>
+
+/**
+ * @brief Limits on the size and age of log files
+ *
+ * Segments are rotated when they reach maxSegmentSize or maxSegmentAge. Archived (closed) segments are deleted,
+ * oldest first, when they are older than maxAge or when the total size of the log directory exceeds maxTotalSize.
+ * A value of 0 disables the corresponding limit.
+ */
+struct LogRotationPolicy
+{
+    LogRotationPolicy();
+
+    /// Maximum size of a log segment, in bytes
+    qint64 maxSegmentSize;
+    /// Maximum time covered by a log segment, in seconds
+    qint64 maxSegmentAge;
+    /// Maximum age of archived log files, in seconds
+    qint64 maxAge;
+    /// Maximum total size of the log directory, in bytes
+    qint64 maxTotalSize;
+};
+
+/**
+ * @brief Compresses closed log segments and applies retention limits, on a worker thread
+ *
+ * Closed segments are gzipped (e.g. log_2020-01-01_12-00-00.txt becomes log_2020-01-01_12-00-00.txt.gz) and the
+ * originals deleted. This is done on a single-thread pool, so the log writer never waits for it.
+ */
+class LogArchiver
+{
+public:
+    LogArchiver();
+    ~LogArchiver();
+
+    void setPolicy(LogRotationPolicy const& policy);
+    void archive(QStringList const& paths, QString const& directory, QStringList const& activePaths);
+    void waitForDone();
+
+    static QByteArray gzip(QByteArray const& data);
+    static bool compressFile(QString const& path);
+    static void prune(QString const& directory, LogRotationPolicy const& policy, QStringList const& activePaths);
+
+private:
+    class ArchiveTask;
+
+    LogRotationPolicy mPolicy;
+    QThreadPool mPool;
+};
+
+#endif // LOGARCHIVER_H
@@ -0,0 +1,125 @@
+#include "logclock.h"
+
+#include <chrono>
+#include <limits>
+
+namespace {
+
+struct ClockOffset
+{
+    ClockOffset()
+        : monotonic(LogClock::monotonicNanoseconds())
+        , wall(QDateTime::currentMSecsSinceEpoch())
+    {}
+
+    qint64 monotonic;
+    qint64 wall;
+};
+
+const ClockOffset& clockOffset()
+{
+    static const ClockOffset offset;
+    return offset;
+}
+
+/// Formatted date and time of the second most recently formatted by this thread
+struct FormatCache
+{
+    FormatCache()
+        : second(std::numeric_limits<qint64>::min())
+    {}
+
+    qint64 second;
+    QDate date;
+    QString dateString; // "yyyy-MM-dd "
+    QString timeString; // "hh:mm:ss."
+};
+
+thread_local FormatCache formatCache;
+
+const FormatCache& cacheFor(qint64 wallTime)
+{
+    FormatCache& cache = formatCache;
+
+    // Rounded down, including for times before the epoch
+    qint64 second = wallTime >= 0 ? wallTime / 1000 : (wallTime - 999) / 1000;
+    if (second == cache.second)
+        return cache;
+
+    QDateTime dateTime = QDateTime::fromMSecsSinceEpoch(second * 1000);
+    QDate date = dateTime.date();
+    if (date != cache.date) {
+        cache.date = date;
+        cache.dateString = date.toString("yyyy-MM-dd ");
+    }
+    cache.timeString = dateTime.time().toString("hh:mm:ss.");
+    cache.second = second;
+
+    return cache;
+}
+
+void appendMilliseconds(QString& s, qint64 wallTime)
+{
+    int ms = int(wallTime % 1000);
+    if (ms < 0)
+        ms += 1000;
+
+    s.append(QChar('0' + ms / 100));
+    s.append(QChar('0' + ms / 10 % 10));
+    s.append(QChar('0' + ms % 10));
+}
+
+}
+
+qint64 LogClock::monotonicNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Convert a time given by monotonicNanoseconds() to milliseconds since the epoch
+ */
+qint64 LogClock::toWallTime(qint64 monotonicNanoseconds)
+{
+    const ClockOffset& offset = clockOffset();
+    qint64 elapsed = monotonicNanoseconds - offset.monotonic;
+    return offset.wall + (elapsed >= 0 ? elapsed / 1000000 : (elapsed - 999999) / 1000000);
+}
+
+/**
+ * @brief Return the current time, in milliseconds since the epoch, as used for log messages
+ */
+qint64 LogClock::currentWallTime()
+{
+    return toWallTime(monotonicNanoseconds());
+}
+
+/**
+ * @brief Format a time (in ms since the epoch) as "hh:mm:ss.zzz", in local time
+ */
+QString LogClock::formatTime(qint64 wallTime)
+{
+    const FormatCache& cache = cacheFor(wallTime);
+
+    QString s;
+    s.reserve(12);
+    s.append(cache.timeString);
+    appendMilliseconds(s, wallTime);
+    return s;
+}
+
+/**
+ * @brief Format a time (in ms since the epoch) as "yyyy-MM-dd hh:mm:ss.zzz", in local time
+ */
+QString LogClock::formatDateTime(qint64 wallTime)
+{
+    const FormatCache& cache = cacheFor(wallTime);
+
+    QString s;
+    s.reserve(23);
+    s.append(cache.dateString);
+    s.append(cache.timeString);
+    appendMilliseconds(s, wallTime);
+    return s;
+}
@@ -0,0 +1,28 @@
+#ifndef LOGCLOCK_H
+#define LOGCLOCK_H
+
+#include <QtCore>
+
+/**
+ * @brief Timestamps for log messages
+ *
+ * Messages are timestamped with a monotonic clock, which is cheap to read and consistent across threads, so
+ * messages logged by the GUI, communicator and routine threads can be ordered reliably. Monotonic times are mapped to
+ * wall-clock time using the offset between the two clocks measured at startup: log times are therefore unaffected if
+ * the system clock is adjusted during a session.
+ *
+ * Formatting a QDateTime is comparatively expensive, so formatTime() and formatDateTime() cache the formatted date
+ * (per day) and time (per second), and only append the milliseconds for each message. The caches are per thread.
+ */
+class LogClock
+{
+public:
+    static qint64 monotonicNanoseconds();
+    static qint64 toWallTime(qint64 monotonicNanoseconds);
+    static qint64 currentWallTime();
+
+    static QString formatTime(qint64 wallTime);
+    static QString formatDateTime(qint64 wallTime);
+};
+
+#endif // LOGCLOCK_H
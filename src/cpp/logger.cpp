@@ -1,4 +1,8 @@
 #include "logger.h"
+#include "logging.h"
+#include "logclock.h"
+
+#include <algorithm>
 
 static Logger* singleton = nullptr;
 
@@ -17,76 +21,182 @@ Logger::Logger()
     if (!d.mkpath(dataLocation))
         fprintf(stderr, "Could not create directory for log file storage\n");
 
-    QString fileName = "log_" + QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss") + ".txt";
-    mLogFilePath = QDir::cleanPath(dataLocation + "/" + fileName);
+    QSettings settings;
+
+    // The binary log is optional, as it duplicates the text log. See StructuredLogReader to read it.
+    bool binaryLog = settings.value("logging/binaryLogEnabled", false).toBool();
+
+    // Sizes are in MB, durations in hours (segments) and days (retention)
+    LogRotationPolicy policy;
+    policy.maxSegmentSize = settings.value("logging/maxFileSize", 10).toLongLong()*1024*1024;
+    policy.maxSegmentAge = settings.value("logging/rotationInterval", 24).toLongLong()*3600;
+    policy.maxAge = settings.value("logging/retentionDays", 30).toLongLong()*24*3600;
+    policy.maxTotalSize = settings.value("logging/maxTotalSize", 500).toLongLong()*1024*1024;
+
+    mWriter.setPeriodicTask([this] { flushRepeats(false); });
+    mWriter.start(dataLocation, binaryLog, policy);
+
+    // Per-category filtering (see logging.h), e.g. "ufcs.communicator.debug=false". Debug messages from the
+    // hot paths are disabled by default in release builds. Several rules can be separated by semicolons.
+#ifdef QT_NO_DEBUG
+    QString defaultRules = "ufcs.*.debug=false";
+#else
+    QString defaultRules;
+#endif
+    QString rules = settings.value("logging/filterRules", defaultRules).toString();
+    if (!rules.isEmpty())
+        QLoggingCategory::setFilterRules(rules.replace(';', '\n'));
 
-    QByteArray path = mLogFilePath.toLocal8Bit();
+    QByteArray path = mWriter.currentFilePath().toLocal8Bit();
     fprintf(stdout, "Log file location: %s\n", path.constData());
+}
 
-    connect(this , &Logger::newLogForFile, this, &Logger::logToFile);
-    connect(this, &Logger::newLogForFile, this, &Logger::logToTerminal);
+/**
+ * @brief Write any pending messages and close the log file
+ */
+void Logger::shutdown()
+{
+    flushRepeats(true);
+    mWriter.stop();
 }
 
 void Logger::messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg)
 {
-    QString date = QDateTime::currentDateTime().toString("yyyy-MM-dd");
-    QString time = QDateTime::currentDateTime().toString("hh:mm:ss.zzz");
-
-    QString messageType;
-    QString message;
+    LogRecord record;
+    record.monotonicTime = LogClock::monotonicNanoseconds();
+    record.timestamp = LogClock::toWallTime(record.monotonicTime);
+    record.level = type;
 
     switch (type) {
     case QtDebugMsg:
-        messageType  = "Debug";
-        message = msg;
-        break;
     case QtInfoMsg:
-        messageType  = "Info";
-        message = msg;
-        break;
     case QtWarningMsg:
-        messageType  = "Warning";
-        message = msg;
+        record.text = msg;
         break;
     case QtCriticalMsg:
-        messageType  = "Critical error";
-        message = QString("%1 (%2:%3, %4)").arg(msg).arg(context.file).arg(context.line).arg(context.function);
-        break;
     case QtFatalMsg:
-        messageType  = "Fatal error";
-        message = QString("%1 (%2:%3, %4)").arg(msg).arg(context.file).arg(context.line).arg(context.function);
+        record.text = QString("%1 (%2:%3, %4)").arg(msg).arg(context.file).arg(context.line).arg(context.function);
         break;
     }
 
-    QString text = date + " " + time + " " + messageType + ": " + message + "\n";
+    // Typed fields, if the message was logged with StructuredLog::logEvent
+    if (!StructuredLog::takePendingEvent(record))
+        record.source = StructuredLog::sourceFromCategory(context.category);
 
-    emit logger()->newLogForFile(text);
+    // Identical consecutive messages (from the same thread) are collapsed into a "repeated N times" message,
+    // which is written when a different message is logged, or by flushRepeats after REPEAT_SUMMARY_INTERVAL.
+    // The logger is created first, as RepeatState registers with it.
+    Logger* l = logger();
+    thread_local RepeatState state;
 
-    // Logs are stored in a fragmented way to make rich markup easier in QML.
-    // Date is omitted since not particularly useful within the app
-    QStringList toAdd;
-    toAdd << time << messageType << message;
-    emit logger()->newLogForGUI(toAdd);
+    // Messages are dispatched once the mutex is unlocked, in case a slot connected to newLogForGUI logs something
+    LogRecord summary;
+    bool hasSummary = false;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+
+        if (type != QtFatalMsg && type == state.previous.level && record.text == state.previous.text) {
+            if (state.repeats == 0)
+                state.firstRepeatTime = record.monotonicTime;
+            state.repeats++;
+            state.lastRepeatTime = record.monotonicTime;
+            return;
+        }
+
+        if (state.repeats > 0) {
+            summary = repeatSummary(state.previous, state.repeats, record.monotonicTime - 1);
+            hasSummary = true;
+        }
+
+        state.previous.level = record.level;
+        state.previous.text = record.text;
+        state.repeats = 0;
+    }
 
+    if (hasSummary)
+        l->dispatch(summary);
+    l->dispatch(record);
 }
 
-void Logger::logToFile(QString message)
+Logger::RepeatState::RepeatState()
+    : repeats(0)
+    , firstRepeatTime(0)
+    , lastRepeatTime(0)
 {
-    QFile logFile(logger()->mLogFilePath);
-    if (logFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
-        QTextStream ts(&logFile);
-        ts << message;
+    Logger* l = logger();
+    std::lock_guard<std::mutex> lock(l->mRepeatStatesMutex);
+    l->mRepeatStates.push_back(this);
+}
+
+/**
+ * @brief Write the pending summary when the thread exits
+ */
+Logger::RepeatState::~RepeatState()
+{
+    Logger* l = logger();
+    {
+        std::lock_guard<std::mutex> lock(l->mRepeatStatesMutex);
+        l->mRepeatStates.erase(std::remove(l->mRepeatStates.begin(), l->mRepeatStates.end(), this),
+                               l->mRepeatStates.end());
     }
-    else {
-        QByteArray path = logger()->mLogFilePath.toLocal8Bit();
-        fprintf(stderr, "Could not open log file for writing at %s", path.constData());
-        fflush(stderr);
+
+    // No other thread can access this state anymore
+    if (repeats > 0)
+        l->dispatch(repeatSummary(previous, repeats, lastRepeatTime));
+}
+
+/**
+ * @brief Write the summaries of repeated messages
+ * @param all If false, only the summaries of repeats that started at least REPEAT_SUMMARY_INTERVAL ago are written
+ *
+ * This is called periodically by the writer thread, so that the summary of a burst of repeats that ended isn't
+ * held back until the thread logs another message.
+ */
+void Logger::flushRepeats(bool all)
+{
+    qint64 now = LogClock::monotonicNanoseconds();
+    std::vector<LogRecord> summaries;
+
+    {
+        std::lock_guard<std::mutex> listLock(mRepeatStatesMutex);
+        for (RepeatState* state : mRepeatStates) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->repeats > 0 && (all || now - state->firstRepeatTime >= REPEAT_SUMMARY_INTERVAL*1000000)) {
+                summaries.push_back(repeatSummary(state->previous, state->repeats, state->lastRepeatTime));
+                state->repeats = 0;
+            }
+        }
     }
+
+    for (LogRecord const& summary : summaries)
+        dispatch(summary);
+}
+
+/**
+ * @brief Send a message to the log writer and to the GUI
+ */
+void Logger::dispatch(const LogRecord &record)
+{
+    mWriter.post(record);
+
+    // Qt aborts as soon as the message handler returns, so the message must be written first
+    if (record.level == QtFatalMsg)
+        mWriter.flush();
+
+    // Logs are stored in a fragmented way to make rich markup easier in QML.
+    // Date is omitted since not particularly useful within the app
+    QStringList toAdd;
+    toAdd << LogClock::formatTime(record.timestamp)
+          << LogRecord::levelName(record.level) << record.text;
+    emit newLogForGUI(toAdd);
 }
 
-void Logger::logToTerminal(QString message)
+LogRecord Logger::repeatSummary(const LogRecord &repeated, int count, qint64 monotonicTime)
 {
-    QByteArray b = message.toLocal8Bit();
-    fprintf(stdout, b.constData());
-    fflush(stdout); // Force output to be printed right away
+    LogRecord summary;
+    summary.monotonicTime = monotonicTime;
+    summary.timestamp = LogClock::toWallTime(monotonicTime);
+    summary.level = repeated.level;
+    summary.text = QString("Previous message repeated %1 times").arg(count);
+    return summary;
 }
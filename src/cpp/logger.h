@@ -1,8 +1,27 @@
 #ifndef LOGGER_H
 #define LOGGER_H
+#include <mutex>
+#include <vector>
+
 #include <QObject>
 #include <QtCore>
 
+#include "logwriter.h"
+
+/**
+ * @brief The Logger class handles all messages logged with qDebug, qInfo, qWarning etc.
+ *
+ * Messages are written to a log file and to the terminal by a LogWriter, in a background thread, and sent to the GUI
+ * via the newLogForGUI signal. Call shutdown() before the application exits, to make sure all messages are written.
+ *
+ * Identical consecutive messages are collapsed into a single "Previous message repeated N times" message. To limit
+ * how often a given message can be logged, see LogRateLimiter. The summary is written when the thread logs a
+ * different message, when it exits, or REPEAT_SUMMARY_INTERVAL after the first repeat (checked by the writer thread),
+ * whichever comes first.
+ *
+ * Log files are rotated, compressed and deleted according to the "logging/..." settings (see the constructor).
+ * Messages can also be filtered per logging category and level, see logging.h and the "logging/filterRules" setting.
+ */
 class Logger : public QObject
 {
     Q_OBJECT
@@ -11,17 +30,43 @@ public:
     static Logger* logger();
     static void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg);
 
+    void shutdown();
+
+    /// Number of messages waiting to be written
+    quint64 queueDepth() { return mWriter.queueDepth(); }
+
 signals:
     void newLogForGUI(QStringList message);
-    void newLogForFile(QString message);
-
-private slots:
-    void logToFile(QString message);
-    void logToTerminal(QString message);
 
 private:
+    /// Repeated messages of one thread, see messageHandler
+    struct RepeatState
+    {
+        RepeatState();
+        ~RepeatState();
+
+        std::mutex mutex;
+        LogRecord previous;
+        int repeats;
+
+        /// Monotonic times of the first and latest repeats, in ns
+        qint64 firstRepeatTime;
+        qint64 lastRepeatTime;
+    };
+
     Logger();
-    QString mLogFilePath;
+    void dispatch(LogRecord const& record);
+    void flushRepeats(bool all);
+    static LogRecord repeatSummary(LogRecord const& repeated, int count, qint64 monotonicTime);
+
+    /// Maximum time during which repeated messages are collapsed before a summary is logged, in ms
+    static const qint64 REPEAT_SUMMARY_INTERVAL = 10000;
+
+    LogWriter mWriter;
+
+    /// Repeat states of all threads that logged a message, for flushRepeats
+    std::mutex mRepeatStatesMutex;
+    std::vector<RepeatState*> mRepeatStates;
 };
 
 #endif // LOGGER_H
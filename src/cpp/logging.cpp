@@ -0,0 +1,50 @@
+#include "logging.h"
+#include "logclock.h"
+
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(lcApplication, "ufcs.application")
+Q_LOGGING_CATEGORY(lcCommunicator, "ufcs.communicator")
+Q_LOGGING_CATEGORY(lcRoutine, "ufcs.routine")
+Q_LOGGING_CATEGORY(lcMicrocontroller, "ufcs.microcontroller")
+
+LogRateLimiter::LogRateLimiter(double ratePerSecond, int burst)
+    : mInterval(qint64(1e9 / qMax(ratePerSecond, 1e-9)))
+    , mBurstTolerance(mInterval * qMax(burst - 1, 0))
+    , mTheoreticalArrivalTime(0)
+    , mSuppressed(0)
+{
+}
+
+/**
+ * @brief Take a token from the bucket
+ * @return -1 if the message should be dropped. Otherwise, the number of messages dropped since the last one that was
+ * logged.
+ */
+int LogRateLimiter::tryAcquire()
+{
+    qint64 now = LogClock::monotonicNanoseconds();
+    qint64 tat = mTheoreticalArrivalTime.load(std::memory_order_relaxed);
+
+    while (true) {
+        qint64 start = std::max(tat, now);
+        if (start - now > mBurstTolerance) {
+            mSuppressed.fetch_add(1, std::memory_order_relaxed);
+            return -1;
+        }
+
+        if (mTheoreticalArrivalTime.compare_exchange_weak(tat, start + mInterval, std::memory_order_relaxed))
+            break;
+    }
+
+    return mSuppressed.exchange(0, std::memory_order_relaxed);
+}
+
+QDebug operator<<(QDebug debug, const LogRateLimiter::SuppressedNote &note)
+{
+    if (note.count > 0) {
+        QDebugStateSaver saver(debug);
+        debug.noquote().nospace() << "[" << note.count << " similar messages suppressed]";
+    }
+    return debug;
+}
@@ -0,0 +1,108 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <atomic>
+
+#include <QtCore>
+
+/*
+ * Logging categories. Each component logs to its own category, so that messages can be enabled or disabled per
+ * component and per level at runtime, with rules such as "ufcs.communicator.debug=false" (see the
+ * "logging/filterRules" setting, and QLoggingCategory::setFilterRules). Messages of a disabled category and level
+ * cost a single branch: the message is neither formatted nor passed to the message handler.
+ */
+Q_DECLARE_LOGGING_CATEGORY(lcApplication)
+Q_DECLARE_LOGGING_CATEGORY(lcCommunicator)
+Q_DECLARE_LOGGING_CATEGORY(lcRoutine)
+Q_DECLARE_LOGGING_CATEGORY(lcMicrocontroller)
+
+/*
+ * Levels below UFCS_LOG_MIN_LEVEL (0: debug, 1: info, 2: warning, 3: critical) are removed at compile time, e.g.
+ * with DEFINES += UFCS_LOG_MIN_LEVEL=1 in the .pro file. The statements are still compiled, so they can't go stale,
+ * but the optimizer removes them entirely.
+ *
+ *     UFCS_DEBUG(lcCommunicator) << "Setting valve" << valveNumber;
+ */
+#ifndef UFCS_LOG_MIN_LEVEL
+#define UFCS_LOG_MIN_LEVEL 0
+#endif
+
+#define UFCS_LOG_DISABLED while (false) QMessageLogger().noDebug()
+
+#if UFCS_LOG_MIN_LEVEL <= 0
+#define UFCS_DEBUG(category) qCDebug(category)
+#else
+#define UFCS_DEBUG(category) UFCS_LOG_DISABLED
+#endif
+
+#if UFCS_LOG_MIN_LEVEL <= 1
+#define UFCS_INFO(category) qCInfo(category)
+#else
+#define UFCS_INFO(category) UFCS_LOG_DISABLED
+#endif
+
+#if UFCS_LOG_MIN_LEVEL <= 2
+#define UFCS_WARNING(category) qCWarning(category)
+#else
+#define UFCS_WARNING(category) UFCS_LOG_DISABLED
+#endif
+
+#if UFCS_LOG_MIN_LEVEL <= 3
+#define UFCS_CRITICAL(category) qCCritical(category)
+#else
+#define UFCS_CRITICAL(category) UFCS_LOG_DISABLED
+#endif
+
+/**
+ * @brief Token bucket limiting how often a message is logged
+ *
+ * Up to `burst` messages can be logged at once, and then at most `ratePerSecond` on average. tryAcquire() is
+ * lock-free (it uses the equivalent "generic cell rate" formulation of the token bucket, which only needs one atomic
+ * timestamp), so it can be used on hot paths and from any thread.
+ *
+ * Messages that are dropped are counted, and the count is returned by the next successful call to tryAcquire, so
+ * that the log shows how many messages were suppressed.
+ *
+ * The LOG_RATE_LIMITED macro creates a bucket for each call site:
+ *
+ *     LOG_RATE_LIMITED(UFCS_WARNING(lcCommunicator), 1, 5) << "Invalid message received:" << buffer;
+ */
+class LogRateLimiter
+{
+public:
+    LogRateLimiter(double ratePerSecond = 1, int burst = 1);
+
+    int tryAcquire();
+
+    /// Note prefixed to rate-limited messages, e.g. "[12 similar messages suppressed]", if any were suppressed
+    struct SuppressedNote
+    {
+        int count;
+    };
+
+private:
+    /// Interval between tokens, and how far ahead of time the bucket may be used (i.e. the burst size), in ns
+    qint64 mInterval;
+    qint64 mBurstTolerance;
+
+    /// Time at which the bucket would be full again, in ns (on a monotonic clock)
+    std::atomic<qint64> mTheoreticalArrivalTime;
+
+    std::atomic<int> mSuppressed;
+};
+
+QDebug operator<<(QDebug debug, LogRateLimiter::SuppressedNote const& note);
+
+/**
+ * Log with the given statement (qDebug(), UFCS_WARNING(lcCommunicator)...) at most ratePerSecond times per second on
+ * average, with bursts of up to `burst` messages. The bucket is shared by all calls from this line of code.
+ */
+#define LOG_RATE_LIMITED(logStatement, ratePerSecond, burst) \
+    for (int logSuppressedCount = []() -> LogRateLimiter& { \
+             static LogRateLimiter limiter(ratePerSecond, burst); \
+             return limiter; }().tryAcquire(); \
+         logSuppressedCount >= 0; \
+         logSuppressedCount = -1) \
+        logStatement << LogRateLimiter::SuppressedNote{logSuppressedCount}
+
+#endif // LOGGING_H
@@ -0,0 +1,182 @@
+#include "logmodel.h"
+
+LogModel::LogModel(int capacity, QObject *parent)
+    : QAbstractListModel(parent)
+    , mCapacity(qMax(1, capacity))
+    , mFirstSequence(0)
+    , mNextSequence(0)
+    , mMinimumLevel(Debug)
+{
+    mEntries.resize(mCapacity);
+}
+
+int LogModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return int(mVisible.size());
+}
+
+QVariant LogModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= rowCount())
+        return QVariant();
+
+    Entry const& e = entry(mVisible[size_t(index.row())]);
+
+    switch (role) {
+    case TimestampRole:
+        return e.timestamp;
+    case LevelRole:
+        return e.levelName;
+    case MessageRole:
+    case Qt::DisplayRole:
+        return e.message;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> LogModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles[TimestampRole] = "timestamp";
+    roles[LevelRole] = "level";
+    roles[MessageRole] = "message";
+    return roles;
+}
+
+/**
+ * @brief Set the maximum number of messages kept. The most recent messages are kept if the capacity is reduced.
+ */
+void LogModel::setCapacity(int capacity)
+{
+    capacity = qMax(1, capacity);
+    if (capacity == mCapacity)
+        return;
+
+    quint64 count = qMin(mNextSequence - mFirstSequence, quint64(capacity));
+    quint64 first = mNextSequence - count;
+
+    QVector<Entry> entries(capacity);
+    for (quint64 s = first; s < mNextSequence; ++s)
+        entries[int(s % quint64(capacity))] = entry(s);
+
+    beginResetModel();
+    mEntries = entries;
+    mCapacity = capacity;
+    mFirstSequence = first;
+    rebuildVisible();
+    endResetModel();
+
+    emit capacityChanged(capacity);
+}
+
+/**
+ * @brief Only show messages of the given level (see LogModel::Level) and above
+ */
+void LogModel::setMinimumLevel(int level)
+{
+    if (level == mMinimumLevel)
+        return;
+
+    beginResetModel();
+    mMinimumLevel = level;
+    rebuildVisible();
+    endResetModel();
+
+    emit filterChanged();
+}
+
+/**
+ * @brief Only show messages containing the given text (case-insensitive). An empty text matches all messages.
+ */
+void LogModel::setFilterText(const QString &text)
+{
+    if (text == mFilterText)
+        return;
+
+    beginResetModel();
+    mFilterText = text;
+    rebuildVisible();
+    endResetModel();
+
+    emit filterChanged();
+}
+
+LogModel::Level LogModel::levelFromName(const QString &name)
+{
+    if (name == "Debug")
+        return Debug;
+    else if (name == "Info")
+        return Info;
+    else if (name == "Warning")
+        return Warning;
+    return Error;
+}
+
+/**
+ * @brief Add a message, as emitted by Logger::newLogForGUI (timestamp, level name and message text)
+ *
+ * If the buffer is full, the oldest message is removed.
+ */
+void LogModel::append(const QStringList &entry)
+{
+    if (entry.size() < 3)
+        return;
+
+    if (mNextSequence - mFirstSequence == quint64(mCapacity)) {
+        if (!mVisible.empty() && mVisible.front() == mFirstSequence) {
+            beginRemoveRows(QModelIndex(), 0, 0);
+            mVisible.pop_front();
+            endRemoveRows();
+        }
+        mFirstSequence++;
+    }
+
+    Entry& e = mEntries[int(mNextSequence % quint64(mCapacity))];
+    e.timestamp = entry[0];
+    e.levelName = entry[1];
+    e.message = entry[2];
+    e.level = levelFromName(entry[1]);
+
+    quint64 sequenceNumber = mNextSequence++;
+
+    if (matchesFilter(e)) {
+        int row = int(mVisible.size());
+        beginInsertRows(QModelIndex(), row, row);
+        mVisible.push_back(sequenceNumber);
+        endInsertRows();
+    }
+}
+
+void LogModel::clear()
+{
+    beginResetModel();
+    mFirstSequence = mNextSequence;
+    mVisible.clear();
+    endResetModel();
+}
+
+bool LogModel::matchesFilter(const Entry &entry) const
+{
+    if (entry.level < mMinimumLevel)
+        return false;
+
+    return mFilterText.isEmpty() || entry.message.contains(mFilterText, Qt::CaseInsensitive);
+}
+
+const LogModel::Entry &LogModel::entry(quint64 sequenceNumber) const
+{
+    return mEntries[int(sequenceNumber % quint64(mCapacity))];
+}
+
+void LogModel::rebuildVisible()
+{
+    mVisible.clear();
+    for (quint64 s = mFirstSequence; s < mNextSequence; ++s) {
+        if (matchesFilter(entry(s)))
+            mVisible.push_back(s);
+    }
+}
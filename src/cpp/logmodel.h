@@ -0,0 +1,94 @@
+#ifndef LOGMODEL_H
+#define LOGMODEL_H
+
+#include <deque>
+
+#include <QAbstractListModel>
+#include <QtCore>
+
+/**
+ * @brief List model of the most recent log messages, for display in the GUI
+ *
+ * Messages are stored in a ring buffer of fixed capacity: once it is full, each new message replaces the oldest one.
+ * Rows are inserted and removed individually, so views only need to update the affected delegates, and adding a
+ * message takes constant time regardless of how many were logged before.
+ *
+ * The model can be filtered by minimum severity level and by text. Filtering is done here rather than in QML: the
+ * rows of the model are only the messages that match the current filter.
+ */
+class LogModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int capacity READ capacity WRITE setCapacity NOTIFY capacityChanged)
+    Q_PROPERTY(int minimumLevel READ minimumLevel WRITE setMinimumLevel NOTIFY filterChanged)
+    Q_PROPERTY(QString filterText READ filterText WRITE setFilterText NOTIFY filterChanged)
+
+public:
+    enum Roles {
+        TimestampRole = Qt::UserRole + 1,
+        LevelRole,
+        MessageRole
+    };
+
+    /// Severity levels, in increasing order (unlike QtMsgType)
+    enum Level {
+        Debug,
+        Info,
+        Warning,
+        Error
+    }; Q_ENUM(Level)
+
+    LogModel(int capacity = 5000, QObject* parent = nullptr);
+
+    int rowCount(QModelIndex const& parent = QModelIndex()) const;
+    QVariant data(QModelIndex const& index, int role = Qt::DisplayRole) const;
+    QHash<int, QByteArray> roleNames() const;
+
+    int capacity() const { return mCapacity; }
+    void setCapacity(int capacity);
+
+    int minimumLevel() const { return mMinimumLevel; }
+    void setMinimumLevel(int level);
+
+    QString filterText() const { return mFilterText; }
+    void setFilterText(QString const& text);
+
+    static Level levelFromName(QString const& name);
+
+public slots:
+    void append(QStringList const& entry);
+    void clear();
+
+signals:
+    void capacityChanged(int capacity);
+    void filterChanged();
+
+private:
+    struct Entry
+    {
+        QString timestamp;
+        QString levelName;
+        QString message;
+        Level level;
+    };
+
+    bool matchesFilter(Entry const& entry) const;
+    Entry const& entry(quint64 sequenceNumber) const;
+    void rebuildVisible();
+
+    /// Ring buffer; the message with sequence number n is stored at index n % mCapacity
+    QVector<Entry> mEntries;
+    int mCapacity;
+
+    /// Sequence numbers of the oldest stored message, and of the next message to be added
+    quint64 mFirstSequence;
+    quint64 mNextSequence;
+
+    /// Sequence numbers of the messages that match the filter, i.e. the rows of the model
+    std::deque<quint64> mVisible;
+
+    int mMinimumLevel;
+    QString mFilterText;
+};
+
+#endif // LOGMODEL_H
@@ -0,0 +1,347 @@
+#include "logwriter.h"
+
+#include <algorithm>
+
+LogWriter::LogWriter()
+    : mHead(&mStub)
+    , mTail(&mStub)
+    , mRunning(false)
+    , mStopRequested(false)
+    , mPosting(0)
+    , mUrgent(false)
+    , mPosted(0)
+    , mWritten(0)
+    , mBinaryLog(false)
+{
+    mStub.next = nullptr;
+}
+
+LogWriter::~LogWriter()
+{
+    stop();
+}
+
+/**
+ * @brief Open a new log segment and start the writer thread
+ * @param directory The directory where logs are stored
+ * @param binaryLog If true, the binary log is written in addition to the text log
+ * @param policy When to rotate segments, and how long to keep them
+ *
+ * Messages posted before this is called are queued, and written once the thread is started.
+ */
+void LogWriter::start(const QString &directory, bool binaryLog, const LogRotationPolicy &policy)
+{
+    if (mRunning)
+        return;
+
+    mDirectory = QDir(directory).absolutePath();
+    mBinaryLog = binaryLog;
+    mPolicy = policy;
+    mArchiver.setPolicy(policy);
+
+    openSegment();
+
+    // Segments left uncompressed by previous sessions (e.g. after a crash)
+    QStringList previous;
+    QStringList active = QStringList() << mFile.fileName() << mBinaryFile.fileName();
+    for (QFileInfo const& file : QDir(mDirectory).entryInfoList(QStringList() << "log_*.txt" << "log_*.bin", QDir::Files)) {
+        if (!active.contains(file.absoluteFilePath()))
+            previous << file.absoluteFilePath();
+    }
+    mArchiver.archive(previous, mDirectory, active);
+
+    mStopRequested = false;
+    mRunning = true;
+    mThread = std::thread([this] { run(); });
+}
+
+/**
+ * @brief Return the path of the text log file currently being written
+ */
+QString LogWriter::currentFilePath()
+{
+    std::lock_guard<std::mutex> lock(mFileMutex);
+    return mFile.fileName();
+}
+
+/**
+ * @brief Write all pending messages, stop the writer thread and close the log file
+ */
+void LogWriter::stop()
+{
+    if (!mRunning)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+        mStopRequested = true;
+    }
+    mWakeConditionVariable.notify_one();
+    mThread.join();
+    mRunning = false;
+
+    // Posts that didn't see mStopRequested push their message; wait for them to be done. This is short, as
+    // post() doesn't block between its check and its push.
+    while (mPosting > 0)
+        std::this_thread::yield();
+
+    // Messages pushed while the thread was stopping. The thread is gone, so it is safe to pop from here
+    std::vector<LogRecord> batch;
+    while (Node* node = pop()) {
+        batch.push_back(node->record);
+        delete node;
+    }
+    if (!batch.empty())
+        writeBatch(batch);
+
+    std::lock_guard<std::mutex> lock(mFileMutex);
+    mFile.close();
+    mBinaryFile.close();
+}
+
+/**
+ * @brief Queue a message to be written. This never blocks, except after stop() was called.
+ *
+ * Warnings and errors are written without waiting for the flush interval.
+ */
+void LogWriter::post(const LogRecord &record)
+{
+    // mPosting is incremented before checking mStopRequested, and stop() sets mStopRequested before checking
+    // mPosting, so either the message is written here, or stop() waits for it to be pushed before draining.
+    mPosting++;
+
+    if (mStopRequested) {
+        mPosting--;
+        std::vector<LogRecord> batch(1, record);
+        writeBatch(batch);
+        return;
+    }
+
+    Node* node = new Node;
+    node->record = record;
+    push(node);
+    mPosted++;
+    mPosting--;
+
+    QtMsgType type = record.level;
+    if (type == QtWarningMsg || type == QtCriticalMsg || type == QtFatalMsg) {
+        // The mutex isn't locked here, so this can't block. If the writer misses this notification,
+        // the message is still written within the flush interval.
+        mUrgent = true;
+        mWakeConditionVariable.notify_one();
+    }
+}
+
+/**
+ * @brief Block until all messages posted so far have been written
+ */
+void LogWriter::flush()
+{
+    if (!mRunning || mStopRequested)
+        return;
+
+    quint64 target = mPosted;
+
+    {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+        mUrgent = true;
+    }
+    mWakeConditionVariable.notify_one();
+
+    std::unique_lock<std::mutex> lock(mFlushMutex);
+    mFlushConditionVariable.wait_for(lock, std::chrono::seconds(2), [this, target] { return mWritten >= target; });
+}
+
+/**
+ * @brief Return the number of messages posted but not written yet
+ */
+quint64 LogWriter::queueDepth()
+{
+    quint64 posted = mPosted;
+    std::lock_guard<std::mutex> lock(mFlushMutex);
+    return posted > mWritten ? posted - mWritten : 0;
+}
+
+/**
+ * @brief Set a function to be called by the writer thread before writing each batch, i.e. at least every
+ * FLUSH_INTERVAL milliseconds. Messages it posts are written in the same batch. This must be called before start().
+ */
+void LogWriter::setPeriodicTask(const std::function<void ()> &task)
+{
+    mPeriodicTask = task;
+}
+
+void LogWriter::push(LogWriter::Node *node)
+{
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node* previous = mHead.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+}
+
+/**
+ * @brief Pop the oldest message from the queue. Only the writer thread may call this.
+ * @return The node, to be deleted by the caller, or nullptr if the queue is empty (or a push is in progress)
+ */
+LogWriter::Node* LogWriter::pop()
+{
+    Node* tail = mTail;
+    Node* next = tail->next.load(std::memory_order_acquire);
+
+    if (tail == &mStub) {
+        if (next == nullptr)
+            return nullptr;
+        mTail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next) {
+        mTail = next;
+        return tail;
+    }
+
+    if (tail != mHead.load(std::memory_order_acquire))
+        return nullptr;
+
+    push(&mStub);
+
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+        mTail = next;
+        return tail;
+    }
+
+    return nullptr;
+}
+
+void LogWriter::run()
+{
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mWakeMutex);
+            mWakeConditionVariable.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL),
+                                            [this] { return mUrgent || mStopRequested; });
+            mUrgent = false;
+        }
+
+        if (mPeriodicTask)
+            mPeriodicTask();
+
+        std::vector<LogRecord> batch;
+        while (Node* node = pop()) {
+            batch.push_back(std::move(node->record));
+            delete node;
+        }
+
+        if (!batch.empty())
+            writeBatch(batch);
+
+        {
+            std::lock_guard<std::mutex> lock(mFlushMutex);
+            mWritten += batch.size();
+        }
+        mFlushConditionVariable.notify_all();
+
+        if (mStopRequested)
+            break;
+    }
+}
+
+/**
+ * @brief Write a batch of messages, in the order in which they were logged
+ *
+ * Messages from different threads can be queued slightly out of order (a message may be timestamped, then
+ * pushed after one logged later by another thread), so they are sorted by their monotonic timestamp first.
+ */
+void LogWriter::writeBatch(std::vector<LogRecord> &records)
+{
+    std::stable_sort(records.begin(), records.end(), [](LogRecord const& a, LogRecord const& b) {
+        return a.monotonicTime < b.monotonicTime;
+    });
+
+    std::lock_guard<std::mutex> lock(mFileMutex);
+
+    QString text;
+    QByteArray binary;
+    for (LogRecord const& record : records) {
+        text += record.toText();
+        if (mBinaryFile.isOpen())
+            binary += record.encode();
+    }
+
+    // Segment sizes are in bytes, so the size check is done on the encoded text
+    QByteArray utf8 = text.toUtf8();
+
+    if (mFile.isOpen() && mFile.size() > 0) {
+        bool tooBig = mPolicy.maxSegmentSize > 0 && mFile.size() + utf8.size() > mPolicy.maxSegmentSize;
+        bool tooOld = mPolicy.maxSegmentAge > 0 && mSegmentTimer.elapsed() > mPolicy.maxSegmentAge*1000;
+        if (tooBig || tooOld)
+            rotate();
+    }
+
+    if (mFile.isOpen()) {
+        mFile.write(utf8);
+        mFile.flush();
+    }
+
+    if (mBinaryFile.isOpen() && !binary.isEmpty()) {
+        mBinaryFile.write(binary);
+        mBinaryFile.flush();
+    }
+
+    QByteArray b = text.toLocal8Bit();
+    fwrite(b.constData(), 1, size_t(b.size()), stdout);
+    fflush(stdout);
+}
+
+/**
+ * @brief Open new log files, named after the current date and time. mFileMutex must be locked, or the thread stopped.
+ */
+void LogWriter::openSegment()
+{
+    QString baseName = "log_" + QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss");
+    QString path = QDir::cleanPath(mDirectory + "/" + baseName);
+
+    // In case several segments are created within the same second
+    for (int i(1); QFile::exists(path + ".txt") || QFile::exists(path + ".txt.gz"); ++i)
+        path = QDir::cleanPath(mDirectory + "/" + baseName + "_" + QString::number(i));
+
+    mFile.setFileName(path + ".txt");
+    if (!mFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        QByteArray p = mFile.fileName().toLocal8Bit();
+        fprintf(stderr, "Could not open log file for writing at %s\n", p.constData());
+        fflush(stderr);
+    }
+
+    if (mBinaryLog) {
+        mBinaryFile.setFileName(path + ".bin");
+        if (!mBinaryFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            QByteArray p = mBinaryFile.fileName().toLocal8Bit();
+            fprintf(stderr, "Could not open binary log file for writing at %s\n", p.constData());
+            fflush(stderr);
+        }
+        else
+            mBinaryFile.write(StructuredLog::FILE_MAGIC, sizeof(StructuredLog::FILE_MAGIC));
+    }
+
+    mSegmentTimer.start();
+}
+
+/**
+ * @brief Close the current segment, hand it over to the archiver, and open a new one. mFileMutex must be locked.
+ */
+void LogWriter::rotate()
+{
+    QStringList closed;
+    closed << mFile.fileName();
+    mFile.close();
+
+    if (mBinaryFile.isOpen()) {
+        closed << mBinaryFile.fileName();
+        mBinaryFile.close();
+    }
+
+    openSegment();
+
+    mArchiver.archive(closed, mDirectory, QStringList() << mFile.fileName() << mBinaryFile.fileName());
+}
@@ -0,0 +1,110 @@
+#ifndef LOGWRITER_H
+#define LOGWRITER_H
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+
+#include <QtCore>
+
+#include "structuredlog.h"
+#include "logarchiver.h"
+
+/**
+ * @brief Writes log messages to the log file and to the terminal, on a background thread
+ *
+ * Messages are formatted as text by the writer thread. If the binary log is enabled, records are also written in the
+ * structured format described in StructuredLog.
+ *
+ * Logs are written in segments (log_<date>_<time>.txt, and .bin for the binary log), which are rotated according to
+ * a LogRotationPolicy. Rotation is done by the writer thread; closed segments are then compressed, and old ones
+ * deleted, by a LogArchiver. Uncompressed segments left by previous sessions are archived on start().
+ *
+ * post() pushes a message onto a lock-free multi-producer, single-consumer queue, so it never blocks the thread
+ * that logs a message (including the GUI thread). The writer thread keeps the log file open, and writes messages in
+ * batches: every FLUSH_INTERVAL milliseconds, or right away when a warning or more severe message is posted. Each
+ * batch is sorted by the messages' monotonic timestamps (see LogClock).
+ *
+ * flush() blocks until all messages posted so far are written; it is used for fatal errors, before the application
+ * aborts. After stop(), messages are written synchronously.
+ */
+class LogWriter
+{
+public:
+    LogWriter();
+    ~LogWriter();
+
+    void start(QString const& directory, bool binaryLog = false, LogRotationPolicy const& policy = LogRotationPolicy());
+    void stop();
+
+    QString currentFilePath();
+
+    void post(LogRecord const& record);
+    void flush();
+
+    quint64 queueDepth();
+
+    void setPeriodicTask(std::function<void()> const& task);
+
+    /// Maximum time messages wait in the queue before being written, in milliseconds
+    static const int FLUSH_INTERVAL = 200;
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> next;
+        LogRecord record;
+    };
+
+    void push(Node* node);
+    Node* pop();
+
+    void run();
+    void writeBatch(std::vector<LogRecord>& records);
+
+    void openSegment();
+    void rotate();
+
+    /// Queue (intrusive MPSC queue by D. Vyukov). Producers push at mHead; the writer thread pops at mTail.
+    std::atomic<Node*> mHead;
+    Node* mTail;
+    Node mStub;
+
+    std::thread mThread;
+    std::atomic<bool> mRunning;
+    std::atomic<bool> mStopRequested;
+
+    /// Called by the writer thread before each batch
+    std::function<void()> mPeriodicTask;
+
+    /// Number of post() calls between checking mStopRequested and pushing their message. stop() waits for this to
+    /// reach 0 before draining the queue, so that no message is pushed after the last drain.
+    std::atomic<int> mPosting;
+
+    /// Set when a message should be written without waiting for the flush interval
+    std::atomic<bool> mUrgent;
+    std::mutex mWakeMutex;
+    std::condition_variable mWakeConditionVariable;
+
+    /// Number of messages posted and written, used by flush()
+    std::atomic<quint64> mPosted;
+    quint64 mWritten;
+    std::mutex mFlushMutex;
+    std::condition_variable mFlushConditionVariable;
+
+    /// Protects the file and stdout, in case messages are written synchronously after stop()
+    std::mutex mFileMutex;
+    QFile mFile;
+    QFile mBinaryFile;
+
+    QString mDirectory;
+    bool mBinaryLog;
+    LogRotationPolicy mPolicy;
+    QElapsedTimer mSegmentTimer;
+    LogArchiver mArchiver;
+};
+
+#endif // LOGWRITER_H
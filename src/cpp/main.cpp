@@ -1,24 +1,33 @@
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
+#include <QQuickWindow>
+
+#include <memory>
 
 
 #include "src/cpp/communicator.h"
 #include "src/cpp/applicationcontroller.h"
 #include "src/cpp/guihelper.h"
 #include "src/cpp/logger.h"
+#include "src/cpp/pressurechart.h"
+#include "src/cpp/startupprofile.h"
 
 
 int main(int argc, char *argv[])
 {
+    StartupProfile::start();
+
     QCoreApplication::setApplicationName("ufcs-pc");
     QCoreApplication::setOrganizationName("ufcs");
 
     Logger* logger = Logger::logger();
     qInstallMessageHandler(Logger::messageHandler);
+    StartupProfile::mark("Logger initialized");
 
     ApplicationController* appController = new ApplicationController();
-    QObject::connect(logger, &Logger::newLogForGUI, appController, &ApplicationController::addToLog);
+    StartupProfile::mark("Application controller created");
+    QObject::connect(logger, &Logger::newLogForGUI, appController->logModel(), &LogModel::append);
 
     QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
     QGuiApplication app(argc, argv);
@@ -26,6 +35,10 @@ int main(int argc, char *argv[])
     qmlRegisterType<PCHelper>("org.example.ufcs", 1, 0, "PCHelper");
     qmlRegisterType<ValveSwitchHelper>("org.example.ufcs", 1, 0, "ValveSwitchHelper");
     qmlRegisterType<PumpSwitchHelper>("org.example.ufcs", 1, 0, "PumpSwitchHelper");
+    qmlRegisterUncreatableType<DeviceState>("org.example.ufcs", 1, 0, "DeviceState", "DeviceState is provided by Backend.deviceState");
+    qmlRegisterUncreatableType<LogModel>("org.example.ufcs", 1, 0, "LogModel", "LogModel is provided by Backend.logModel");
+    qmlRegisterUncreatableType<PressureTimeSeries>("org.example.ufcs", 1, 0, "PressureTimeSeries", "PressureTimeSeries is provided by Backend.pressureSeries");
+    qmlRegisterType<PressureChart>("org.example.ufcs", 1, 0, "PressureChart");
     qmlRegisterSingletonType(QUrl("qrc:/src/qml/Style.qml"), "org.example.ufcs", 1, 0, "Style"); // an alternative to this not-very-clean solution is to use a qmldir file. This way the QML-only stuff would stay separate from C++.
 
     QQmlApplicationEngine engine;
@@ -35,7 +48,24 @@ int main(int argc, char *argv[])
     engine.load(QUrl(QLatin1String("qrc:/src/qml/main.qml")));
     if (engine.rootObjects().isEmpty())
         return -1;
+    StartupProfile::mark("QML engine loaded");
+
+    // frameSwapped is emitted by the render thread, for every frame; only the first one is of interest
+    QQuickWindow* window = qobject_cast<QQuickWindow*>(engine.rootObjects().first());
+    if (window) {
+        auto connection = std::make_shared<QMetaObject::Connection>();
+        *connection = QObject::connect(window, &QQuickWindow::frameSwapped, window, [connection]() {
+            StartupProfile::mark("First frame");
+            QObject::disconnect(*connection);
+        }, Qt::DirectConnection);
+    }
+
+
+    int status = app.exec();
 
+    // Settings, pressure history and exports are written in the background; make sure the last ones are saved
+    appController->shutdown();
 
-    return app.exec();
+    logger->shutdown();
+    return status;
 }
@@ -0,0 +1,204 @@
+#include "multiplexer.h"
+#include "constants.h"
+
+namespace {
+
+struct ChannelDefinition {
+    const char* label;
+    const char* configuration;
+};
+
+Multiplexer defineMultiplexer(QString const& name, QList<uint> const& valves,
+                              std::initializer_list<ChannelDefinition> channels)
+{
+    Multiplexer mux(name, valves);
+    for (ChannelDefinition const& c : channels)
+        mux.addChannel(c.label, c.configuration);
+    return mux;
+}
+
+}
+
+Multiplexer::Multiplexer()
+    : mNoneChannel({"None", 0, 0})
+{
+}
+
+/**
+ * @brief Create a multiplexer with no channels
+ * @param name The name of the multiplexer. Built-in multiplexers are named after the graphical
+ * control screen of the corresponding chip.
+ * @param valves The control valves of the multiplexer, in the same order as in channel configurations
+ */
+Multiplexer::Multiplexer(const QString &name, const QList<uint> &valves)
+    : mName(name)
+    , mValves(valves)
+    , mNoneChannel({"None", 0, 0})
+{
+    for (uint v : valves) {
+        if (v < 1 || v > N_VALVES)
+            qWarning() << "Multiplexer" << name << ": invalid valve number" << v;
+        else
+            mNoneChannel.openMask |= 1u << (v - 1);
+    }
+}
+
+/**
+ * @brief Add a channel to the multiplexer
+ * @param label The label of the channel, e.g. "1" or "All"
+ * @param configuration One character per valve: "1" to open the valve, "0" to close it
+ * @return False if the configuration is invalid, in which case the channel is not added.
+ */
+bool Multiplexer::addChannel(const QString &label, const QString &configuration)
+{
+    if (configuration.length() != mValves.size()) {
+        qWarning() << "Multiplexer" << mName << ": configuration of channel" << label
+                   << "does not match the number of valves";
+        return false;
+    }
+
+    Channel channel {label, 0, 0};
+
+    for (int i(0); i < configuration.length(); ++i) {
+        uint valve = mValves[i];
+        if (valve < 1 || valve > N_VALVES)
+            return false;
+
+        quint32 bit = 1u << (valve - 1);
+
+        if (configuration[i] == '1')
+            channel.openMask |= bit;
+        else if (configuration[i] == '0')
+            channel.closeMask |= bit;
+        else {
+            qWarning() << "Multiplexer" << mName << ": invalid configuration for channel" << label << ":" << configuration;
+            return false;
+        }
+    }
+
+    mChannelIndices[label.toUpper()] = mChannels.size();
+    mChannels.push_back(channel);
+    return true;
+}
+
+/**
+ * @brief Look up a channel by its label
+ * @param label The channel label (case-insensitive)
+ * @param channel Set to the matching channel, if one is found
+ * @return True if the channel was found
+ */
+bool Multiplexer::findChannel(const QString &label, Multiplexer::Channel &channel) const
+{
+    QString key = label.toUpper();
+
+    auto it = mChannelIndices.find(key);
+    if (it != mChannelIndices.end()) {
+        channel = mChannels[it.value()];
+        return true;
+    }
+
+    if (key == "NONE") {
+        channel = mNoneChannel;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Return the labels of all defined channels, in the order in which they were defined
+ */
+QStringList Multiplexer::channelLabels() const
+{
+    QStringList labels;
+    for (Channel const& c : mChannels)
+        labels << c.label;
+    return labels;
+}
+
+/**
+ * @brief Return the multiplexers of the chips supported out of the box (co-culture chips v4 and v5)
+ */
+QList<Multiplexer> Multiplexer::builtInMultiplexers()
+{
+    QList<Multiplexer> multiplexers;
+
+    multiplexers << defineMultiplexer("Co-culture chip v4", {13, 14, 15, 16, 17, 18}, {
+        {"1", "101010"},
+        {"2", "011010"},
+        {"3", "100110"},
+        {"4", "010110"},
+        {"5", "101001"},
+        {"6", "011001"},
+        {"7", "100101"},
+        {"8", "010101"},
+        {"All", "000000"},
+        {"None", "111111"}
+    });
+
+    multiplexers << defineMultiplexer("Co-culture chip v5", {3, 4, 5, 6, 7, 8, 9, 10, 12, 13}, {
+        {"1", "1010101010"},
+        {"2", "1010101001"},
+        {"3", "1010100110"},
+        {"4", "1010100101"},
+        {"5", "1010011010"},
+        {"6", "1010011001"},
+        {"7", "1010010110"},
+        {"8", "1010010101"},
+        {"9", "1001101010"},
+        {"10", "1001101001"},
+        {"11", "1001100110"},
+        {"12", "1001100101"},
+        {"13", "1001011010"},
+        {"14", "1001011001"},
+        {"15", "1001010110"},
+        {"16", "1001010101"},
+        {"17", "0110101010"},
+        {"18", "0110101001"},
+        {"19", "0110100110"},
+        {"20", "0110100101"},
+        {"21", "0110011010"},
+        {"22", "0110011001"},
+        {"23", "0110010110"},
+        {"24", "0110010101"},
+        {"25", "0101101010"},
+        {"26", "0101101001"},
+        {"27", "0101100110"},
+        {"28", "0101100101"},
+        {"29", "0101011010"},
+        {"30", "0101011001"},
+        {"31", "0101010110"},
+        {"32", "0101010101"},
+        {"All", "0000000000"},
+        {"None", "1111111111"},
+        {"1-8", "1010000000"},
+        {"9-16", "1001000000"},
+        {"17-24", "0110000000"},
+        {"25-32", "0101000000"},
+        {"Odd", "0000000010"},
+        {"Even", "0000000001"}
+    });
+
+    // Input multiplexer of the v5 chip. Each channel corresponds to one fluidic input,
+    // hence the purely numerical labels (they are used as valve numbers for the input labels).
+    multiplexers << defineMultiplexer("Co-culture chip v5 inputs", {22, 23, 24, 25, 26, 27, 28, 29}, {
+        {"1", "01010101"},
+        {"2", "01010110"},
+        {"3", "01011001"},
+        {"4", "01011010"},
+        {"5", "01100101"},
+        {"6", "01100110"},
+        {"7", "01101001"},
+        {"8", "01101010"},
+        {"9", "10010101"},
+        {"10", "10010110"},
+        {"11", "10011001"},
+        {"12", "10011010"},
+        {"13", "10100101"},
+        {"14", "10100110"},
+        {"15", "10101001"},
+        {"16", "10101010"}
+    });
+
+    return multiplexers;
+}
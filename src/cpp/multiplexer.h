@@ -0,0 +1,65 @@
+#ifndef MULTIPLEXER_H
+#define MULTIPLEXER_H
+
+#include <QtCore>
+
+/**
+ * @brief The Multiplexer class holds the definition of a microfluidic multiplexer
+ *
+ * A multiplexer consists of a number of control valves that direct flow into a larger number of
+ * channels; for example, 6 control valves can direct flow into 8 channels.
+ * See MultiplexerControl.qml for a more detailed explanation.
+ *
+ * Each channel has a label (e.g. "1", "All", "Odd") and a configuration string, with one character
+ * per control valve: "1" if the valve should be open, and "0" if it should be closed. For example, if the
+ * multiplexer uses valves [13, 14, 15, 16, 17, 18], the configuration "101010" means opening valves
+ * 13, 15 and 17, and closing valves 14, 16 and 18.
+ *
+ * Configurations are compiled to bitmasks when a channel is added (bit 0 corresponds to valve 1,
+ * bit 1 to valve 2 and so on), so that switching to a channel is a single call to
+ * Communicator::setValves.
+ *
+ * Labels are case-insensitive. If no channel is labeled "None", one is defined implicitly, which
+ * opens all control valves (thus closing all channels).
+ *
+ * The multiplexers of the co-culture chips are defined in multiplexer.cpp, and loaded by
+ * ApplicationController at startup.
+ */
+class Multiplexer
+{
+public:
+    struct Channel {
+        QString label;
+        /// The valves to open when this channel is selected
+        quint32 openMask;
+        /// The valves to close when this channel is selected
+        quint32 closeMask;
+    };
+
+    Multiplexer();
+    Multiplexer(QString const& name, QList<uint> const& valves);
+
+    QString name() const { return mName; }
+    QList<uint> valves() const { return mValves; }
+
+    bool addChannel(QString const& label, QString const& configuration);
+    bool findChannel(QString const& label, Channel& channel) const;
+    QStringList channelLabels() const;
+
+    static QList<Multiplexer> builtInMultiplexers();
+
+private:
+    QString mName;
+    QList<uint> mValves;
+
+    /// Channels, in the order in which they were defined
+    QVector<Channel> mChannels;
+
+    /// Index of each channel in mChannels, with the (uppercase) label as key
+    QHash<QString, int> mChannelIndices;
+
+    /// The channel used when "None" is requested but not explicitly defined
+    Channel mNoneChannel;
+};
+
+#endif // MULTIPLEXER_H
@@ -0,0 +1,177 @@
+#include "pressurechart.h"
+#include "logclock.h"
+
+#include <QSGGeometryNode>
+#include <QSGFlatColorMaterial>
+
+PressureChart::PressureChart(QQuickItem *parent)
+    : QQuickItem(parent)
+    , mSeries(nullptr)
+    , mControllerNumber(1)
+    , mTimeWindow(600)
+    , mMinimum(0)
+    , mMaximum(1)
+    , mMeasuredColor(Qt::blue)
+    , mSetpointColor(Qt::gray)
+{
+    setFlag(ItemHasContents, true);
+}
+
+void PressureChart::setSeries(PressureTimeSeries *series)
+{
+    if (series == mSeries)
+        return;
+
+    if (mSeries)
+        disconnect(mSeries, nullptr, this, nullptr);
+
+    mSeries = series;
+
+    if (mSeries)
+        connect(mSeries, &PressureTimeSeries::samplesAdded, this, &PressureChart::onSamplesAdded);
+
+    emit seriesChanged();
+    update();
+}
+
+void PressureChart::setControllerNumber(int controllerNumber)
+{
+    if (controllerNumber == mControllerNumber)
+        return;
+
+    mControllerNumber = controllerNumber;
+    emit controllerNumberChanged();
+    update();
+}
+
+void PressureChart::setTimeWindow(double seconds)
+{
+    if (seconds == mTimeWindow || seconds <= 0)
+        return;
+
+    mTimeWindow = seconds;
+    emit timeWindowChanged();
+    update();
+}
+
+void PressureChart::setMinimum(double minimum)
+{
+    if (minimum == mMinimum)
+        return;
+
+    mMinimum = minimum;
+    emit rangeChanged();
+    update();
+}
+
+void PressureChart::setMaximum(double maximum)
+{
+    if (maximum == mMaximum)
+        return;
+
+    mMaximum = maximum;
+    emit rangeChanged();
+    update();
+}
+
+void PressureChart::setMeasuredColor(const QColor &color)
+{
+    if (color == mMeasuredColor)
+        return;
+
+    mMeasuredColor = color;
+    emit colorsChanged();
+    update();
+}
+
+void PressureChart::setSetpointColor(const QColor &color)
+{
+    if (color == mSetpointColor)
+        return;
+
+    mSetpointColor = color;
+    emit colorsChanged();
+    update();
+}
+
+void PressureChart::onSamplesAdded(int controllerNumber)
+{
+    // Several samples can arrive per frame; update() only schedules one repaint
+    if (controllerNumber == mControllerNumber && isVisible())
+        update();
+}
+
+/**
+ * @brief Decimate the visible window and rebuild the geometry of both lines
+ *
+ * This is called on the render thread while the GUI thread is blocked, so reading the series is safe.
+ */
+QSGNode *PressureChart::updatePaintNode(QSGNode *oldNode, QQuickItem::UpdatePaintNodeData *data)
+{
+    Q_UNUSED(data);
+
+    QSGNode* root = oldNode;
+    if (!root) {
+        root = new QSGNode();
+        // Setpoint first, so that the measured pressure is drawn on top
+        for (int i(0); i < 2; ++i) {
+            QSGGeometryNode* node = new QSGGeometryNode();
+
+            QSGGeometry* geometry = new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(), 0);
+            geometry->setDrawingMode(QSGGeometry::DrawLineStrip);
+            geometry->setLineWidth(1);
+            node->setGeometry(geometry);
+            node->setFlag(QSGNode::OwnsGeometry);
+
+            node->setMaterial(new QSGFlatColorMaterial());
+            node->setFlag(QSGNode::OwnsMaterial);
+
+            root->appendChildNode(node);
+        }
+    }
+
+    qint64 to = LogClock::currentWallTime();
+    qint64 from = to - qint64(mTimeWindow * 1000);
+
+    // Each bucket gives up to two points, so this keeps the number of vertices within the width in pixels
+    int bucketCount = qMax(1, int(width()) / 2);
+
+    if (mSeries)
+        mSeries->decimate(mControllerNumber, from, to, bucketCount, mMeasuredPoints, mSetpointPoints);
+    else {
+        mMeasuredPoints.clear();
+        mSetpointPoints.clear();
+    }
+
+    updateLine(root->childAtIndex(0), mSetpointPoints, from, to, mSetpointColor);
+    updateLine(root->childAtIndex(1), mMeasuredPoints, from, to, mMeasuredColor);
+
+    return root;
+}
+
+void PressureChart::updateLine(QSGNode *node, const QVector<PressureTimeSeries::Point> &points, qint64 from, qint64 to,
+                               const QColor &color)
+{
+    QSGGeometryNode* geometryNode = static_cast<QSGGeometryNode*>(node);
+    QSGGeometry* geometry = geometryNode->geometry();
+    geometry->allocate(points.size());
+
+    double w = width();
+    double h = height();
+    double range = mMaximum > mMinimum ? mMaximum - mMinimum : 1;
+    double duration = double(to - from);
+
+    QSGGeometry::Point2D* vertices = geometry->vertexDataAsPoint2D();
+    for (int i(0); i < points.size(); ++i) {
+        double x = w * (points[i].timestamp - from) / duration;
+        double y = h * (1 - (qBound(mMinimum, points[i].value, mMaximum) - mMinimum) / range);
+        vertices[i].set(float(x), float(y));
+    }
+    geometryNode->markDirty(QSGNode::DirtyGeometry);
+
+    QSGFlatColorMaterial* material = static_cast<QSGFlatColorMaterial*>(geometryNode->material());
+    if (material->color() != color) {
+        material->setColor(color);
+        geometryNode->markDirty(QSGNode::DirtyMaterial);
+    }
+}
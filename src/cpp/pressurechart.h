@@ -0,0 +1,94 @@
+#ifndef PRESSURECHART_H
+#define PRESSURECHART_H
+
+#include <QQuickItem>
+#include <QColor>
+
+#include "pressuretimeseries.h"
+
+/**
+ * @brief Live chart of the measured pressure and setpoint of a pressure controller
+ *
+ * The chart shows the last `timeWindow` seconds of the given controller's PressureTimeSeries, as two line strips
+ * drawn directly by the scene graph. The data is decimated to the width of the item (see
+ * PressureTimeSeries::decimate), so the number of vertices never exceeds the number of horizontal pixels, however
+ * many samples the window contains.
+ *
+ * The chart is redrawn when samples are added, at most once per frame.
+ *
+ * Example:
+ *
+ *     PressureChart {
+ *         series: Backend.pressureSeries
+ *         controllerNumber: 1
+ *         minimum: 0
+ *         maximum: 29.5
+ *         timeWindow: 600
+ *     }
+ */
+class PressureChart : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(PressureTimeSeries* series READ series WRITE setSeries NOTIFY seriesChanged)
+    Q_PROPERTY(int controllerNumber READ controllerNumber WRITE setControllerNumber NOTIFY controllerNumberChanged)
+    Q_PROPERTY(double timeWindow READ timeWindow WRITE setTimeWindow NOTIFY timeWindowChanged)
+    Q_PROPERTY(double minimum READ minimum WRITE setMinimum NOTIFY rangeChanged)
+    Q_PROPERTY(double maximum READ maximum WRITE setMaximum NOTIFY rangeChanged)
+    Q_PROPERTY(QColor measuredColor READ measuredColor WRITE setMeasuredColor NOTIFY colorsChanged)
+    Q_PROPERTY(QColor setpointColor READ setpointColor WRITE setSetpointColor NOTIFY colorsChanged)
+
+public:
+    PressureChart(QQuickItem* parent = nullptr);
+
+    PressureTimeSeries* series() const { return mSeries; }
+    void setSeries(PressureTimeSeries* series);
+
+    int controllerNumber() const { return mControllerNumber; }
+    void setControllerNumber(int controllerNumber);
+
+    /// Duration shown, in seconds
+    double timeWindow() const { return mTimeWindow; }
+    void setTimeWindow(double seconds);
+
+    /// Pressure range of the vertical axis, in PSI
+    double minimum() const { return mMinimum; }
+    void setMinimum(double minimum);
+    double maximum() const { return mMaximum; }
+    void setMaximum(double maximum);
+
+    QColor measuredColor() const { return mMeasuredColor; }
+    void setMeasuredColor(QColor const& color);
+    QColor setpointColor() const { return mSetpointColor; }
+    void setSetpointColor(QColor const& color);
+
+signals:
+    void seriesChanged();
+    void controllerNumberChanged();
+    void timeWindowChanged();
+    void rangeChanged();
+    void colorsChanged();
+
+protected:
+    QSGNode* updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData* data);
+
+private slots:
+    void onSamplesAdded(int controllerNumber);
+
+private:
+    void updateLine(QSGNode* node, QVector<PressureTimeSeries::Point> const& points, qint64 from, qint64 to,
+                    QColor const& color);
+
+    PressureTimeSeries* mSeries;
+    int mControllerNumber;
+    double mTimeWindow;
+    double mMinimum;
+    double mMaximum;
+    QColor mMeasuredColor;
+    QColor mSetpointColor;
+
+    /// Decimated points, reused between frames
+    QVector<PressureTimeSeries::Point> mMeasuredPoints;
+    QVector<PressureTimeSeries::Point> mSetpointPoints;
+};
+
+#endif // PRESSURECHART_H
@@ -0,0 +1,551 @@
+#include "pressurerecorder.h"
+#include "logclock.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+const char PressureRecorder::FILE_MAGIC[8] = {'U', 'F', 'C', 'S', 'P', 'R', 'S', '1'};
+
+namespace {
+
+// Offsets of the fields within a chunk header
+const int OFFSET_CHUNK_SIZE = 0;
+const int OFFSET_COUNT = 4;
+const int OFFSET_FIRST_TIMESTAMP = 8;
+const int OFFSET_LAST_TIMESTAMP = 16;
+const int OFFSET_RANGE_MIN = 24;
+const int OFFSET_RANGE_MAX = 32;
+const int OFFSET_MEASURED_SUM = 40;
+const int OFFSET_MEASURED_MIN = 48;
+const int OFFSET_MEASURED_MAX = 50;
+const int OFFSET_TIME_COLUMN_SIZE = 52;
+const int OFFSET_CONTROLLER = 56;
+
+const double QUANTISATION_SCALE = 65535.;
+
+void writeDouble(double value, uchar* p)
+{
+    quint64 v;
+    memcpy(&v, &value, sizeof(double));
+    qToLittleEndian<quint64>(v, p);
+}
+
+double readDouble(const uchar* p)
+{
+    quint64 v = qFromLittleEndian<quint64>(p);
+    double value;
+    memcpy(&value, &v, sizeof(double));
+    return value;
+}
+
+void appendVarint(QByteArray& data, quint64 value)
+{
+    while (value >= 0x80) {
+        data.append(char((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    data.append(char(value));
+}
+
+quint64 readVarint(const uchar*& p)
+{
+    quint64 value = 0;
+    int shift = 0;
+    while (true) {
+        uchar byte = *p++;
+        value |= quint64(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            break;
+        shift += 7;
+    }
+    return value;
+}
+
+}
+
+class PressureRecorder::WriteTask : public QRunnable
+{
+public:
+    WriteTask(QString const& path, QByteArray const& data)
+        : mPath(path)
+        , mData(data)
+    {}
+
+    void run()
+    {
+        QFile file(mPath);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qWarning() << "Could not write pressure history to" << mPath;
+            return;
+        }
+
+        if (file.size() == 0)
+            file.write(PressureRecorder::FILE_MAGIC, sizeof(PressureRecorder::FILE_MAGIC));
+        file.write(mData);
+    }
+
+private:
+    QString mPath;
+    QByteArray mData;
+};
+
+PressureRecorder::Chunk::Chunk()
+    : rangeMin(0)
+    , rangeMax(1)
+    , setpoint(0)
+{
+}
+
+/**
+ * @param directory The directory where the history is stored. A new file is created in it for this session, when
+ * the first chunk is written.
+ */
+PressureRecorder::PressureRecorder(const QString &directory)
+{
+    mPool.setMaxThreadCount(1);
+    QDir().mkpath(directory);
+
+    mFilePath = QDir(directory).absoluteFilePath(
+                "pressure_" + QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss") + ".dat");
+}
+
+PressureRecorder::~PressureRecorder()
+{
+    flush();
+    waitForDone();
+}
+
+/**
+ * @brief Return the directory where the application stores its pressure history
+ */
+QString PressureRecorder::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/pressure";
+}
+
+/**
+ * @brief Delete history files older than the given number of days
+ */
+void PressureRecorder::prune(const QString &directory, int retentionDays)
+{
+    if (retentionDays <= 0)
+        return;
+
+    QDateTime now = QDateTime::currentDateTime();
+    for (QFileInfo const& file : QDir(directory).entryInfoList(QStringList() << "pressure_*.dat", QDir::Files)) {
+        if (file.lastModified().daysTo(now) > retentionDays)
+            QFile::remove(file.absoluteFilePath());
+    }
+}
+
+/**
+ * @brief Set the range of a controller, in PSI. Values are recorded as a fraction of this range.
+ */
+void PressureRecorder::setRange(int controllerNumber, double minPressure, double maxPressure)
+{
+    if (controllerNumber < 1 || controllerNumber > N_PRS)
+        return;
+
+    Chunk& chunk = mChunks[controllerNumber - 1];
+    if (chunk.rangeMin == minPressure && chunk.rangeMax == maxPressure)
+        return;
+
+    // Each chunk has a single range
+    if (!chunk.timestamps.isEmpty())
+        writeChunk(controllerNumber);
+
+    chunk.rangeMin = minPressure;
+    chunk.rangeMax = maxPressure;
+}
+
+/**
+ * @brief Set the setpoint (between 0 and 1) recorded with the following samples of the given controller
+ */
+void PressureRecorder::setSetpoint(int controllerNumber, double setpoint)
+{
+    if (controllerNumber < 1 || controllerNumber > N_PRS)
+        return;
+
+    mChunks[controllerNumber - 1].setpoint = setpoint;
+}
+
+/**
+ * @brief Record a measured pressure (between 0 and 1), with the current time and setpoint
+ */
+void PressureRecorder::addSample(int controllerNumber, double measured)
+{
+    if (controllerNumber < 1 || controllerNumber > N_PRS)
+        return;
+
+    addSample(controllerNumber, LogClock::currentWallTime(), mChunks[controllerNumber - 1].setpoint, measured);
+}
+
+/**
+ * @brief Record a sample
+ * @param controllerNumber The controller number, starting at 1
+ * @param timestamp Time of the sample, in ms since the epoch. Timestamps must not decrease; earlier timestamps are
+ * recorded as the time of the previous sample.
+ * @param setpoint The setpoint, between 0 and 1
+ * @param measured The measured pressure, between 0 and 1
+ */
+void PressureRecorder::addSample(int controllerNumber, qint64 timestamp, double setpoint, double measured)
+{
+    if (controllerNumber < 1 || controllerNumber > N_PRS)
+        return;
+
+    Chunk& chunk = mChunks[controllerNumber - 1];
+
+    if (!chunk.timestamps.isEmpty())
+        timestamp = qMax(timestamp, chunk.timestamps.last());
+
+    chunk.timestamps.append(timestamp);
+    chunk.setpoints.append(quantise(setpoint));
+    chunk.measured.append(quantise(measured));
+
+    if (chunk.timestamps.size() >= CHUNK_CAPACITY || timestamp - chunk.timestamps.first() >= CHUNK_INTERVAL)
+        writeChunk(controllerNumber);
+}
+
+/**
+ * @brief Write all buffered samples (in the background)
+ */
+void PressureRecorder::flush()
+{
+    for (int i(1); i <= N_PRS; ++i) {
+        if (!mChunks[i - 1].timestamps.isEmpty())
+            writeChunk(i);
+    }
+}
+
+/**
+ * @brief Write the chunks whose first sample is at least CHUNK_INTERVAL old, even if no new samples arrived since
+ */
+void PressureRecorder::flushExpired()
+{
+    flushExpired(LogClock::currentWallTime());
+}
+
+/**
+ * @brief Write the chunks whose first sample is at least CHUNK_INTERVAL older than the given time (in ms since the
+ * epoch)
+ */
+void PressureRecorder::flushExpired(qint64 now)
+{
+    for (int i(1); i <= N_PRS; ++i) {
+        Chunk const& chunk = mChunks[i - 1];
+        if (!chunk.timestamps.isEmpty() && now - chunk.timestamps.first() >= CHUNK_INTERVAL)
+            writeChunk(i);
+    }
+}
+
+/**
+ * @brief Block until all chunks are written to disk
+ */
+void PressureRecorder::waitForDone()
+{
+    mPool.waitForDone();
+}
+
+void PressureRecorder::writeChunk(int controllerNumber)
+{
+    Chunk& chunk = mChunks[controllerNumber - 1];
+
+    mPool.start(new WriteTask(mFilePath, encode(controllerNumber, chunk)));
+
+    chunk.timestamps.clear();
+    chunk.setpoints.clear();
+    chunk.measured.clear();
+}
+
+/**
+ * @brief Return the binary representation of a chunk, as described in the class documentation
+ */
+QByteArray PressureRecorder::encode(int controllerNumber, const Chunk &chunk) const
+{
+    int count = chunk.timestamps.size();
+
+    QByteArray timeColumn;
+    timeColumn.reserve(count * 2);
+    qint64 previous = chunk.timestamps.first();
+    for (qint64 t : chunk.timestamps) {
+        appendVarint(timeColumn, quint64(t - previous));
+        previous = t;
+    }
+
+    quint64 sum = 0;
+    quint16 min = std::numeric_limits<quint16>::max();
+    quint16 max = 0;
+    for (quint16 m : chunk.measured) {
+        sum += m;
+        min = qMin(min, m);
+        max = qMax(max, m);
+    }
+
+    int chunkSize = HEADER_SIZE + timeColumn.size() + 4 * count;
+    QByteArray data(chunkSize, '\0');
+    uchar* p = reinterpret_cast<uchar*>(data.data());
+
+    qToLittleEndian<quint32>(quint32(chunkSize), p + OFFSET_CHUNK_SIZE);
+    qToLittleEndian<quint32>(quint32(count), p + OFFSET_COUNT);
+    qToLittleEndian<qint64>(chunk.timestamps.first(), p + OFFSET_FIRST_TIMESTAMP);
+    qToLittleEndian<qint64>(chunk.timestamps.last(), p + OFFSET_LAST_TIMESTAMP);
+    writeDouble(chunk.rangeMin, p + OFFSET_RANGE_MIN);
+    writeDouble(chunk.rangeMax, p + OFFSET_RANGE_MAX);
+    qToLittleEndian<quint64>(sum, p + OFFSET_MEASURED_SUM);
+    qToLittleEndian<quint16>(min, p + OFFSET_MEASURED_MIN);
+    qToLittleEndian<quint16>(max, p + OFFSET_MEASURED_MAX);
+    qToLittleEndian<quint32>(quint32(timeColumn.size()), p + OFFSET_TIME_COLUMN_SIZE);
+    p[OFFSET_CONTROLLER] = uchar(controllerNumber);
+
+    uchar* column = p + HEADER_SIZE;
+    memcpy(column, timeColumn.constData(), size_t(timeColumn.size()));
+
+    column += timeColumn.size();
+    for (int i(0); i < count; ++i)
+        qToLittleEndian<quint16>(chunk.setpoints[i], column + 2*i);
+
+    column += 2 * count;
+    for (int i(0); i < count; ++i)
+        qToLittleEndian<quint16>(chunk.measured[i], column + 2*i);
+
+    return data;
+}
+
+quint16 PressureRecorder::quantise(double value)
+{
+    return quint16(qRound(qBound(0., value, 1.) * QUANTISATION_SCALE));
+}
+
+PressureHistoryReader::PressureHistoryReader()
+{
+}
+
+PressureHistoryReader::~PressureHistoryReader()
+{
+    close();
+}
+
+/**
+ * @brief Open and memory-map a history file, or all the history files in a directory
+ * @return False if no valid history file could be opened
+ *
+ * A chunk that was only partially written (e.g. if the application crashed) is ignored, along with any data after it.
+ */
+bool PressureHistoryReader::open(const QString &path)
+{
+    close();
+
+    QFileInfo info(path);
+    bool ok = false;
+
+    if (info.isDir()) {
+        QDir dir(path);
+        for (QString const& name : dir.entryList(QStringList() << "pressure_*.dat", QDir::Files, QDir::Name))
+            ok |= mapFile(dir.absoluteFilePath(name));
+    }
+    else
+        ok = mapFile(path);
+
+    std::stable_sort(mChunks.begin(), mChunks.end(), [](ChunkInfo const& a, ChunkInfo const& b) {
+        if (a.controllerNumber != b.controllerNumber)
+            return a.controllerNumber < b.controllerNumber;
+        return a.firstTimestamp < b.firstTimestamp;
+    });
+
+    return ok;
+}
+
+void PressureHistoryReader::close()
+{
+    mChunks.clear();
+    mFiles.clear();
+}
+
+/**
+ * @brief Call f(timestamp, setpoint, measured) for each sample of a chunk, with the raw (quantised) values
+ */
+template <typename F>
+void PressureHistoryReader::decode(const ChunkInfo &chunk, F f) const
+{
+    const uchar* time = chunk.data + PressureRecorder::HEADER_SIZE;
+    const uchar* setpoints = time + chunk.timeColumnSize;
+    const uchar* measured = setpoints + 2 * chunk.count;
+
+    qint64 timestamp = chunk.firstTimestamp;
+    for (quint32 i(0); i < chunk.count; ++i) {
+        timestamp += qint64(readVarint(time));
+        f(timestamp, qFromLittleEndian<quint16>(setpoints + 2*i), qFromLittleEndian<quint16>(measured + 2*i));
+    }
+}
+
+/**
+ * @brief Return the time of the first sample of the given controller, or -1 if there is none
+ */
+qint64 PressureHistoryReader::firstTimestamp(int controllerNumber) const
+{
+    qint64 result = -1;
+    for (ChunkInfo const& chunk : mChunks) {
+        if (chunk.controllerNumber == controllerNumber && (result < 0 || chunk.firstTimestamp < result))
+            result = chunk.firstTimestamp;
+    }
+    return result;
+}
+
+/**
+ * @brief Return the time of the last sample of the given controller, or -1 if there is none
+ */
+qint64 PressureHistoryReader::lastTimestamp(int controllerNumber) const
+{
+    qint64 result = -1;
+    for (ChunkInfo const& chunk : mChunks) {
+        if (chunk.controllerNumber == controllerNumber)
+            result = qMax(result, chunk.lastTimestamp);
+    }
+    return result;
+}
+
+/**
+ * @brief Return all the samples of a controller in the given time range (inclusive), in ms since the epoch
+ */
+QVector<PressureSample> PressureHistoryReader::samples(int controllerNumber, qint64 from, qint64 to) const
+{
+    QVector<PressureSample> result;
+
+    for (ChunkInfo const& chunk : mChunks) {
+        if (chunk.controllerNumber != controllerNumber || chunk.lastTimestamp < from || chunk.firstTimestamp > to)
+            continue;
+
+        double scale = (chunk.rangeMax - chunk.rangeMin) / QUANTISATION_SCALE;
+
+        decode(chunk, [&](qint64 timestamp, quint16 setpoint, quint16 measured) {
+            if (timestamp >= from && timestamp <= to)
+                result.append({timestamp, chunk.rangeMin + setpoint * scale, chunk.rangeMin + measured * scale});
+        });
+    }
+
+    return result;
+}
+
+/**
+ * @brief Summarize the measured pressure of a controller over a time range, e.g. to plot it
+ * @param controllerNumber The controller number
+ * @param from Start of the time range, in ms since the epoch
+ * @param to End of the time range (exclusive)
+ * @param bucketCount The range is split into this many buckets of equal duration
+ * @return The minimum, maximum and mean pressure for each bucket. Buckets with no samples have a count of 0.
+ */
+QVector<PressureBucket> PressureHistoryReader::downsample(int controllerNumber, qint64 from, qint64 to,
+                                                          int bucketCount) const
+{
+    QVector<PressureBucket> buckets;
+    if (bucketCount <= 0 || to <= from)
+        return buckets;
+
+    qint64 duration = to - from;
+
+    buckets.resize(bucketCount);
+    for (int i(0); i < bucketCount; ++i) {
+        PressureBucket& b = buckets[i];
+        b.start = from + duration * i / bucketCount;
+        b.end = from + duration * (i + 1) / bucketCount;
+        b.count = 0;
+        b.min = std::numeric_limits<double>::max();
+        b.max = std::numeric_limits<double>::lowest();
+        b.mean = 0; // sum, until the end
+    }
+
+    auto bucketIndex = [&](qint64 timestamp) {
+        return int((timestamp - from) * bucketCount / duration);
+    };
+
+    for (ChunkInfo const& chunk : mChunks) {
+        if (chunk.controllerNumber != controllerNumber || chunk.lastTimestamp < from || chunk.firstTimestamp >= to)
+            continue;
+
+        double scale = (chunk.rangeMax - chunk.rangeMin) / QUANTISATION_SCALE;
+
+        // Chunks that fall entirely within one bucket are summarized using their header only
+        if (chunk.firstTimestamp >= from && chunk.lastTimestamp < to
+                && bucketIndex(chunk.firstTimestamp) == bucketIndex(chunk.lastTimestamp)) {
+            PressureBucket& b = buckets[bucketIndex(chunk.firstTimestamp)];
+            b.count += int(chunk.count);
+            b.min = qMin(b.min, chunk.rangeMin + chunk.measuredMin * scale);
+            b.max = qMax(b.max, chunk.rangeMin + chunk.measuredMax * scale);
+            b.mean += chunk.count * chunk.rangeMin + chunk.measuredSum * scale;
+            continue;
+        }
+
+        decode(chunk, [&](qint64 timestamp, quint16, quint16 measured) {
+            if (timestamp < from || timestamp >= to)
+                return;
+
+            double value = chunk.rangeMin + measured * scale;
+            PressureBucket& b = buckets[bucketIndex(timestamp)];
+            b.count++;
+            b.min = qMin(b.min, value);
+            b.max = qMax(b.max, value);
+            b.mean += value;
+        });
+    }
+
+    for (PressureBucket& b : buckets) {
+        if (b.count > 0)
+            b.mean /= b.count;
+        else
+            b.min = b.max = b.mean = 0;
+    }
+
+    return buckets;
+}
+
+bool PressureHistoryReader::mapFile(const QString &path)
+{
+    std::unique_ptr<QFile> file(new QFile(path));
+    if (!file->open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open pressure history file" << path;
+        return false;
+    }
+
+    qint64 size = file->size();
+    const uchar* data = nullptr;
+    if (size >= qint64(sizeof(PressureRecorder::FILE_MAGIC)))
+        data = file->map(0, size);
+
+    if (!data || memcmp(data, PressureRecorder::FILE_MAGIC, sizeof(PressureRecorder::FILE_MAGIC)) != 0) {
+        qWarning() << path << "is not a pressure history file";
+        return false;
+    }
+
+    qint64 offset = sizeof(PressureRecorder::FILE_MAGIC);
+    while (offset + PressureRecorder::HEADER_SIZE <= size) {
+        const uchar* p = data + offset;
+
+        ChunkInfo chunk;
+        chunk.data = p;
+        quint32 chunkSize = qFromLittleEndian<quint32>(p + OFFSET_CHUNK_SIZE);
+        chunk.count = qFromLittleEndian<quint32>(p + OFFSET_COUNT);
+        chunk.firstTimestamp = qFromLittleEndian<qint64>(p + OFFSET_FIRST_TIMESTAMP);
+        chunk.lastTimestamp = qFromLittleEndian<qint64>(p + OFFSET_LAST_TIMESTAMP);
+        chunk.rangeMin = readDouble(p + OFFSET_RANGE_MIN);
+        chunk.rangeMax = readDouble(p + OFFSET_RANGE_MAX);
+        chunk.measuredSum = qFromLittleEndian<quint64>(p + OFFSET_MEASURED_SUM);
+        chunk.measuredMin = qFromLittleEndian<quint16>(p + OFFSET_MEASURED_MIN);
+        chunk.measuredMax = qFromLittleEndian<quint16>(p + OFFSET_MEASURED_MAX);
+        chunk.timeColumnSize = qFromLittleEndian<quint32>(p + OFFSET_TIME_COLUMN_SIZE);
+        chunk.controllerNumber = p[OFFSET_CONTROLLER];
+
+        bool valid = offset + chunkSize <= size
+                && quint64(chunkSize) == PressureRecorder::HEADER_SIZE + quint64(chunk.timeColumnSize) + 4 * quint64(chunk.count);
+        if (!valid) {
+            qWarning() << "Pressure history file" << path << "is truncated or corrupt; ignoring the rest of it";
+            break;
+        }
+
+        mChunks.append(chunk);
+        offset += chunkSize;
+    }
+
+    mFiles.push_back(std::move(file));
+    return true;
+}
@@ -0,0 +1,178 @@
+#ifndef PRESSURERECORDER_H
+#define PRESSURERECORDER_H
+
+#include <memory>
+#include <vector>
+
+#include <QtCore>
+
+#include "constants.h"
+
+/**
+ * @brief A pressure sample: time, setpoint and measured value of a pressure controller
+ */
+struct PressureSample
+{
+    /// Milliseconds since the epoch (UTC)
+    qint64 timestamp;
+    /// In PSI
+    double setpoint;
+    double measured;
+};
+
+/**
+ * @brief Summary of the measured pressure over a time interval, used to plot long recordings
+ */
+struct PressureBucket
+{
+    /// Time range covered by the bucket, in milliseconds since the epoch. end is exclusive.
+    qint64 start;
+    qint64 end;
+
+    /// Number of samples in the bucket. The other fields are meaningless if this is 0.
+    int count;
+
+    /// Measured pressure, in PSI
+    double min;
+    double max;
+    double mean;
+};
+
+/**
+ * @brief Records the pressure history of all pressure controllers
+ *
+ * Samples are buffered per controller, and written in chunks (see below) to one file per session, in the
+ * "pressure" folder of the application data directory. Chunks are encoded on the calling thread, and appended to
+ * the file on a background thread. A chunk is written when it is full, or CHUNK_INTERVAL after its first sample, so
+ * that at most that much history is lost if the application crashes. As samples may stop arriving (e.g. if the device
+ * is disconnected), flushExpired() should also be called periodically. Call flush() and waitForDone() before exiting.
+ *
+ * Files start with FILE_MAGIC, followed by chunks. Each chunk contains the samples of a single controller, stored by
+ * column, and starts with a fixed-size header with summary statistics (see PressureHistoryReader):
+ *
+ *     quint32 chunkSize, quint32 count, qint64 firstTimestamp, qint64 lastTimestamp,
+ *     double rangeMin, double rangeMax, quint64 measuredSum, quint16 measuredMin, quint16 measuredMax,
+ *     quint32 timeColumnSize, quint8 controllerNumber, 7 bytes of padding
+ *
+ * followed by the columns:
+ *  - timestamps: the difference from the previous timestamp (or from firstTimestamp, for the first sample), in ms,
+ *    as a variable-length integer (LEB128)
+ *  - setpoints: quint16 each
+ *  - measured values: quint16 each
+ *
+ * Values are stored as a fraction of the controller's range (rangeMin to rangeMax, in PSI), quantised to 16 bits.
+ * All integers are little-endian.
+ */
+class PressureRecorder
+{
+public:
+    PressureRecorder(QString const& directory = defaultDirectory());
+    ~PressureRecorder();
+
+    void setRange(int controllerNumber, double minPressure, double maxPressure);
+    void setSetpoint(int controllerNumber, double setpoint);
+    void addSample(int controllerNumber, double measured);
+    void addSample(int controllerNumber, qint64 timestamp, double setpoint, double measured);
+
+    void flush();
+    void flushExpired();
+    void flushExpired(qint64 now);
+    void waitForDone();
+
+    QString filePath() const { return mFilePath; }
+
+    static QString defaultDirectory();
+    static void prune(QString const& directory, int retentionDays);
+
+    static const char FILE_MAGIC[8];
+    static const int HEADER_SIZE = 64;
+
+    /// Maximum number of samples per chunk
+    static const int CHUNK_CAPACITY = 4096;
+
+    /// Maximum time between the first sample of a chunk and the chunk being written, in ms
+    static const qint64 CHUNK_INTERVAL = 60000;
+
+private:
+    class WriteTask;
+
+    struct Chunk
+    {
+        Chunk();
+
+        double rangeMin;
+        double rangeMax;
+        double setpoint;
+        QVector<qint64> timestamps;
+        QVector<quint16> setpoints;
+        QVector<quint16> measured;
+    };
+
+    void writeChunk(int controllerNumber);
+    QByteArray encode(int controllerNumber, Chunk const& chunk) const;
+    static quint16 quantise(double value);
+
+    QString mFilePath;
+    Chunk mChunks[N_PRS];
+
+    /// Single-threaded pool, so that chunks are appended in order
+    QThreadPool mPool;
+};
+
+/**
+ * @brief Reads the pressure history written by PressureRecorder
+ *
+ * Files are memory-mapped, and only chunk headers are read when the files are opened. Queries only decode the chunks
+ * that overlap the requested time range; downsample() uses the statistics in the chunk headers for chunks that fall
+ * within a single bucket, so plotting days of history only touches a small part of the data.
+ *
+ * For example, to plot the last 24 hours of controller 1 with 1000 points:
+ *
+ *     PressureHistoryReader reader;
+ *     reader.open(PressureRecorder::defaultDirectory());
+ *     qint64 now = QDateTime::currentMSecsSinceEpoch();
+ *     QVector<PressureBucket> buckets = reader.downsample(1, now - 24*3600*1000, now, 1000);
+ */
+class PressureHistoryReader
+{
+public:
+    PressureHistoryReader();
+    ~PressureHistoryReader();
+
+    bool open(QString const& path);
+    void close();
+
+    qint64 firstTimestamp(int controllerNumber) const;
+    qint64 lastTimestamp(int controllerNumber) const;
+
+    QVector<PressureSample> samples(int controllerNumber, qint64 from, qint64 to) const;
+    QVector<PressureBucket> downsample(int controllerNumber, qint64 from, qint64 to, int bucketCount) const;
+
+private:
+    struct ChunkInfo
+    {
+        const uchar* data;
+        int controllerNumber;
+        quint32 count;
+        qint64 firstTimestamp;
+        qint64 lastTimestamp;
+        double rangeMin;
+        double rangeMax;
+        quint64 measuredSum;
+        quint16 measuredMin;
+        quint16 measuredMax;
+        quint32 timeColumnSize;
+    };
+
+    bool mapFile(QString const& path);
+
+    template <typename F>
+    void decode(ChunkInfo const& chunk, F f) const;
+
+    std::vector<std::unique_ptr<QFile>> mFiles;
+
+    /// Chunks of all files, in chronological order (per controller)
+    QVector<ChunkInfo> mChunks;
+};
+
+#endif // PRESSURERECORDER_H
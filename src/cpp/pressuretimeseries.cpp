@@ -0,0 +1,245 @@
+#include "pressuretimeseries.h"
+#include "logclock.h"
+
+#include <limits>
+
+PressureTimeSeries::Extrema::Extrema()
+    : min(std::numeric_limits<float>::max())
+    , max(std::numeric_limits<float>::lowest())
+    , minSequence(0)
+    , maxSequence(0)
+    , count(0)
+{
+}
+
+void PressureTimeSeries::Extrema::add(float value, quint64 sequenceNumber)
+{
+    if (count == 0 || value < min) {
+        min = value;
+        minSequence = sequenceNumber;
+    }
+    if (count == 0 || value > max) {
+        max = value;
+        maxSequence = sequenceNumber;
+    }
+    count++;
+}
+
+void PressureTimeSeries::Extrema::add(const Extrema &other)
+{
+    if (other.count == 0)
+        return;
+
+    if (count == 0 || other.min < min) {
+        min = other.min;
+        minSequence = other.minSequence;
+    }
+    if (count == 0 || other.max > max) {
+        max = other.max;
+        maxSequence = other.maxSequence;
+    }
+    count += other.count;
+}
+
+/**
+ * @param capacity Maximum number of samples kept per controller
+ */
+PressureTimeSeries::PressureTimeSeries(int capacity, QObject *parent)
+    : QObject(parent)
+{
+    mBlockCount = qMax(1, (capacity + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    mCapacity = mBlockCount * BLOCK_SIZE;
+
+    for (Series& series : mSeries) {
+        series.first = 0;
+        series.next = 0;
+        series.setpoint = 0;
+    }
+}
+
+int PressureTimeSeries::size(int controllerNumber) const
+{
+    if (controllerNumber < 1 || controllerNumber > N_PRS)
+        return 0;
+
+    Series const& series = mSeries[controllerNumber - 1];
+    return int(series.next - series.first);
+}
+
+/**
+ * @brief Return the time of the most recent sample of the given controller, or -1 if there is none
+ */
+qint64 PressureTimeSeries::lastTimestamp(int controllerNumber) const
+{
+    if (size(controllerNumber) == 0)
+        return -1;
+
+    Series const& series = mSeries[controllerNumber - 1];
+    return series.timestamps[index(series.next - 1)];
+}
+
+/**
+ * @brief Set the setpoint (in PSI) recorded with the following samples of the given controller
+ */
+void PressureTimeSeries::setSetpoint(int controllerNumber, double setpoint)
+{
+    if (controllerNumber < 1 || controllerNumber > N_PRS)
+        return;
+
+    mSeries[controllerNumber - 1].setpoint = setpoint;
+}
+
+/**
+ * @brief Add a measured pressure (in PSI), with the current time and setpoint
+ */
+void PressureTimeSeries::append(int controllerNumber, double measured)
+{
+    if (controllerNumber < 1 || controllerNumber > N_PRS)
+        return;
+
+    append(controllerNumber, LogClock::currentWallTime(), mSeries[controllerNumber - 1].setpoint, measured);
+}
+
+/**
+ * @brief Add a sample. Timestamps must not decrease; earlier timestamps are stored as the time of the previous sample.
+ */
+void PressureTimeSeries::append(int controllerNumber, qint64 timestamp, double setpoint, double measured)
+{
+    if (controllerNumber < 1 || controllerNumber > N_PRS)
+        return;
+
+    Series& series = mSeries[controllerNumber - 1];
+
+    if (series.timestamps.isEmpty()) {
+        series.timestamps.resize(mCapacity);
+        for (int c(0); c < N_COLUMNS; ++c) {
+            series.values[c].resize(mCapacity);
+            series.blocks[c].resize(mBlockCount);
+        }
+    }
+
+    quint64 sequenceNumber = series.next;
+
+    if (sequenceNumber > series.first)
+        timestamp = qMax(timestamp, series.timestamps[index(sequenceNumber - 1)]);
+
+    if (sequenceNumber - series.first == quint64(mCapacity))
+        series.first++;
+
+    int i = index(sequenceNumber);
+    int b = blockIndex(sequenceNumber);
+    float values[N_COLUMNS];
+    values[Measured] = float(measured);
+    values[Setpoint] = float(setpoint);
+
+    series.timestamps[i] = timestamp;
+    for (int c(0); c < N_COLUMNS; ++c) {
+        series.values[c][i] = values[c];
+
+        // Starting a new block: its slot held a block that has now left the buffer
+        if (sequenceNumber % BLOCK_SIZE == 0)
+            series.blocks[c][b] = Extrema();
+        series.blocks[c][b].add(values[c], sequenceNumber);
+    }
+
+    series.next++;
+
+    emit samplesAdded(controllerNumber);
+}
+
+void PressureTimeSeries::clear()
+{
+    for (Series& series : mSeries)
+        series.first = series.next;
+}
+
+/**
+ * @brief Reduce the samples of a controller within a time window to at most 2*bucketCount points
+ * @param controllerNumber The controller number
+ * @param from Start of the window, in ms since the epoch
+ * @param to End of the window (exclusive)
+ * @param bucketCount Number of buckets of equal duration the window is split into, e.g. half the chart's width
+ * in pixels
+ * @param measured Filled with the minimum and maximum measured pressure of each bucket, in chronological order
+ * @param setpoint Filled with the minimum and maximum setpoint of each bucket, in chronological order
+ */
+void PressureTimeSeries::decimate(int controllerNumber, qint64 from, qint64 to, int bucketCount,
+                                  QVector<Point> &measured, QVector<Point> &setpoint) const
+{
+    measured.clear();
+    setpoint.clear();
+
+    if (size(controllerNumber) == 0 || to <= from || bucketCount <= 0)
+        return;
+
+    Series const& series = mSeries[controllerNumber - 1];
+    QVector<Point>* outputs[N_COLUMNS] = {&measured, &setpoint};
+
+    for (int c(0); c < N_COLUMNS; ++c)
+        outputs[c]->reserve(2 * bucketCount);
+
+    qint64 duration = to - from;
+    quint64 begin = lowerBound(series, from);
+
+    for (int bucket(0); bucket < bucketCount && begin < series.next; ++bucket) {
+        quint64 end = lowerBound(series, from + duration * (bucket + 1) / bucketCount);
+        if (end == begin)
+            continue;
+
+        for (int c(0); c < N_COLUMNS; ++c) {
+            Extrema e = extrema(series, Column(c), begin, end);
+            QVector<Point>& output = *outputs[c];
+
+            quint64 firstSequence = qMin(e.minSequence, e.maxSequence);
+            quint64 secondSequence = qMax(e.minSequence, e.maxSequence);
+
+            output.append({series.timestamps[index(firstSequence)], series.values[c][index(firstSequence)]});
+            if (secondSequence != firstSequence)
+                output.append({series.timestamps[index(secondSequence)], series.values[c][index(secondSequence)]});
+        }
+
+        begin = end;
+    }
+}
+
+/**
+ * @brief Return the sequence number of the first sample at or after the given time
+ */
+quint64 PressureTimeSeries::lowerBound(const Series &series, qint64 timestamp) const
+{
+    quint64 low = series.first;
+    quint64 high = series.next;
+
+    while (low < high) {
+        quint64 middle = low + (high - low) / 2;
+        if (series.timestamps[index(middle)] < timestamp)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+/**
+ * @brief Return the extrema of a column over samples [begin, end), using the block summaries where possible
+ */
+PressureTimeSeries::Extrema PressureTimeSeries::extrema(const Series &series, Column column,
+                                                        quint64 begin, quint64 end) const
+{
+    Extrema e;
+    quint64 s = begin;
+
+    while (s < end) {
+        if (s % BLOCK_SIZE == 0 && s + BLOCK_SIZE <= end) {
+            e.add(series.blocks[column][blockIndex(s)]);
+            s += BLOCK_SIZE;
+        }
+        else {
+            e.add(series.values[column][index(s)], s);
+            s++;
+        }
+    }
+
+    return e;
+}
@@ -0,0 +1,105 @@
+#ifndef PRESSURETIMESERIES_H
+#define PRESSURETIMESERIES_H
+
+#include <QObject>
+#include <QtCore>
+
+#include "constants.h"
+
+/**
+ * @brief Recent pressure history of each controller, kept in memory for live charts (see PressureChart)
+ *
+ * The measured pressure and setpoint (in PSI) of each controller are stored in a ring buffer of fixed capacity, so
+ * that appending a sample takes constant time, and the oldest samples are discarded once the buffer is full. The
+ * default capacity holds two hours of samples at 100 Hz; buffers are only allocated for controllers that send data.
+ *
+ * decimate() reduces any time window to a given number of points with min/max decimation: the window is split into
+ * buckets of equal duration, and the minimum and maximum of each bucket are kept, so that short spikes remain visible
+ * however far the chart is zoomed out. To keep this fast for windows containing millions of samples, the minimum
+ * and maximum of every block of BLOCK_SIZE samples are maintained as samples are added, and buckets spanning whole
+ * blocks only read these summaries.
+ *
+ * Full-resolution history is stored on disk by PressureRecorder.
+ */
+class PressureTimeSeries : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Point
+    {
+        /// Milliseconds since the epoch
+        qint64 timestamp;
+        /// In PSI
+        double value;
+    };
+
+    PressureTimeSeries(int capacity = DEFAULT_CAPACITY, QObject* parent = nullptr);
+
+    int capacity() const { return mCapacity; }
+    int size(int controllerNumber) const;
+    qint64 lastTimestamp(int controllerNumber) const;
+
+    void setSetpoint(int controllerNumber, double setpoint);
+    void append(int controllerNumber, double measured);
+    void append(int controllerNumber, qint64 timestamp, double setpoint, double measured);
+    void clear();
+
+    void decimate(int controllerNumber, qint64 from, qint64 to, int bucketCount,
+                  QVector<Point>& measured, QVector<Point>& setpoint) const;
+
+    /// Number of samples per block summary. The capacity is rounded up to a multiple of this.
+    static const int BLOCK_SIZE = 256;
+
+    /// 2 hours at 100 Hz
+    static const int DEFAULT_CAPACITY = 2*3600*100;
+
+signals:
+    void samplesAdded(int controllerNumber);
+
+private:
+    enum Column {
+        Measured,
+        Setpoint,
+        N_COLUMNS
+    };
+
+    /// Minimum and maximum of a column over a range of samples, with the sequence numbers where they occur
+    struct Extrema
+    {
+        Extrema();
+        void add(float value, quint64 sequenceNumber);
+        void add(Extrema const& other);
+
+        float min;
+        float max;
+        quint64 minSequence;
+        quint64 maxSequence;
+        int count;
+    };
+
+    struct Series
+    {
+        QVector<qint64> timestamps;
+        QVector<float> values[N_COLUMNS];
+        QVector<Extrema> blocks[N_COLUMNS];
+
+        /// Sequence numbers of the oldest sample, and of the next sample to be added. The sample with sequence
+        /// number n is stored at index n % capacity, and belongs to block n / BLOCK_SIZE.
+        quint64 first;
+        quint64 next;
+
+        double setpoint;
+    };
+
+    quint64 lowerBound(Series const& series, qint64 timestamp) const;
+    Extrema extrema(Series const& series, Column column, quint64 begin, quint64 end) const;
+    int index(quint64 sequenceNumber) const { return int(sequenceNumber % quint64(mCapacity)); }
+    int blockIndex(quint64 sequenceNumber) const { return int(sequenceNumber / BLOCK_SIZE % quint64(mBlockCount)); }
+
+    int mCapacity;
+    int mBlockCount;
+    Series mSeries[N_PRS];
+};
+
+#endif // PRESSURETIMESERIES_H
@@ -0,0 +1,167 @@
+#include "routinecheckpoint.h"
+
+namespace {
+const quint32 CHECKPOINT_MAGIC = 0x55464350; // "UFCP"
+const quint8 CHECKPOINT_VERSION = 1;
+}
+
+RoutineCheckpoint::RoutineCheckpoint()
+    : step(-1)
+    , numberOfSteps(0)
+    , waitRemaining(0)
+    , openValves(0)
+    , closedValves(0)
+{
+}
+
+QByteArray RoutineCheckpoint::serialize() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_12);
+
+    stream << CHECKPOINT_MAGIC << CHECKPOINT_VERSION
+           << fileUrl << routineName << routineHash
+           << qint32(step) << qint32(numberOfSteps) << waitRemaining
+           << openValves << closedValves
+           << pressures << time;
+
+    return data;
+}
+
+/**
+ * @brief Read a checkpoint written by serialize()
+ * @return The checkpoint, or an invalid checkpoint if the data could not be read
+ */
+RoutineCheckpoint RoutineCheckpoint::deserialize(const QByteArray &data)
+{
+    RoutineCheckpoint checkpoint;
+
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_12);
+
+    quint32 magic;
+    quint8 version;
+    stream >> magic >> version;
+
+    if (magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION)
+        return RoutineCheckpoint();
+
+    qint32 step, numberOfSteps;
+    stream >> checkpoint.fileUrl >> checkpoint.routineName >> checkpoint.routineHash
+           >> step >> numberOfSteps >> checkpoint.waitRemaining
+           >> checkpoint.openValves >> checkpoint.closedValves
+           >> checkpoint.pressures >> checkpoint.time;
+
+    if (stream.status() != QDataStream::Ok)
+        return RoutineCheckpoint();
+
+    checkpoint.step = step;
+    checkpoint.numberOfSteps = numberOfSteps;
+    return checkpoint;
+}
+
+class CheckpointWriter::WriteTask : public QRunnable
+{
+public:
+    WriteTask(CheckpointWriter* writer) : mWriter(writer) {}
+    void run() { mWriter->writePending(); }
+
+private:
+    CheckpointWriter* mWriter;
+};
+
+CheckpointWriter::CheckpointWriter(const QString &path)
+    : mPath(path)
+    , mHasPending(false)
+    , mWriteScheduled(false)
+{
+    mPool.setMaxThreadCount(1);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    waitForDone();
+}
+
+/**
+ * @brief Return the location of the checkpoint file used by the application
+ */
+QString CheckpointWriter::defaultPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/routine_checkpoint.dat";
+}
+
+/**
+ * @brief Schedule a (serialized) checkpoint to be written. Returns immediately.
+ *
+ * Posting an empty QByteArray deletes the checkpoint file.
+ */
+void CheckpointWriter::post(const QByteArray &checkpoint)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mPending = checkpoint;
+    mHasPending = true;
+
+    if (!mWriteScheduled) {
+        mWriteScheduled = true;
+        mPool.start(new WriteTask(this));
+    }
+}
+
+/**
+ * @brief Delete the checkpoint file (in the background), e.g. when a routine finished normally
+ */
+void CheckpointWriter::clear()
+{
+    post(QByteArray());
+}
+
+/**
+ * @brief Block until all posted checkpoints are written
+ */
+void CheckpointWriter::waitForDone()
+{
+    mPool.waitForDone();
+}
+
+/**
+ * @brief Read the checkpoint file. This is done synchronously.
+ * @return The contents of the file, or an empty QByteArray if there is no checkpoint
+ */
+QByteArray CheckpointWriter::read() const
+{
+    QFile file(mPath);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+
+void CheckpointWriter::writePending()
+{
+    while (true) {
+        QByteArray data;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mHasPending) {
+                mWriteScheduled = false;
+                return;
+            }
+            data = mPending;
+            mHasPending = false;
+        }
+
+        if (data.isEmpty()) {
+            QFile::remove(mPath);
+            continue;
+        }
+
+        // QSaveFile writes to a temporary file, then renames it, so that a crash while writing
+        // can't leave a corrupted checkpoint behind.
+        QSaveFile file(mPath);
+        if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit())
+            qWarning() << "Could not write routine checkpoint to" << mPath << ":" << file.errorString();
+    }
+}
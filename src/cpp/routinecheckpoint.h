@@ -0,0 +1,84 @@
+#ifndef ROUTINECHECKPOINT_H
+#define ROUTINECHECKPOINT_H
+
+#include <mutex>
+
+#include <QtCore>
+
+/**
+ * @brief Snapshot of the execution of a routine, used to resume it after a crash or restart.
+ *
+ * A checkpoint identifies the routine (file and hash of its contents), the step at which execution should resume,
+ * and the device state that was commanded by the routine up to that point.
+ *
+ * If `waitRemaining` is non-zero, `step` is a wait command that was interrupted, and that should only wait for the
+ * remaining time when resumed. If it is 0, the step is run in full, even if it is a wait command.
+ */
+struct RoutineCheckpoint
+{
+    RoutineCheckpoint();
+
+    QString fileUrl;
+    QString routineName;
+    QByteArray routineHash;
+
+    /// Index of the step at which to resume
+    int step;
+    int numberOfSteps;
+
+    /// Time remaining in the current wait step, in milliseconds
+    qint64 waitRemaining;
+
+    /// Valves opened and closed by the routine (bit 0 corresponds to valve 1)
+    quint32 openValves;
+    quint32 closedValves;
+
+    /// Pressure setpoints given by the routine (normalized, i.e. 0-1), with the controller number as key
+    QMap<uint, double> pressures;
+
+    /// When the checkpoint was written (UTC)
+    QDateTime time;
+
+    bool isValid() const { return step >= 0 && !routineHash.isEmpty(); }
+
+    QByteArray serialize() const;
+    static RoutineCheckpoint deserialize(QByteArray const& data);
+};
+
+/**
+ * @brief Writes routine checkpoints to disk in the background
+ *
+ * post() only stores the checkpoint and schedules a write on a background thread, so it can be called at
+ * every step without slowing the routine down. If checkpoints are posted faster than they can be written,
+ * only the latest one is written.
+ */
+class CheckpointWriter
+{
+public:
+    CheckpointWriter(QString const& path = defaultPath());
+    ~CheckpointWriter();
+
+    void post(QByteArray const& checkpoint);
+    void clear();
+    void waitForDone();
+
+    QByteArray read() const;
+
+    static QString defaultPath();
+
+private:
+    class WriteTask;
+    void writePending();
+
+    QString mPath;
+
+    std::mutex mMutex;
+    QByteArray mPending;
+    bool mHasPending;
+    bool mWriteScheduled;
+
+    /// Single-threaded pool, so that writes never happen concurrently
+    QThreadPool mPool;
+};
+
+#endif // ROUTINECHECKPOINT_H
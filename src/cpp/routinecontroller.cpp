@@ -1,5 +1,78 @@
 #include "routinecontroller.h"
 #include "applicationcontroller.h"
+#include "routinestepsmodel.h"
+
+#include <algorithm>
+#include <cstring>
+
+const qint64 RoutineController::CHECKPOINT_INTERVAL;
+
+namespace {
+
+/// A word of a routine line. The data is not copied, it points into the routine file.
+struct Token
+{
+    const char* data;
+    int size;
+
+    QByteArray bytes() const { return QByteArray::fromRawData(data, size); }
+    QString toString() const { return QString::fromUtf8(data, size); }
+};
+
+bool operator==(Token const& token, const char* s)
+{
+    return std::strlen(s) == size_t(token.size) && std::memcmp(token.data, s, size_t(token.size)) == 0;
+}
+
+bool operator!=(Token const& token, const char* s)
+{
+    return !(token == s);
+}
+
+/// No valid command has more tokens than this
+const int MAX_TOKENS = 9;
+
+/// Operators of `wait until` commands, in the order of RoutineController::Comparison
+const int NUM_COMPARISONS = 4;
+const char* const COMPARISON_OPERATORS[NUM_COMPARISONS] = {"<", "<=", ">", ">="};
+
+bool isSpace(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/**
+ * @brief Split a line into tokens separated by whitespace, ignoring comments (everything after a '#')
+ * @return The number of tokens in the line. Only the first MAX_TOKENS are stored.
+ */
+int tokenize(const char* begin, const char* end, Token* tokens)
+{
+    const char* comment = static_cast<const char*>(std::memchr(begin, '#', size_t(end - begin)));
+    if (comment)
+        end = comment;
+
+    int count = 0;
+    const char* p = begin;
+
+    while (true) {
+        while (p < end && isSpace(*p))
+            ++p;
+        if (p == end)
+            break;
+
+        const char* start = p;
+        while (p < end && !isSpace(*p))
+            ++p;
+
+        if (count < MAX_TOKENS)
+            tokens[count] = Token {start, int(p - start)};
+        ++count;
+    }
+
+    return count;
+}
+
+}
 
 RoutineController::RoutineController(ApplicationController *applicationController)
     : mRunStatus(NotReady)
@@ -7,23 +80,47 @@ RoutineController::RoutineController(ApplicationController *applicationControlle
     , mErrorCount(0)
     , mStopRequested(false)
     , mPauseRequested(false)
+    , mWakeRequested(false)
+    , mWatchedController(0)
+    , mParsed(false)
+    , mStepsModel(new RoutineStepsModel(this))
     , mNumberOfSteps(-1)
     , mTotalWaitTime(0)
     , mElapsedTime(0)
+    , mCommandedOpenValves(0)
+    , mCommandedClosedValves(0)
+    , mResumeStep(-1)
+    , mResumeWaitRemaining(0)
     , appController(applicationController)
 {
 
 }
 
+/**
+ * @brief Stop the routine, if one is running, and wait for its thread to finish
+ */
+RoutineController::~RoutineController()
+{
+    stop();
+    if (mThread.joinable())
+        mThread.join();
+}
+
 /**
  * @brief Reset the controller, deleting any stored routine and other information.
  */
 void RoutineController::reset()
 {
-    mLines.clear();
-    mValidSteps.clear();
+    mStepsModel->beginUpdate();
+    mSource.close();
+    mSteps.clear();
+    mParsed = false;
+    mParseErrors.clear();
+    mMultiplexerChannels.clear();
     mErrors.clear();
     mRoutineName.clear();
+    mFileUrl.clear();
+    mRoutineHash.clear();
 
     mNumberOfSteps = 0;
     mCurrentStep = -1;
@@ -32,40 +129,35 @@ void RoutineController::reset()
     mTotalWaitTime = 0;
     mElapsedTime = 0;
     mPauseRequested = false;
+    mStepsModel->endUpdate();
 }
 
 /**
- * @brief Load and parse the routine stored in the specified file
+ * @brief Load the routine stored in the specified file
  * @param fileUrl The URL of the text file containing the routine
  *
  *
- * Note that the routine is not checked by this function, only loaded. Use the
- * verify() function for sanity checking.
+ * Note that the routine is not checked by this function, only loaded (large files are not read). Use the
+ * verify() function to parse it and check it for errors.
  */
 bool RoutineController::loadFile(QString fileUrl)
 {
     reset();
 
     QUrl url(fileUrl);
-    QFile file(url.toLocalFile());
 
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QString error = "Could not load file " + url.toLocalFile() + " : " + file.errorString();
+    if (!mSource.open(url.toLocalFile())) {
+        QString error = "Could not load file " + url.toLocalFile() + " : " + mSource.errorString();
         qWarning() << error;
         return false;
     }
 
-    QTextStream stream(&file);
-
-    while (!stream.atEnd())
-        mLines << stream.readLine();
-
-    file.close();
-
     // TODO? have a few lines towards the beginning of the file that would specify the routine's name and description
-    QFileInfo fileinfo(file);
+    QFileInfo fileinfo(url.toLocalFile());
     mRoutineName = fileinfo.baseName();
 
+    mFileUrl = fileUrl;
+
     mRunStatus = Ready;
     emit runStatusChanged(Ready);
     return true;
@@ -80,7 +172,8 @@ bool RoutineController::loadFile(QString fileUrl)
  */
 int RoutineController::verify()
 {
-    run(true);
+    parse();
+    reportParseErrors();
     return mErrorCount;
 }
 
@@ -89,8 +182,29 @@ int RoutineController::verify()
  */
 void RoutineController::begin()
 {
-    std::thread t([this] { run(false); });
-    t.detach();
+    mCommandedOpenValves = 0;
+    mCommandedClosedValves = 0;
+    mCommandedPressures.clear();
+    mResumeStep = -1;
+    mResumeWaitRemaining = 0;
+
+    // Errors are reported here rather than during execution
+    if (!mParsed)
+        verify();
+
+    start();
+}
+
+/**
+ * @brief Launch the execution of the routine in a separate thread
+ */
+void RoutineController::start()
+{
+    // The previous run is over (or about to return, if its finished() signal triggered this call)
+    if (mThread.joinable())
+        mThread.join();
+
+    mThread = std::thread([this] { run(); });
 }
 
 /**
@@ -129,9 +243,113 @@ void RoutineController::resume()
 void RoutineController::wake()
 {
     std::lock_guard<std::mutex> lockGuard(mWakeMutex);
+    mWakeRequested = true;
     mWakeConditionVariable.notify_one();
 }
 
+/**
+ * @brief Update the latest measured pressure of a controller, for use by `wait until` commands
+ * @param controllerNumber The controller's number (starting at 1)
+ * @param pressure The measured pressure, in PSI
+ *
+ * This can be called from any thread. The routine thread is only woken up if the value changed, and if
+ * it is currently waiting on this controller.
+ */
+void RoutineController::setMeasuredPressure(uint controllerNumber, double pressure)
+{
+    std::lock_guard<std::mutex> lockGuard(mWakeMutex);
+
+    auto it = mMeasuredPressures.find(controllerNumber);
+    if (it != mMeasuredPressures.end() && it.value() == pressure)
+        return;
+
+    mMeasuredPressures[controllerNumber] = pressure;
+
+    if (mWatchedController == controllerNumber)
+        mWakeConditionVariable.notify_one();
+}
+
+/**
+ * @brief Check whether a checkpoint was left by a routine that didn't finish (e.g. due to a crash)
+ *
+ * This should be called once, at startup, before any routine is run.
+ */
+bool RoutineController::checkpointAvailable()
+{
+    mCheckpoint = RoutineCheckpoint::deserialize(mCheckpointWriter.read());
+    return mCheckpoint.isValid();
+}
+
+/**
+ * @brief Return a human-readable description of the checkpoint found by checkpointAvailable()
+ */
+QString RoutineController::checkpointDescription()
+{
+    if (!mCheckpoint.isValid())
+        return QString();
+
+    return "Routine \"" + mCheckpoint.routineName + "\" was interrupted at step "
+            + QString::number(mCheckpoint.step + 1) + " of " + QString::number(mCheckpoint.numberOfSteps)
+            + " (" + mCheckpoint.time.toLocalTime().toString("yyyy-MM-dd hh:mm:ss") + ").";
+}
+
+/**
+ * @brief Resume the routine saved in the checkpoint found by checkpointAvailable()
+ * @return False if the routine could not be resumed, e.g. if the routine file has changed since.
+ *
+ * The routine file is re-loaded and verified, the device state is restored to what the routine
+ * had commanded, then execution resumes at the step where it was interrupted.
+ */
+bool RoutineController::resumeFromCheckpoint()
+{
+    if (!mCheckpoint.isValid())
+        return false;
+
+    // A checkpoint that can't be resumed is discarded, so that it isn't offered again on the next start
+    if (!loadFile(mCheckpoint.fileUrl)) {
+        qWarning() << "Can't resume routine: could not open" << mCheckpoint.fileUrl;
+        discardCheckpoint();
+        return false;
+    }
+
+    // The hash is computed while parsing
+    parse();
+
+    if (mRoutineHash != mCheckpoint.routineHash) {
+        qWarning() << "Can't resume routine" << mRoutineName << ": the file has changed since it was interrupted";
+        discardCheckpoint();
+        return false;
+    }
+
+    reportParseErrors();
+
+    qInfo() << "Resuming routine" << mRoutineName << "at step" << mCheckpoint.step + 1;
+
+    mCommandedOpenValves = mCheckpoint.openValves;
+    mCommandedClosedValves = mCheckpoint.closedValves;
+    mCommandedPressures = mCheckpoint.pressures;
+    mResumeStep = mCheckpoint.step;
+    mResumeWaitRemaining = mCheckpoint.waitRemaining;
+
+    // Restore the device state first
+    emit setValves(mCommandedOpenValves, mCommandedClosedValves);
+    for (auto it = mCommandedPressures.constBegin(); it != mCommandedPressures.constEnd(); ++it)
+        emit setPressure(it.key(), it.value());
+
+    mCheckpoint = RoutineCheckpoint();
+    start();
+    return true;
+}
+
+/**
+ * @brief Delete the checkpoint found by checkpointAvailable(), e.g. if the user chose not to resume
+ */
+void RoutineController::discardCheckpoint()
+{
+    mCheckpoint = RoutineCheckpoint();
+    mCheckpointWriter.clear();
+}
+
 RoutineController::RunStatus RoutineController::status()
 {
     return mRunStatus;
@@ -156,18 +374,37 @@ int RoutineController::numberOfSteps()
 
 /**
  * @brief Return the entire contents of the routine file, with one line per string
+ *
+ * The lines are read from the file on every call, so this should be avoided for large routines.
+ */
+QStringList RoutineController::fileContents()
+{
+    return mSource.lines();
+}
+
+/**
+ * @brief Return the text of a valid step of the routine, without comments and excess whitespace
+ *
+ * This is read from the file, so the routine must still be loaded.
  */
-const QStringList& RoutineController::fileContents()
+QString RoutineController::stepText(int step)
 {
-    return mLines;
+    if (step < 0 || step >= mSteps.size())
+        return QString();
+
+    QString line = mSource.text(mSteps.at(step).source);
+    int comment = line.indexOf('#');
+    if (comment >= 0)
+        line.truncate(comment); // remove hashes and all following characters
+    return line.simplified();
 }
 
 /**
- * @brief Return the list of valid steps of the routine. Lines with errors are removed.
+ * @brief Return a list model of the valid steps of the routine, whose text is only read when displayed
  */
-const QStringList& RoutineController::steps()
+QAbstractItemModel* RoutineController::stepsModel()
 {
-    return mValidSteps;
+    return mStepsModel;
 }
 
 int RoutineController::numberOfErrors()
@@ -181,207 +418,407 @@ const QStringList& RoutineController::errors()
 }
 
 /**
- * @brief Run the routine
- * @param dummyRun If true, all steps will be checked for errors but not executed.
- *
- * Errors found during execution are emitted by the error() signal (see the reportError function)
- *
- * This function can be run directly (recommended for error-checking) or in a separate thread (recommended for
- * actual execution).
+ * @brief Parse the routine file into a list of steps (mSteps), in a single pass
  *
+ * Every line is checked, and errors are stored in mParseErrors to be reported by reportParseErrors(). Lines are
+ * split into tokens in place, so only steps and errors are allocated. The hash of the file is computed in the same
+ * pass.
  */
-void RoutineController::run(bool dummyRun)
+void RoutineController::parse()
 {
-    mErrorCount = 0;
-    mErrors.clear();
+    mStepsModel->beginUpdate();
+
+    mSteps.clear();
+    mParseErrors.clear();
+    mMultiplexerChannels.clear();
     mCurrentStep = -1;
-    mStopRequested = false;
+    mTotalWaitTime = 0;
     mElapsedTime = 0;
 
-    if (!dummyRun) {
-        mRunStatus = Running;
-        emit runStatusChanged(Running);
-    }
-
-    if (dummyRun) {
-        mValidSteps.clear();
-        mTotalWaitTime = 0;
-    }
-
     uint nValves = appController->nValves();
     uint nPressureControllers = appController->nPressureControllers();
 
-    for (int i(0); i < mLines.size(); ++i) {
+    auto addError = [this](int i, QString const& message) {
+        mParseErrors << "Line " + QString::number(i+1) + ": " + message;
+    };
+
+    // This is the hash of the lines joined with "\n", so that it doesn't depend on line endings
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    // The file is only mapped while it is parsed; stepText() reads it back line by line afterwards
+    mSource.map();
 
-        QString line = mLines[i];
-        line.remove(QRegExp("#.*")); // remove hashes and all following characters.
-        line = line.simplified(); // remove excess whitespace
+    qint64 position = mSource.start();
+    RoutineSource::Line source;
+    Token list[MAX_TOKENS];
 
-        if (line.isEmpty())
+    for (int i(0); mSource.nextLine(position, source); ++i) {
+        const char* data = mSource.data(source);
+
+        if (i > 0)
+            hash.addData("\n", 1);
+        hash.addData(data, source.length);
+
+        int length = tokenize(data, data + source.length, list);
+        if (length == 0)
             continue;
 
-        QStringList list = line.split(' ');
-        int length = list.size();
+        Step step = Step();
+        step.source = source;
+        step.line = i;
 
         if (list[0] == "valve") {
             // Expected format: valve <number> <open / close>. e.g: valve 12 open. "Number" can also be "all" to open/close all valves at once.
             if (length != 3) {
-                reportError("Line " + QString::number(i+1) + ": line starting with \"valve\" should contain 3 arguments. For example, \"valve 12 open\"");
+                addError(i, "line starting with \"valve\" should contain 3 arguments. For example, \"valve 12 open\"");
                 continue;
             }
 
-            uint valveNumber(0);
-            bool toggleAll = false;
-
-            if (list[1] == "all")
-                toggleAll = true;
-            else {
+            if (list[1] != "all") {
                 bool ok;
-                valveNumber = list[1].toUInt(&ok);
+                uint valveNumber = list[1].bytes().toUInt(&ok);
                 if (!ok || valveNumber < 1 || valveNumber > nValves) {
-                    reportError("Line " + QString::number(i+1) + ": invalid valve ID: " + list[1]
-                                + ". Must be 'all' or an integer between 1 and " + QString::number(nValves));
+                    addError(i, "invalid valve ID: " + list[1].toString()
+                             + ". Must be 'all' or an integer between 1 and " + QString::number(nValves));
                     continue;
                 }
+                step.number = quint16(valveNumber);
             }
 
-            QString state = list[2];
-            if (state != "open" && state != "close") {
-                reportError("Line " + QString::number(i+1) + ": valve status not recognized: " + state);
+            if (list[2] != "open" && list[2] != "close") {
+                addError(i, "valve status not recognized: " + list[2].toString());
                 continue;
             }
 
-            if (dummyRun)
-                mValidSteps << line;
-            else {
-                setCurrentStep(mCurrentStep+1);
-
-                if (toggleAll) {
-                    for (uint v(1); v <= nValves; v++)
-                        emit setValve(v, (state == "open"));
-                }
-
-                else
-                    emit setValve(valveNumber, (state == "open"));
-
-                // Signals & slots are necessary to avoid calling QSerialPort->write from a different thread
-                // (in which case it throws a QTimer-related error message), which is why "emit setValve" etc.
-                // are used here.
-            }
+            step.command = Valve;
+            step.op = (list[2] == "open");
         }
 
         else if (list[0] == "pressure") {
             // Expected format: pressure <number> <value>. e.g: pressure 1 8.2
             if (length != 3) {
-                reportError("Line " + QString::number(i+1) + ": line starting with \"pressure\" should contain 3 arguments. For example, \"pressure 2 6.3\"");
+                addError(i, "line starting with \"pressure\" should contain 3 arguments. For example, \"pressure 2 6.3\"");
                 continue;
             }
             bool ok;
-            uint controllerNumber = list[1].toUInt(&ok);
+            uint controllerNumber = list[1].bytes().toUInt(&ok);
             if (!ok || controllerNumber < 1 || controllerNumber > nPressureControllers) {
-                reportError("Line " + QString::number(i+1) + ": invalid pressure controller ID: " + list[1]
-                            + ". Must be an integer between 1 and " + QString::number(nPressureControllers));
+                addError(i, "invalid pressure controller ID: " + list[1].toString()
+                         + ". Must be an integer between 1 and " + QString::number(nPressureControllers));
                 continue;
             }
 
-            double pressure = list[2].toDouble(&ok);
-            if (!ok || pressure < 0) {
-                reportError("Line " + QString::number(i+1) + ": Pressure value invalid: " + list[2]);
+            double pressure = list[2].bytes().toDouble(&ok);
+            if (!ok) {
+                addError(i, "Pressure value invalid: " + list[2].toString());
                 continue;
             }
             else if (pressure < appController->minPressure(controllerNumber)
                      || pressure > appController->maxPressure(controllerNumber)) {
-                reportError("Line " + QString::number(i+1) + ": Pressure value out of bounds for this controller: " + list[2]);
+                addError(i, "Pressure value out of bounds for this controller: " + list[2].toString());
                 continue;
             }
 
-            if (dummyRun)
-                mValidSteps << line;
-            else {
-                // TODO: fix this for negative values (vacuum controller).
-                double p = appController->minPressure(controllerNumber)
-                        + (pressure / appController->maxPressure(controllerNumber));
-                setCurrentStep(mCurrentStep+1);
-                emit setPressure(controllerNumber, p);
+            step.command = Pressure;
+            step.number = quint16(controllerNumber);
+            step.value = pressure;
+        }
+
+        else if (list[0] == "wait" && length > 1 && list[1] == "until") {
+            // Expected format: wait until pressure <number> <op> <value> [timeout <time> [<unit>]]
+            // e.g: `wait until pressure 1 >= 5.5 timeout 2 min`
+            if ((length != 6 && length != 8 && length != 9) || list[2] != "pressure" || (length > 6 && list[6] != "timeout")) {
+                addError(i, "invalid \"wait until\" command. For example: \"wait until pressure 1 >= 5.5 timeout 2 min\"");
+                continue;
+            }
+
+            bool ok;
+            uint controllerNumber = list[3].bytes().toUInt(&ok);
+            if (!ok || controllerNumber < 1 || controllerNumber > nPressureControllers) {
+                addError(i, "invalid pressure controller ID: " + list[3].toString()
+                         + ". Must be an integer between 1 and " + QString::number(nPressureControllers));
+                continue;
+            }
+
+            int op = 0;
+            while (op < NUM_COMPARISONS && list[4] != COMPARISON_OPERATORS[op])
+                ++op;
+            if (op == NUM_COMPARISONS) {
+                addError(i, "invalid comparison operator: " + list[4].toString() + ". Must be one of <, <=, >, >=");
+                continue;
             }
 
+            double value = list[5].bytes().toDouble(&ok);
+            if (!ok || value < appController->minPressure(controllerNumber)
+                    || value > appController->maxPressure(controllerNumber)) {
+                addError(i, "Pressure value invalid or out of bounds for this controller: " + list[5].toString());
+                continue;
+            }
+
+            double timeout = 0;
+            if (length > 6) {
+                timeout = list[7].bytes().toDouble(&ok);
+                if (!ok || timeout <= 0) {
+                    addError(i, "could not parse timeout argument: " + list[7].toString());
+                    continue;
+                }
+                if (length == 9)
+                    timeout *= timeUnitMultiplier(list[8].bytes());
+            }
+
+            step.command = WaitUntil;
+            step.number = quint16(controllerNumber);
+            step.op = quint8(op);
+            step.value = value;
+            step.timeout = timeout;
+
+            // The actual duration is unknown in advance, so the timeout is used for the run time estimate
+            // (and for the elapsed time once done), so that the time left remains consistent.
+            mTotalWaitTime += timeout;
         }
 
         else if (list[0] == "wait") {
             // Expected format:  wait <time> <unit> . <unit> defaults to seconds. e.g: `wait 10 minutes`, `wait 60`
             if (length != 2 && length != 3) {
-                reportError("Line " + QString::number(i+1) + ": line starting with \"wait\" should contain 2 or 3 arguments. For example, \"wait 2 min\"");
+                addError(i, "line starting with \"wait\" should contain 2 or 3 arguments. For example, \"wait 2 min\"");
                 continue;
             }
 
             bool ok;
-            double time = list[1].toDouble(&ok);
+            double time = list[1].bytes().toDouble(&ok);
             if (!ok) {
-                reportError("Line " + QString::number(i+1) + ": could not parse wait time argument: " + list[1]);
+                addError(i, "could not parse wait time argument: " + list[1].toString());
                 continue;
             }
 
-            if (length == 3) {
-                double multiplier = 1.0;
+            if (length == 3)
+                time *= timeUnitMultiplier(list[2].bytes());
 
-                if (list[2] == "ms" || list[2] == "milliseconds" || list[2] == "millisecond" || list[2] == "msec")
-                    multiplier = 0.001;
-                else if (list[2] == "minutes" || list[2] == "minute" || list[2] == "min" || list[2] == "mins" || list[2] == "min")
-                    multiplier = 60;
-                else if (list[2] == "hours" || list[2] == "hour" || list[2] == "hrs" || list[2] == "hr" || list[2] == "h")
-                    multiplier = 3600;
+            step.command = Wait;
+            step.value = time;
+            mTotalWaitTime += time;
+        }
 
-                time *= multiplier;
+        else if (list[0] == "multiplexer" || list[0] == "input") {
+            // Expected format: multiplexer X, where X is the label of a channel, e.g. 1-8 or "all".
+            // Or, for the input multiplexer: input X, where X is the input label.
+            if (length != 2) {
+                QString command = list[0].toString();
+                addError(i, "line starting with \"" + command + "\" should contain 2 arguments. For example, \"" + command + " 4\"");
+                continue;
             }
 
+            // Channels are resolved here, so that execution only involves looking up the valve bitmasks.
+            bool isInput = (list[0] == "input");
+            const Multiplexer* mux = appController->routineMultiplexer(isInput);
+            Multiplexer::Channel channel;
 
-            if (dummyRun) {
-                mValidSteps << line;
-                mTotalWaitTime += time;
-                totalRunTimeChanged(mTotalWaitTime);
+            if (!mux) {
+                addError(i, QString("the current chip has no ") + (isInput ? "input multiplexer" : "multiplexer"));
+                continue;
             }
-
-            else {
-                setCurrentStep(mCurrentStep+1);
-                std::unique_lock<std::mutex> lock(mWakeMutex);
-                mWakeConditionVariable.wait_for(lock, std::chrono::milliseconds(uint64_t(time*1000)));
-                mElapsedTime += time;
-                emit elapsedTimeChanged(mElapsedTime);
+            if (!mux->findChannel(list[1].toString(), channel)) {
+                addError(i, "unknown channel for multiplexer " + mux->name() + ": " + list[1].toString()
+                         + ". Valid channels are: " + mux->channelLabels().join(", "));
+                continue;
             }
+
+            mMultiplexerChannels[i] = channel;
+            step.command = isInput ? SetInputMultiplexer : SetMultiplexer;
         }
 
-        else if (list[0] == "multiplexer") {
-            // Expected format: multiplexer X, where X is 1-8 or "all".
-            if (length != 2) {
-                reportError("Line " + QString::number(i+1) + ": line starting with \"multiplexer\" should contain 2 arguments. For example, \"multiplexer 4\"");
-                continue;
+        else
+            continue;
+
+        mSteps << step;
+    }
+
+    mSource.unmap();
+
+    mSteps.squeeze();
+    mRoutineHash = mSource.isOpen() ? hash.result() : QByteArray();
+    mNumberOfSteps = mSteps.size();
+    mParsed = true;
+
+    mStepsModel->endUpdate();
+}
+
+/**
+ * @brief Report the errors found by parse(), emitting the error() signal for each of them
+ */
+void RoutineController::reportParseErrors()
+{
+    mErrors.clear();
+    mErrorCount = 0;
+
+    for (QString const& e : mParseErrors)
+        reportError(e);
+
+    emit totalRunTimeChanged(mTotalWaitTime);
+}
+
+/**
+ * @brief Execute the steps of the routine, as parsed by verify()
+ *
+ * Errors found during execution are emitted by the error() signal (see the reportError function), and added to the
+ * errors found when parsing.
+ *
+ * This function is run in a separate thread (see start()).
+ *
+ */
+void RoutineController::run()
+{
+    mErrors = mParseErrors;
+    mErrorCount = mParseErrors.size();
+    mCurrentStep = -1;
+    mStopRequested = false;
+    mElapsedTime = 0;
+
+    mRunStatus = Running;
+    emit runStatusChanged(Running);
+
+    uint nValves = appController->nValves();
+
+    for (int s(0); s < mSteps.size(); ++s) {
+        Step const& step = mSteps.at(s);
+
+        switch (step.command) {
+        case Valve:
+            if (!skipForResume()) {
+                bool open = step.op;
+                setCurrentStep(mCurrentStep+1);
+
+                if (step.number == 0) {
+                    for (uint v(1); v <= nValves; v++)
+                        emit setValve(v, open);
+                }
+
+                else
+                    emit setValve(step.number, open);
+
+                quint32 mask = step.number == 0 ? (nValves >= 32 ? 0xFFFFFFFF : (1u << nValves) - 1) : (1u << (step.number - 1));
+                if (open)
+                    commandValves(mask, 0);
+                else
+                    commandValves(0, mask);
+                saveCheckpoint(mCurrentStep+1);
+
+                // Signals & slots are necessary to avoid calling QSerialPort->write from a different thread
+                // (in which case it throws a QTimer-related error message), which is why "emit setValve" etc.
+                // are used here.
             }
+            break;
 
-            QString channel = list[1];
+        case Pressure:
+            if (!skipForResume()) {
+                // Fraction of the controller's range, which may start below 0 (vacuum controller)
+                double min = appController->minPressure(step.number);
+                double p = (step.value - min) / (appController->maxPressure(step.number) - min);
+                setCurrentStep(mCurrentStep+1);
+                emit setPressure(step.number, p);
+                mCommandedPressures[step.number] = p;
+                saveCheckpoint(mCurrentStep+1);
+            }
+            break;
 
-            // To do: re-implement error checking
+        case WaitUntil:
+            if (skipForResume())
+                mElapsedTime += step.timeout;
 
-            if (dummyRun)
-                mValidSteps << line;
             else {
                 setCurrentStep(mCurrentStep+1);
-                emit setMultiplexer(channel);
-            }
-        }
+                saveCheckpoint(mCurrentStep);
+
+                auto conditionMet = [&]() {
+                    if (mWakeRequested)
+                        return true;
+                    auto it = mMeasuredPressures.constFind(step.number);
+                    if (it == mMeasuredPressures.constEnd())
+                        return false;
+                    double p = it.value();
+                    switch (step.op) {
+                    case Less: return p < step.value;
+                    case LessOrEqual: return p <= step.value;
+                    case Greater: return p > step.value;
+                    case GreaterOrEqual: return p >= step.value;
+                    }
+                    return false;
+                };
 
-        else if (list[0] == "input") {
-            // Input multiplexer. Expected format: input X, where X is the input label as defined in the GraphicalControl QML file
-            if (length != 2) {
-                reportError("Line " + QString::number(i+1) + ": line starting with \"input\" should contain 2 arguments. For example, \"input 4\"");
-                continue;
+                std::unique_lock<std::mutex> lock(mWakeMutex);
+                mWakeRequested = false;
+                mWatchedController = step.number;
+
+                bool met = true;
+                if (step.timeout > 0)
+                    met = mWakeConditionVariable.wait_for(lock, std::chrono::milliseconds(uint64_t(step.timeout*1000)), conditionMet);
+                else
+                    mWakeConditionVariable.wait(lock, conditionMet);
+
+                mWatchedController = 0;
+                lock.unlock();
+
+                if (!met)
+                    reportError("Line " + QString::number(step.line+1) + ": timed out waiting for pressure " + QString::number(step.number)
+                                + " " + COMPARISON_OPERATORS[step.op] + " " + QString::number(step.value) + " PSI");
+
+                saveCheckpoint(mCurrentStep+1);
+                mElapsedTime += step.timeout;
+                emit elapsedTimeChanged(mElapsedTime);
             }
-            QString channel = list[1];
-            if (dummyRun)
-                mValidSteps << line;
+            break;
+
+        case Wait:
+            if (skipForResume())
+                mElapsedTime += step.value;
+
             else {
                 setCurrentStep(mCurrentStep+1);
-                emit setInputMultiplexer(channel);
+
+                // The wait is done in chunks, so that the checkpoint can be kept up to date
+                qint64 remaining = qint64(step.value*1000);
+                if (mCurrentStep == mResumeStep) {
+                    // The time remaining is only saved once the wait has started; if it is 0, the checkpoint was
+                    // taken before (e.g. at the end of the previous step), and the whole wait is still to be done.
+                    if (mResumeWaitRemaining > 0)
+                        remaining = qMin(remaining, mResumeWaitRemaining);
+                    mResumeStep = -1;
+                }
+
+                auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(remaining);
+                std::unique_lock<std::mutex> lock(mWakeMutex);
+                mWakeRequested = false;
+
+                while (remaining > 0 && !mWakeRequested) {
+                    saveCheckpoint(mCurrentStep, remaining);
+                    auto chunkEnd = std::min(end, std::chrono::steady_clock::now() + std::chrono::milliseconds(CHECKPOINT_INTERVAL));
+                    mWakeConditionVariable.wait_until(lock, chunkEnd, [this]{ return mWakeRequested.load(); });
+                    remaining = std::chrono::duration_cast<std::chrono::milliseconds>(end - std::chrono::steady_clock::now()).count();
+                }
+                lock.unlock();
+
+                saveCheckpoint(mCurrentStep+1);
+                mElapsedTime += step.value;
+                emit elapsedTimeChanged(mElapsedTime);
+            }
+            break;
+
+        case SetMultiplexer:
+        case SetInputMultiplexer:
+            if (!skipForResume()) {
+                Multiplexer::Channel channel = mMultiplexerChannels.value(step.line);
+
+                setCurrentStep(mCurrentStep+1);
+                emit setValves(channel.openMask, channel.closeMask);
+                commandValves(channel.openMask, channel.closeMask);
+                saveCheckpoint(mCurrentStep+1);
+
+                if (step.command == SetInputMultiplexer)
+                    emit setInputMultiplexer(channel.label);
+                else
+                    emit setMultiplexer(channel.label);
             }
+            break;
         }
 
         if (mStopRequested)
@@ -402,20 +839,14 @@ void RoutineController::run(bool dummyRun)
         }
     }
 
-    if (!mValidSteps.empty())
-        emit stepsListChanged();
+    mResumeStep = -1;
+    mCheckpointWriter.clear();
 
-    if (dummyRun)
-        mNumberOfSteps = mValidSteps.size();
-
-    else {
-        mRunStatus = Finished;
-        emit runStatusChanged(Finished);
-        emit finished();
-    }
+    mRunStatus = Finished;
+    emit runStatusChanged(Finished);
+    emit finished();
 }
 
-
 void RoutineController::reportError(const QString &errorString)
 {
     mErrors << errorString;
@@ -431,3 +862,68 @@ void RoutineController::setCurrentStep(int stepNumber)
     mCurrentStep = stepNumber;
     emit currentStepChanged(stepNumber);
 }
+
+/**
+ * @brief Return the factor to convert a time in the given unit to seconds
+ *
+ * Units default to seconds, in case they don't match any other unit.
+ */
+double RoutineController::timeUnitMultiplier(const QByteArray &unit)
+{
+    if (unit == "ms" || unit == "milliseconds" || unit == "millisecond" || unit == "msec")
+        return 0.001;
+    else if (unit == "minutes" || unit == "minute" || unit == "min" || unit == "mins")
+        return 60;
+    else if (unit == "hours" || unit == "hour" || unit == "hrs" || unit == "hr" || unit == "h")
+        return 3600;
+
+    return 1.0;
+}
+
+/**
+ * @brief When resuming from a checkpoint, skip the steps that were already executed
+ * @return True if the next step should be skipped
+ *
+ * Skipped steps are counted, but not executed and not signalled to the GUI.
+ */
+bool RoutineController::skipForResume()
+{
+    if (mResumeStep < 0 || mCurrentStep + 1 >= mResumeStep)
+        return false;
+
+    mCurrentStep++;
+    return true;
+}
+
+/**
+ * @brief Record valves opened and closed by the routine, so that they can be restored when resuming
+ */
+void RoutineController::commandValves(quint32 openMask, quint32 closeMask)
+{
+    mCommandedOpenValves = (mCommandedOpenValves & ~closeMask) | openMask;
+    mCommandedClosedValves = (mCommandedClosedValves & ~openMask) | closeMask;
+}
+
+/**
+ * @brief Save the current progress of the routine
+ * @param step The step at which execution should resume
+ * @param waitRemaining If step is a wait command, the time (in ms) left to wait
+ *
+ * The checkpoint is written to disk in the background, so this doesn't delay execution.
+ */
+void RoutineController::saveCheckpoint(int step, qint64 waitRemaining)
+{
+    RoutineCheckpoint checkpoint;
+    checkpoint.fileUrl = mFileUrl;
+    checkpoint.routineName = mRoutineName;
+    checkpoint.routineHash = mRoutineHash;
+    checkpoint.step = step;
+    checkpoint.numberOfSteps = mNumberOfSteps;
+    checkpoint.waitRemaining = waitRemaining;
+    checkpoint.openValves = mCommandedOpenValves;
+    checkpoint.closedValves = mCommandedClosedValves;
+    checkpoint.pressures = mCommandedPressures;
+    checkpoint.time = QDateTime::currentDateTimeUtc();
+
+    mCheckpointWriter.post(checkpoint.serialize());
+}
@@ -8,7 +8,12 @@
 #include <QtCore>
 #include <QStringList>
 
+#include "multiplexer.h"
+#include "routinecheckpoint.h"
+#include "routinesource.h"
+
 class ApplicationController;
+class RoutineStepsModel;
 
 /**
  * @brief The RoutineController class loads and runs routines, i.e pre-programmed sequences of actions.
@@ -21,9 +26,19 @@ class ApplicationController;
  * contains no errors by calling verify(). This verifies every action without executing them, and returns the number
  * of errors found.
  *
+ * Large files are memory-mapped rather than read into memory (see RoutineSource), and verify() parses them in a
+ * single pass into a compact list of steps, which is what is executed. Only the position of each step in the file is
+ * kept, so its text is read again when needed, e.g. by stepsModel(). This keeps routines of millions of lines
+ * manageable.
+ *
  * You can then safely call begin() to run the routine. It is run in a separate thread to prevent blocking. Status
  * can be checked with the status() and currentStep() functions. When execution is over, the finished() signal is emitted.
  *
+ * While a routine runs, a checkpoint (see RoutineCheckpoint) is written in the background at every step, and
+ * periodically during long waits. If the application is closed or crashes before the routine finishes, the checkpoint
+ * can be found with checkpointAvailable() on the next start, and execution resumed from the same point with
+ * resumeFromCheckpoint(). The valves and pressures set by the routine are restored before it resumes.
+ *
  * Supported syntax
  * ---------------------
  *
@@ -45,9 +60,21 @@ class ApplicationController;
  *
  *      Example: wait 2 minutes
  *
+ * wait until pressure X OP Y [timeout T [U]]
+ *      Pause until the pressure measured by controller X satisfies the condition given by OP (one of <, <=, > or >=)
+ *      and Y (in PSI). The condition is checked every time a new measurement is received from that controller.
+ *      If a timeout is given (T, in units U, which are parsed like those of `wait`) and the condition is not met
+ *      in time, an error is reported and the routine continues. Without a timeout, the wait is indefinite.
+ *
+ *      Example: wait until pressure 1 >= 4.5 timeout 30 seconds
+ *
  *
  * multiplexer X
- *      Open multiplexer to channel X, where X is 1-8 or "all".
+ *      Open multiplexer to channel X, where X is the label of one of the channels (e.g. 1-8 or "all") of the
+ *      multiplexer of the current chip. See Multiplexer and ApplicationController::routineMultiplexer.
+ *
+ * input X
+ *      Same as multiplexer, but for the input multiplexer of the current chip.
  *
  */
 class RoutineController : public QObject
@@ -57,7 +84,7 @@ class RoutineController : public QObject
     Q_PROPERTY(int currentStep READ currentStep NOTIFY currentStepChanged)
     Q_PROPERTY(RunStatus runStatus READ status NOTIFY runStatusChanged)
     Q_PROPERTY(QStringList errorList READ errors NOTIFY error)
-    Q_PROPERTY(QStringList stepsList READ steps NOTIFY stepsListChanged)
+    Q_PROPERTY(QAbstractItemModel* stepsModel READ stepsModel CONSTANT)
     Q_PROPERTY(long totalRunTime READ totalRunTime NOTIFY totalRunTimeChanged)
     Q_PROPERTY(long elapsedTime READ elapsedTime NOTIFY elapsedTimeChanged)
 
@@ -71,7 +98,7 @@ public:
     }; Q_ENUM(RunStatus)
 
     RoutineController(ApplicationController* applicationController);
-    virtual ~RoutineController() {}
+    virtual ~RoutineController();
 
     Q_INVOKABLE bool loadFile(QString fileUrl);
     Q_INVOKABLE int verify();
@@ -81,25 +108,30 @@ public:
     Q_INVOKABLE void resume();
     Q_INVOKABLE void wake();
 
+    Q_INVOKABLE bool checkpointAvailable();
+    Q_INVOKABLE QString checkpointDescription();
+    Q_INVOKABLE bool resumeFromCheckpoint();
+    Q_INVOKABLE void discardCheckpoint();
+
     RunStatus status();
 
     int currentStep();
     Q_INVOKABLE int numberOfSteps();
     Q_INVOKABLE int numberOfErrors();
 
-    Q_INVOKABLE const QStringList &steps();
+    QString stepText(int step);
+    QAbstractItemModel* stepsModel();
 
-    const QStringList &fileContents();
+    QStringList fileContents();
     const QStringList& errors();
 
     Q_INVOKABLE QString routineName() { return mRoutineName; }
     Q_INVOKABLE long totalRunTime() { return mTotalWaitTime; }
     Q_INVOKABLE long elapsedTime() { return mElapsedTime; }
 
-signals:
-    /// Emitted when the list of steps is updated
-    void stepsListChanged();
+    void setMeasuredPressure(uint controllerNumber, double pressure);
 
+signals:
     /// Emitted whenever an error is encountered
     void error(QString errorString);
 
@@ -125,15 +157,74 @@ signals:
     void elapsedTimeChanged(long time);
 
     void setValve(uint valveNumber, bool open);
+    void setValves(quint32 openMask, quint32 closeMask);
     void setPressure(uint controllerNumber, double value);
+
+    /// Emitted when the multiplexer is switched to a new channel. The valves are set via setValves;
+    /// this signal is for display purposes only.
     void setMultiplexer(QString label);
+
+    /// Same as setMultiplexer, for the input multiplexer
     void setInputMultiplexer(QString label);
 
 private:
+    /// Instruction executed by a step of the routine
+    enum Command : quint8 {
+        Valve,
+        Pressure,
+        Wait,
+        WaitUntil,
+        SetMultiplexer,
+        SetInputMultiplexer
+    };
+
+    /// Comparison operators of `wait until` commands
+    enum Comparison : quint8 {
+        Less,
+        LessOrEqual,
+        Greater,
+        GreaterOrEqual
+    };
+
+    /// A valid step of the routine, as parsed by verify()
+    struct Step
+    {
+        /// Position of the step's line in the file
+        RoutineSource::Line source;
+
+        /// Line number, starting at 0
+        int line;
+
+        Command command;
+
+        /// Valve: 1 to open, 0 to close. Wait until: a Comparison.
+        quint8 op;
+
+        /// Valve or pressure controller number. 0 for `valve all`.
+        quint16 number;
+
+        /// Pressure (or pressure threshold) in PSI, or wait time in seconds
+        double value;
+
+        /// Timeout of `wait until` commands in seconds, or 0 if none
+        double timeout;
+    };
+
     void reset();
-    void run(bool dummyRun);
+    void start();
+    void parse();
+    void reportParseErrors();
+    void run();
     void reportError(const QString& errorString);
     void setCurrentStep(int stepNumber);
+    static double timeUnitMultiplier(const QByteArray& unit);
+
+    bool skipForResume();
+    void commandValves(quint32 openMask, quint32 closeMask);
+    void saveCheckpoint(int step, qint64 waitRemaining = 0);
+
+    /// Thread running the routine. It is joined before the next run starts, and when the controller is destroyed.
+    std::thread mThread;
 
     std::atomic<RunStatus> mRunStatus;
     std::atomic<int> mCurrentStep;
@@ -157,11 +248,33 @@ private:
     /// Condition variable used by waking functionality (to wake thread when it is in a wait command)
     std::condition_variable mWakeConditionVariable;
 
-    /// The raw contents of the routine file, including empty lines and comments
-    QStringList mLines;
+    /// Set by wake(), to end the current wait command early
+    std::atomic<bool> mWakeRequested;
+
+    /// Latest measured pressure (in PSI) for each controller. Protected by mWakeMutex.
+    QMap<uint, double> mMeasuredPressures;
+
+    /// Controller watched by the current `wait until` command, or 0 if none. Protected by mWakeMutex.
+    uint mWatchedController;
+
+    /// The routine file, including empty lines and comments
+    RoutineSource mSource;
 
     /// The valid steps of the routine. This is initialized only after verify() has run.
-    QStringList mValidSteps;
+    QVector<Step> mSteps;
+
+    /// True once the loaded file was parsed into mSteps
+    bool mParsed;
+
+    /// Errors found when parsing the file
+    QStringList mParseErrors;
+
+    /// Lazy view of mSteps for the GUI
+    RoutineStepsModel* mStepsModel;
+
+    /// Multiplexer channels used by `multiplexer` and `input` commands, resolved during verification.
+    /// The key is the line number.
+    QHash<int, Multiplexer::Channel> mMultiplexerChannels;
 
     /// Number of valid steps in the routine
     int mNumberOfSteps;
@@ -178,6 +291,30 @@ private:
     /// Approximate time elapsed (sum of wait times done)
     long mElapsedTime;
 
+    /// URL of the routine file, and hash of its contents (to check that it hasn't changed when resuming)
+    QString mFileUrl;
+    QByteArray mRoutineHash;
+
+    /// Valves opened and closed by the routine so far (bit 0 corresponds to valve 1)
+    quint32 mCommandedOpenValves;
+    quint32 mCommandedClosedValves;
+
+    /// Pressure setpoints (normalized) given by the routine so far, with the controller number as key
+    QMap<uint, double> mCommandedPressures;
+
+    /// When resuming from a checkpoint: the step to resume at, and time remaining if that step is a wait.
+    /// mResumeStep is -1 when not resuming.
+    int mResumeStep;
+    qint64 mResumeWaitRemaining;
+
+    /// Checkpoint found on disk by checkpointAvailable()
+    RoutineCheckpoint mCheckpoint;
+
+    CheckpointWriter mCheckpointWriter;
+
+    /// Interval at which checkpoints are updated during long wait commands, in milliseconds
+    static const qint64 CHECKPOINT_INTERVAL = 10000;
+
     ApplicationController* appController;
 };
 
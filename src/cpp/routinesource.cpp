@@ -0,0 +1,210 @@
+#include "routinesource.h"
+
+#include <climits>
+#include <cstring>
+
+namespace {
+
+/// Length of the UTF-8 byte order mark, if data starts with one, or 0
+qint64 byteOrderMarkLength(const char* data, qint64 size)
+{
+    return size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0 ? 3 : 0;
+}
+
+}
+
+RoutineSource::RoutineSource()
+    : mOpen(false)
+    , mData(nullptr)
+    , mSize(0)
+    , mMapping(nullptr)
+    , mStart(0)
+{
+}
+
+/**
+ * @brief Open the given file, closing the previous one. Small files are read entirely.
+ * @return False if the file could not be opened; see errorString()
+ */
+bool RoutineSource::open(const QString &path)
+{
+    close();
+    mErrorString.clear();
+
+    std::lock_guard<std::mutex> lock(mReadMutex);
+
+    mFile.setFileName(path);
+    if (!mFile.open(QIODevice::ReadOnly)) {
+        mErrorString = mFile.errorString();
+        return false;
+    }
+
+    if (mFile.size() <= MAX_BUFFERED_SIZE) {
+        mBuffer = mFile.readAll();
+        bool failed = mFile.error() != QFileDevice::NoError;
+        if (failed)
+            mErrorString = mFile.errorString();
+        mFile.close();
+
+        if (failed) {
+            mBuffer.clear();
+            return false;
+        }
+
+        mData = mBuffer.constData();
+        mSize = mBuffer.size();
+        mStart = byteOrderMarkLength(mData, mSize);
+    }
+
+    mOpen = true;
+    return true;
+}
+
+/**
+ * @brief Close the file and free its contents
+ */
+void RoutineSource::close()
+{
+    unmap();
+
+    std::lock_guard<std::mutex> lock(mReadMutex);
+    mFile.close();
+    mBuffer.clear();
+    mOpen = false;
+    mData = nullptr;
+    mSize = 0;
+    mStart = 0;
+}
+
+/**
+ * @brief Map the file into memory, so that it can be parsed with nextLine() and data(). Call unmap() when done.
+ *
+ * This does nothing for files that were read into memory. If mapping fails, the file is read into memory instead.
+ * The file must not be truncated while it is mapped.
+ */
+bool RoutineSource::map()
+{
+    if (!mOpen)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mReadMutex);
+
+    if (mData)
+        return true;
+
+    qint64 size = mFile.size();
+    mMapping = size > 0 ? mFile.map(0, size) : nullptr;
+
+    if (mMapping)
+        mData = reinterpret_cast<const char*>(mMapping);
+    else {
+        mFile.seek(0);
+        mBuffer = mFile.readAll();
+        mData = mBuffer.constData();
+        size = mBuffer.size();
+    }
+
+    mSize = size;
+    mStart = byteOrderMarkLength(mData, mSize);
+    return true;
+}
+
+/**
+ * @brief Release the mapping made by map(). Lines are then read from the file by text().
+ */
+void RoutineSource::unmap()
+{
+    std::lock_guard<std::mutex> lock(mReadMutex);
+
+    if (!mMapping)
+        return;
+
+    mFile.unmap(mMapping);
+    mMapping = nullptr;
+    mData = nullptr;
+}
+
+/**
+ * @brief Find the line starting at the given position. The file must be in memory (see map()).
+ * @param position Offset of the line in the file; start() for the first one. Updated to the start of the next line.
+ * @param line Set to the position of the line, without its terminator
+ * @return False if the end of the file was reached
+ */
+bool RoutineSource::nextLine(qint64 &position, Line &line) const
+{
+    return mData && nextLine(mData, mSize, position, line);
+}
+
+bool RoutineSource::nextLine(const char *data, qint64 size, qint64 &position, Line &line)
+{
+    if (position >= size)
+        return false;
+
+    const char* begin = data + position;
+    const char* newline = static_cast<const char*>(std::memchr(begin, '\n', size_t(size - position)));
+    const char* end = newline ? newline : data + size;
+
+    position = (newline ? newline + 1 : end) - data;
+
+    if (end > begin && end[-1] == '\r')
+        --end;
+
+    line.offset = begin - data;
+    line.length = int(qMin<qint64>(end - begin, INT_MAX));
+    return true;
+}
+
+/**
+ * @brief Return the text of a line. This can be called from any thread.
+ *
+ * If the file is not in memory, the line is read from it. If the file has shrunk since it was parsed, so that the
+ * line can't be read entirely, an empty string is returned.
+ */
+QString RoutineSource::text(const Line &line) const
+{
+    std::lock_guard<std::mutex> lock(mReadMutex);
+
+    if (mData) {
+        if (line.offset < 0 || line.offset + line.length > mSize)
+            return QString();
+        return QString::fromUtf8(mData + line.offset, line.length);
+    }
+
+    if (!mFile.isOpen() || !mFile.seek(line.offset))
+        return QString();
+
+    QByteArray data = mFile.read(line.length);
+    if (data.size() != line.length)
+        return QString();
+
+    return QString::fromUtf8(data);
+}
+
+/**
+ * @brief Return the text of every line of the file. This copies the whole file, so is only meant for small routines.
+ */
+QStringList RoutineSource::lines() const
+{
+    std::lock_guard<std::mutex> lock(mReadMutex);
+
+    QByteArray contents;
+    const char* data = mData;
+    qint64 size = mSize;
+
+    if (!data) {
+        if (!mFile.isOpen() || !mFile.seek(0))
+            return QStringList();
+        contents = mFile.readAll();
+        data = contents.constData();
+        size = contents.size();
+    }
+
+    QStringList lines;
+
+    qint64 position = byteOrderMarkLength(data, size);
+    Line line;
+    while (nextLine(data, size, position, line))
+        lines << QString::fromUtf8(data + line.offset, line.length);
+
+    return lines;
+}
@@ -0,0 +1,80 @@
+#ifndef ROUTINESOURCE_H
+#define ROUTINESOURCE_H
+
+#include <mutex>
+
+#include <QtCore>
+
+/**
+ * @brief Read-only view of a routine file, which avoids holding huge routines in memory
+ *
+ * Files of up to MAX_BUFFERED_SIZE are read into memory when opened, so editing them while they are loaded has no
+ * effect. Larger files are only memory-mapped while they are parsed (between map() and unmap()), and then kept open,
+ * so that individual lines can be read back with text().
+ *
+ * Lines are read one at a time with nextLine(), which only returns their position in the file. Their text is
+ * decoded (as UTF-8) on demand with text(), so a routine can be kept loaded as positions only, for error messages
+ * and for display.
+ *
+ * Lines are split on "\n" and "\r\n", and a leading UTF-8 byte order mark is ignored, like QTextStream does.
+ */
+class RoutineSource
+{
+public:
+    /// Position of a line in the file, excluding the line terminator
+    struct Line
+    {
+        qint64 offset;
+        int length;
+    };
+
+    RoutineSource();
+
+    bool open(QString const& path);
+    void close();
+
+    bool map();
+    void unmap();
+
+    bool isOpen() const { return mOpen; }
+    QString errorString() const { return mErrorString; }
+
+    bool nextLine(qint64& position, Line& line) const;
+
+    /**
+     * @brief Return the raw contents of a line. The data is not copied, so it is only valid until unmap() is called.
+     */
+    const char* data(Line const& line) const { return mData + line.offset; }
+
+    QString text(Line const& line) const;
+    QStringList lines() const;
+
+    qint64 start() const { return mStart; }
+
+    /// Files up to this size (in bytes) are read into memory rather than mapped
+    static const qint64 MAX_BUFFERED_SIZE = 64*1024*1024;
+
+private:
+    Q_DISABLE_COPY(RoutineSource)
+
+    static bool nextLine(const char* data, qint64 size, qint64& position, Line& line);
+
+    /// Open for the positioned reads of text() once the file is unmapped. Protected by mReadMutex.
+    mutable QFile mFile;
+    mutable std::mutex mReadMutex;
+
+    bool mOpen;
+
+    /// Contents of the file: mBuffer, or the mapping between map() and unmap(). Null when neither is available.
+    const char* mData;
+    qint64 mSize;
+    QByteArray mBuffer;
+    uchar* mMapping;
+
+    /// Offset of the first line, after the byte order mark if there is one
+    qint64 mStart;
+
+    QString mErrorString;
+};
+
+#endif // ROUTINESOURCE_H
@@ -0,0 +1,24 @@
+#include "routinestepsmodel.h"
+#include "routinecontroller.h"
+
+RoutineStepsModel::RoutineStepsModel(RoutineController *controller)
+    : QAbstractListModel(controller)
+    , mController(controller)
+{
+}
+
+int RoutineStepsModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return qMax(0, mController->numberOfSteps());
+}
+
+QVariant RoutineStepsModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= rowCount() || role != Qt::DisplayRole)
+        return QVariant();
+
+    return mController->stepText(index.row());
+}
@@ -0,0 +1,32 @@
+#ifndef ROUTINESTEPSMODEL_H
+#define ROUTINESTEPSMODEL_H
+
+#include <QAbstractListModel>
+
+class RoutineController;
+
+/**
+ * @brief List model of the valid steps of the loaded routine, for display in the GUI
+ *
+ * The text of a step is only read from the routine file when a view asks for it (see RoutineController::stepText),
+ * so views of routines with millions of steps only cost as much as the rows they show.
+ */
+class RoutineStepsModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    RoutineStepsModel(RoutineController* controller);
+
+    int rowCount(QModelIndex const& parent = QModelIndex()) const;
+    QVariant data(QModelIndex const& index, int role = Qt::DisplayRole) const;
+
+    /// Called by the RoutineController before and after its steps are replaced
+    void beginUpdate() { beginResetModel(); }
+    void endUpdate() { endResetModel(); }
+
+private:
+    RoutineController* mController;
+};
+
+#endif // ROUTINESTEPSMODEL_H
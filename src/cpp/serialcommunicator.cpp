@@ -94,6 +94,18 @@ QString SerialCommunicator::devicePort() const
     return mSerialPort->portName();
 }
 
+/**
+ * @brief Return the minimum time between two setpoints sent to the same controller, in ms
+ *
+ * At 115200 baud, a setpoint takes well under a millisecond to transmit, so the interval mostly leaves time for the
+ * microcontroller to apply it. At lower baud rates the link itself is the limit, and the interval grows accordingly.
+ */
+int SerialCommunicator::setpointInterval() const
+{
+    uint baudRate = qMax(1u, appController->serialBaudRate());
+    return int(qBound<quint64>(10, 10ull * 115200 / baudRate, 200));
+}
+
 void SerialCommunicator::handleSerialError(QSerialPort::SerialPortError error)
 {
     if (!mSerialPort)
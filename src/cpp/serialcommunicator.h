@@ -19,6 +19,8 @@ public:
 
     QString devicePort() const;
 
+    int setpointInterval() const;
+
 private slots:
     void handleSerialError(QSerialPort::SerialPortError error);
     void onSerialReady();
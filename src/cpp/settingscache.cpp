@@ -0,0 +1,118 @@
+#include "settingscache.h"
+
+#include <memory>
+
+/**
+ * @brief Persists a batch of changed settings
+ */
+class SettingsCache::WriteTask : public QRunnable
+{
+public:
+    WriteTask(QString const& fileName, QMap<QString, QVariant> const& values)
+        : mFileName(fileName)
+        , mValues(values)
+    {}
+
+    void run()
+    {
+        std::unique_ptr<QSettings> settings(mFileName.isEmpty() ? new QSettings()
+                                                                : new QSettings(mFileName, QSettings::IniFormat));
+
+        for (auto it = mValues.constBegin(); it != mValues.constEnd(); ++it)
+            settings->setValue(it.key(), it.value());
+
+        settings->sync();
+        if (settings->status() != QSettings::NoError)
+            qWarning() << "Could not save settings to" << settings->fileName();
+    }
+
+private:
+    QString mFileName;
+    QMap<QString, QVariant> mValues;
+};
+
+/**
+ * @param fileName An INI file to use instead of the application's settings (for tests)
+ */
+SettingsCache::SettingsCache(const QString &fileName, QObject *parent)
+    : QObject(parent)
+    , mFileName(fileName)
+{
+    mPool.setMaxThreadCount(1);
+
+    std::unique_ptr<QSettings> settings(mFileName.isEmpty() ? new QSettings()
+                                                            : new QSettings(mFileName, QSettings::IniFormat));
+    for (QString const& key : settings->allKeys())
+        mValues[key] = settings->value(key);
+
+    mWriteTimer.setSingleShot(true);
+    mWriteTimer.setInterval(WRITE_DELAY);
+    QObject::connect(&mWriteTimer, &QTimer::timeout, this, &SettingsCache::flush);
+}
+
+SettingsCache::~SettingsCache()
+{
+    flush();
+    waitForDone();
+}
+
+/**
+ * @brief Return the value of a setting, or defaultValue if it isn't set
+ */
+QVariant SettingsCache::value(const QString &key, const QVariant &defaultValue) const
+{
+    auto it = mValues.constFind(key);
+    return it == mValues.constEnd() ? defaultValue : it.value();
+}
+
+/**
+ * @brief Return the keys directly under the given group, relative to it, like QSettings::childKeys
+ * @param group The group, e.g. "graphicalControl/sources"
+ */
+QStringList SettingsCache::childKeys(const QString &group) const
+{
+    QString prefix = group.endsWith('/') ? group : group + '/';
+    QStringList keys;
+
+    for (auto it = mValues.lowerBound(prefix); it != mValues.constEnd() && it.key().startsWith(prefix); ++it) {
+        QString key = it.key().mid(prefix.length());
+        if (!key.contains('/'))
+            keys.push_back(key);
+    }
+
+    return keys;
+}
+
+/**
+ * @brief Change a setting. It is persisted within WRITE_DELAY.
+ */
+void SettingsCache::setValue(const QString &key, const QVariant &value)
+{
+    mValues[key] = value;
+    mPendingValues[key] = value;
+
+    if (!mWriteTimer.isActive())
+        mWriteTimer.start();
+}
+
+/**
+ * @brief Persist pending changes now (on the background thread)
+ */
+void SettingsCache::flush()
+{
+    mWriteTimer.stop();
+
+    if (mPendingValues.isEmpty())
+        return;
+
+    mPool.start(new WriteTask(mFileName, mPendingValues));
+    mPendingValues.clear();
+}
+
+/**
+ * @brief Block until all flushed changes are persisted
+ */
+void SettingsCache::waitForDone()
+{
+    mPool.waitForDone();
+}
@@ -0,0 +1,59 @@
+#ifndef SETTINGSCACHE_H
+#define SETTINGSCACHE_H
+
+#include <QtCore>
+
+/**
+ * @brief In-memory copy of the application settings, with deferred writes
+ *
+ * All settings are read from QSettings once, when the cache is created; after that, reads are served from memory.
+ * Writes update the cache immediately, and are persisted together WRITE_DELAY later, on a background thread, so
+ * that changing settings (or reading them, e.g. when each LabeledValveSwitch loads its label) never stalls the GUI,
+ * even when the settings are stored on a slow network drive. Pending writes are persisted when the cache is destroyed.
+ *
+ * Keys are full paths, e.g. "graphicalControl/sources/Droplet Generator"; there is no equivalent to
+ * QSettings::beginGroup. Values are returned as they were stored or loaded, so the usual QVariant conversions apply
+ * (e.g. value("darkMode", false).toBool()).
+ *
+ * The cache must only be used from the thread it was created in. Settings written by other QSettings instances
+ * after the cache was created are not seen.
+ */
+class SettingsCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    SettingsCache(QString const& fileName = QString(), QObject* parent = nullptr);
+    ~SettingsCache();
+
+    QVariant value(QString const& key, QVariant const& defaultValue = QVariant()) const;
+    bool contains(QString const& key) const { return mValues.contains(key); }
+    QStringList childKeys(QString const& group) const;
+
+    void setValue(QString const& key, QVariant const& value);
+
+    void flush();
+    void waitForDone();
+
+    /// Time between the first unsaved change and the changes being persisted, in ms
+    static const int WRITE_DELAY = 1000;
+
+private:
+    class WriteTask;
+
+    /// Settings file, or empty for the default location of the application's settings
+    QString mFileName;
+
+    /// All settings, by key. Sorted, so that the keys of a group are contiguous.
+    QMap<QString, QVariant> mValues;
+
+    /// Settings changed since the last write
+    QMap<QString, QVariant> mPendingValues;
+
+    QTimer mWriteTimer;
+
+    /// Single-threaded pool, so that writes are applied in order
+    QThreadPool mPool;
+};
+
+#endif // SETTINGSCACHE_H
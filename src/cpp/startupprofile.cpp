@@ -0,0 +1,71 @@
+#include "startupprofile.h"
+#include "logclock.h"
+
+namespace {
+
+QMutex mutex;
+qint64 startTime = 0;
+QVector<StartupProfile::Phase> recordedPhases;
+
+}
+
+/**
+ * @brief Start measuring. Times are relative to this call.
+ */
+void StartupProfile::start()
+{
+    QMutexLocker locker(&mutex);
+    startTime = LogClock::monotonicNanoseconds();
+    recordedPhases.clear();
+}
+
+/**
+ * @brief Record the end of a phase of startup. Only the first occurrence of each phase is recorded.
+ */
+void StartupProfile::mark(const QString &phase)
+{
+    double elapsed;
+    double duration;
+
+    {
+        QMutexLocker locker(&mutex);
+
+        double previous = 0;
+        for (Phase const& p : recordedPhases) {
+            if (p.name == phase)
+                return;
+            if (!p.deferred)
+                previous = p.elapsed;
+        }
+
+        elapsed = (LogClock::monotonicNanoseconds() - startTime) / 1e6;
+        duration = elapsed - previous;
+        recordedPhases.push_back(Phase {phase, elapsed, duration, false});
+    }
+
+    qInfo().nospace() << "Startup: " << phase << " after " << qRound(elapsed) << " ms (+" << qRound(duration) << " ms)";
+}
+
+/**
+ * @brief Record the time taken to load a screen that was not loaded at startup
+ * @param duration In ms
+ */
+void StartupProfile::addDeferredLoad(const QString &screen, double duration)
+{
+    {
+        QMutexLocker locker(&mutex);
+        double elapsed = (LogClock::monotonicNanoseconds() - startTime) / 1e6;
+        recordedPhases.push_back(Phase {screen, elapsed, duration, true});
+    }
+
+    qInfo().nospace() << "Loaded " << screen << " on demand in " << qRound(duration) << " ms";
+}
+
+/**
+ * @brief Return the phases recorded so far, in the order in which they completed
+ */
+QVector<StartupProfile::Phase> StartupProfile::phases()
+{
+    QMutexLocker locker(&mutex);
+    return recordedPhases;
+}
@@ -0,0 +1,38 @@
+#ifndef STARTUPPROFILE_H
+#define STARTUPPROFILE_H
+
+#include <QtCore>
+
+/**
+ * @brief Measures how long the application takes to start
+ *
+ * start() is called first thing in main(); mark() then records the time at which each phase of startup completes
+ * (logger initialized, application controller created, QML loaded, first frame displayed, connected to the device),
+ * and logs it. Screens that are only loaded when first shown report their loading time with addDeferredLoad(), which
+ * shows how much work was taken off startup.
+ *
+ * The results are shown in the diagnostics section of the settings screen (see ApplicationController::startupPhases).
+ * All functions are thread-safe; e.g. the first frame is marked from the render thread.
+ */
+class StartupProfile
+{
+public:
+    struct Phase
+    {
+        QString name;
+        /// Time since start(), in ms
+        double elapsed;
+        /// Time since the previous phase, or time to load a deferred screen, in ms
+        double duration;
+        /// True for screens loaded on demand, after startup
+        bool deferred;
+    };
+
+    static void start();
+    static void mark(QString const& phase);
+    static void addDeferredLoad(QString const& screen, double duration);
+
+    static QVector<Phase> phases();
+};
+
+#endif // STARTUPPROFILE_H
@@ -0,0 +1,353 @@
+#include "structuredlog.h"
+#include "logging.h"
+#include "logclock.h"
+
+#include <cstring>
+#include <limits>
+
+const char StructuredLog::FILE_MAGIC[8] = {'U', 'F', 'C', 'S', 'L', 'O', 'G', '1'};
+
+namespace {
+
+// Typed fields of the event currently being logged by this thread, see StructuredLog::logEvent
+thread_local bool hasPendingEvent = false;
+thread_local LogRecord pendingEvent;
+
+// Offsets of the fields within a record header
+const int OFFSET_SIZE = 0;
+const int OFFSET_LEVEL = 4;
+const int OFFSET_SOURCE = 5;
+const int OFFSET_EVENT = 6;
+const int OFFSET_TIMESTAMP = 8;
+const int OFFSET_NUMBER = 16;
+const int OFFSET_TEXT_SIZE = 20;
+const int OFFSET_VALUE = 24;
+
+LogRecord decode(const uchar* p)
+{
+    LogRecord record;
+    record.level = QtMsgType(p[OFFSET_LEVEL]);
+    record.source = LogRecord::Source(p[OFFSET_SOURCE]);
+    record.event = qFromLittleEndian<quint16>(p + OFFSET_EVENT);
+    record.timestamp = qFromLittleEndian<qint64>(p + OFFSET_TIMESTAMP);
+    record.number = qFromLittleEndian<qint32>(p + OFFSET_NUMBER);
+
+    quint64 value = qFromLittleEndian<quint64>(p + OFFSET_VALUE);
+    memcpy(&record.value, &value, sizeof(double));
+
+    quint32 textSize = qFromLittleEndian<quint32>(p + OFFSET_TEXT_SIZE);
+    record.text = QString::fromUtf8(reinterpret_cast<const char*>(p + StructuredLog::HEADER_SIZE), int(textSize));
+
+    return record;
+}
+
+}
+
+LogRecord::LogRecord()
+    : timestamp(0)
+    , monotonicTime(0)
+    , level(QtInfoMsg)
+    , source(Application)
+    , event(Message)
+    , number(0)
+    , value(0)
+{
+}
+
+/**
+ * @brief Return the binary representation of the record, as written to the binary log
+ */
+QByteArray LogRecord::encode() const
+{
+    QByteArray utf8 = text.toUtf8();
+    QByteArray data(StructuredLog::HEADER_SIZE, '\0');
+    uchar* p = reinterpret_cast<uchar*>(data.data());
+
+    quint64 v;
+    memcpy(&v, &value, sizeof(double));
+
+    qToLittleEndian<quint32>(quint32(StructuredLog::HEADER_SIZE + utf8.size()), p + OFFSET_SIZE);
+    p[OFFSET_LEVEL] = uchar(level);
+    p[OFFSET_SOURCE] = uchar(source);
+    qToLittleEndian<quint16>(event, p + OFFSET_EVENT);
+    qToLittleEndian<qint64>(timestamp, p + OFFSET_TIMESTAMP);
+    qToLittleEndian<qint32>(number, p + OFFSET_NUMBER);
+    qToLittleEndian<quint32>(quint32(utf8.size()), p + OFFSET_TEXT_SIZE);
+    qToLittleEndian<quint64>(v, p + OFFSET_VALUE);
+
+    return data + utf8;
+}
+
+/**
+ * @brief Return the record formatted as a line of the text log, e.g. "2020-01-01 12:00:00.123 Info: Valve 3 opened"
+ */
+QString LogRecord::toText() const
+{
+    QString name = levelName(level);
+
+    QString s;
+    s.reserve(23 + 1 + name.size() + 2 + text.size() + 1);
+    s.append(LogClock::formatDateTime(timestamp));
+    s.append(' ');
+    s.append(name);
+    s.append(": ");
+    s.append(text);
+    s.append('\n');
+    return s;
+}
+
+QString LogRecord::levelName(QtMsgType level)
+{
+    switch (level) {
+    case QtDebugMsg:
+        return "Debug";
+    case QtInfoMsg:
+        return "Info";
+    case QtWarningMsg:
+        return "Warning";
+    case QtCriticalMsg:
+        return "Critical error";
+    case QtFatalMsg:
+        return "Fatal error";
+    }
+    return QString();
+}
+
+/**
+ * @brief Log a message, along with typed fields that are stored in the binary log
+ * @param level Severity of the message
+ * @param source The component the event originates from
+ * @param event The type of event
+ * @param number Event-specific number, e.g. the valve number for ValveChanged
+ * @param value Event-specific value, e.g. 1 or 0 (open or closed) for ValveChanged
+ * @param message The text of the message, as written to the text log
+ */
+void StructuredLog::logEvent(QtMsgType level, LogRecord::Source source, LogRecord::Event event,
+                             qint32 number, double value, const QString &message)
+{
+    QLoggingCategory& cat = category(source);
+
+    // Skip the bookkeeping below if the message would be filtered out anyway
+    if (level != QtFatalMsg && !cat.isEnabled(level))
+        return;
+
+    pendingEvent.source = source;
+    pendingEvent.event = event;
+    pendingEvent.number = number;
+    pendingEvent.value = value;
+    hasPendingEvent = true;
+
+    QMessageLogger logger;
+
+    switch (level) {
+    case QtDebugMsg:
+        logger.debug(cat).noquote() << message;
+        break;
+    case QtInfoMsg:
+        logger.info(cat).noquote() << message;
+        break;
+    case QtWarningMsg:
+        logger.warning(cat).noquote() << message;
+        break;
+    case QtCriticalMsg:
+        logger.critical(cat).noquote() << message;
+        break;
+    case QtFatalMsg:
+        qFatal("%s", message.toLocal8Bit().constData());
+    }
+
+    // In case the message was filtered out before reaching the message handler
+    hasPendingEvent = false;
+}
+
+/**
+ * @brief Retrieve the typed fields of the event being logged by the current thread, if any
+ * @return False if the message being handled wasn't logged with logEvent
+ */
+bool StructuredLog::takePendingEvent(LogRecord &record)
+{
+    if (!hasPendingEvent)
+        return false;
+
+    record.source = pendingEvent.source;
+    record.event = pendingEvent.event;
+    record.number = pendingEvent.number;
+    record.value = pendingEvent.value;
+    hasPendingEvent = false;
+    return true;
+}
+
+/**
+ * @brief Return the logging category that messages from the given source are logged in
+ */
+QLoggingCategory &StructuredLog::category(LogRecord::Source source)
+{
+    switch (source) {
+    case LogRecord::Communicator:
+        return lcCommunicator();
+    case LogRecord::Routine:
+        return lcRoutine();
+    case LogRecord::Microcontroller:
+        return lcMicrocontroller();
+    default:
+        return lcApplication();
+    }
+}
+
+/**
+ * @brief Return the source corresponding to a logging category. Messages logged outside of the "ufcs.*" categories
+ * are attributed to the application.
+ */
+LogRecord::Source StructuredLog::sourceFromCategory(const char *categoryName)
+{
+    if (!categoryName)
+        return LogRecord::Application;
+
+    if (strcmp(categoryName, lcCommunicator().categoryName()) == 0)
+        return LogRecord::Communicator;
+    if (strcmp(categoryName, lcRoutine().categoryName()) == 0)
+        return LogRecord::Routine;
+    if (strcmp(categoryName, lcMicrocontroller().categoryName()) == 0)
+        return LogRecord::Microcontroller;
+    return LogRecord::Application;
+}
+
+StructuredLogReader::Query::Query()
+    : source(-1)
+    , event(-1)
+    , number(-1)
+    , from(std::numeric_limits<qint64>::min())
+    , to(std::numeric_limits<qint64>::max())
+{
+}
+
+StructuredLogReader::StructuredLogReader()
+    : mData(nullptr)
+    , mSize(0)
+{
+}
+
+StructuredLogReader::~StructuredLogReader()
+{
+    close();
+}
+
+/**
+ * @brief Open and memory-map a binary log file
+ * @return False if the file could not be opened, or is not a binary log file
+ */
+bool StructuredLogReader::open(const QString &path)
+{
+    close();
+
+    mFile.setFileName(path);
+    if (!mFile.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open binary log" << path;
+        return false;
+    }
+
+    mSize = mFile.size();
+    if (mSize < qint64(sizeof(StructuredLog::FILE_MAGIC)))
+        mData = nullptr;
+    else
+        mData = mFile.map(0, mSize);
+
+    if (!mData || memcmp(mData, StructuredLog::FILE_MAGIC, sizeof(StructuredLog::FILE_MAGIC)) != 0) {
+        qWarning() << path << "is not a binary log file";
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void StructuredLogReader::close()
+{
+    if (mData)
+        mFile.unmap(const_cast<uchar*>(mData));
+    mData = nullptr;
+    mSize = 0;
+    mFile.close();
+}
+
+/**
+ * @brief Call f with a pointer to each record matching the query, in file order
+ *
+ * Only the headers are decoded to evaluate the query. A record truncated at the end of the file (e.g. if the
+ * application crashed while writing it) ends the iteration.
+ */
+template <typename F>
+void StructuredLogReader::forEachMatch(const Query &query, F f) const
+{
+    if (!mData)
+        return;
+
+    qint64 offset = sizeof(StructuredLog::FILE_MAGIC);
+
+    while (offset + StructuredLog::HEADER_SIZE <= mSize) {
+        const uchar* p = mData + offset;
+        quint32 size = qFromLittleEndian<quint32>(p + OFFSET_SIZE);
+
+        if (size < quint32(StructuredLog::HEADER_SIZE) || offset + size > mSize)
+            break;
+
+        offset += size;
+
+        if (query.source >= 0 && p[OFFSET_SOURCE] != query.source)
+            continue;
+        if (query.event >= 0 && qFromLittleEndian<quint16>(p + OFFSET_EVENT) != query.event)
+            continue;
+        if (query.number >= 0 && qFromLittleEndian<qint32>(p + OFFSET_NUMBER) != query.number)
+            continue;
+
+        qint64 timestamp = qFromLittleEndian<qint64>(p + OFFSET_TIMESTAMP);
+        if (timestamp < query.from || timestamp > query.to)
+            continue;
+
+        f(p);
+    }
+}
+
+/**
+ * @brief Return all records matching the query, in the order they were logged
+ */
+QVector<LogRecord> StructuredLogReader::query(const Query &query) const
+{
+    QVector<LogRecord> records;
+    forEachMatch(query, [&records](const uchar* p) { records << decode(p); });
+    return records;
+}
+
+/**
+ * @brief Return the number of records matching the query
+ */
+int StructuredLogReader::count(const Query &query) const
+{
+    int n = 0;
+    forEachMatch(query, [&n](const uchar*) { n++; });
+    return n;
+}
+
+/**
+ * @brief Write the whole log to a file, in the same format as the text log
+ */
+bool StructuredLogReader::convertToText(const QString &outputPath) const
+{
+    QFile output(outputPath);
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Could not open" << outputPath << "for writing";
+        return false;
+    }
+
+    QByteArray buffer;
+    forEachMatch(Query(), [&](const uchar* p) {
+        buffer += decode(p).toText().toUtf8();
+        if (buffer.size() > (1 << 20)) {
+            output.write(buffer);
+            buffer.clear();
+        }
+    });
+    output.write(buffer);
+
+    return true;
+}
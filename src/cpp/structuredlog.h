@@ -0,0 +1,128 @@
+#ifndef STRUCTUREDLOG_H
+#define STRUCTUREDLOG_H
+
+#include <QtCore>
+
+/**
+ * @brief A single entry of the structured (binary) log
+ *
+ * Besides the message text, records have typed fields that can be queried without parsing text: the source and
+ * type of event (e.g. a valve changing state), a number (e.g. the valve number) and a value (e.g. 1 for open).
+ */
+struct LogRecord
+{
+    enum Source : quint8 {
+        Application,
+        Communicator,
+        Routine,
+        Microcontroller
+    };
+
+    enum Event : quint16 {
+        Message, // plain text message, with no typed fields
+        ValveChanged, // number: valve number, value: 1 if open, 0 if closed
+        PumpChanged, // number: pump number, value: 1 if on, 0 if off
+        PressureSetpointChanged, // number: controller number, value: setpoint in PSI
+        PressureMeasured, // number: controller number, value: measured pressure in PSI
+        RoutineStep // number: step index
+    };
+
+    LogRecord();
+
+    /// Milliseconds since the epoch (UTC)
+    qint64 timestamp;
+    /// Nanoseconds on the monotonic clock (see LogClock), used to order messages. Not stored in the binary log.
+    qint64 monotonicTime;
+    QtMsgType level;
+    Source source;
+    quint16 event;
+    qint32 number;
+    double value;
+    QString text;
+
+    QByteArray encode() const;
+    QString toText() const;
+
+    static QString levelName(QtMsgType level);
+};
+
+/**
+ * @brief Helpers to log structured events
+ *
+ * logEvent() logs the text message in the logging category of its source (see logging.h), so it is handled (and
+ * filtered) like any other message. The typed fields are passed along to Logger::messageHandler, which retrieves them with
+ * takePendingEvent() and writes them to the binary log.
+ *
+ * Binary log files start with FILE_MAGIC, followed by records with a fixed-size, little-endian header:
+ *
+ *     quint32 recordSize, quint8 level, quint8 source, quint16 event, qint64 timestamp,
+ *     qint32 number, quint32 textSize, double value
+ *
+ * followed by textSize bytes of UTF-8 text. recordSize includes the header.
+ */
+class StructuredLog
+{
+public:
+    static void logEvent(QtMsgType level, LogRecord::Source source, LogRecord::Event event,
+                         qint32 number, double value, QString const& message);
+    static bool takePendingEvent(LogRecord& record);
+
+    static QLoggingCategory& category(LogRecord::Source source);
+    static LogRecord::Source sourceFromCategory(const char* categoryName);
+
+    static const char FILE_MAGIC[8];
+    static const int HEADER_SIZE = 32;
+};
+
+/**
+ * @brief Reads binary log files written by the Logger
+ *
+ * The file is memory-mapped, and queries only decode the fixed-size record headers (and the text of matching
+ * records), so they run at close to disk speed even on large files.
+ *
+ * For example, to find all transitions of valve 12:
+ *
+ *     StructuredLogReader reader;
+ *     reader.open(path);
+ *     StructuredLogReader::Query query;
+ *     query.event = LogRecord::ValveChanged;
+ *     query.number = 12;
+ *     QVector<LogRecord> records = reader.query(query);
+ */
+class StructuredLogReader
+{
+public:
+    struct Query
+    {
+        Query();
+
+        /// Fields set to -1 (the default) match any value
+        int source;
+        int event;
+        qint64 number;
+
+        /// Time range (inclusive), in milliseconds since the epoch
+        qint64 from;
+        qint64 to;
+    };
+
+    StructuredLogReader();
+    ~StructuredLogReader();
+
+    bool open(QString const& path);
+    void close();
+
+    QVector<LogRecord> query(Query const& query) const;
+    int count(Query const& query) const;
+    bool convertToText(QString const& outputPath) const;
+
+private:
+    template <typename F>
+    void forEachMatch(Query const& query, F f) const;
+
+    QFile mFile;
+    const uchar* mData;
+    qint64 mSize;
+};
+
+#endif // STRUCTUREDLOG_H
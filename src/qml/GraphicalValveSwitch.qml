@@ -58,10 +58,22 @@ Item {
 
     }
 
+    // Set while the device hasn't confirmed the last change (grey), or if it never did (red)
+    Rectangle {
+        width: 6
+        height: 6
+        radius: 3
+        anchors.top: parent.top
+        anchors.right: parent.right
+        anchors.margins: 3
+        visible: helper.pending || helper.unconfirmed
+        color: helper.unconfirmed ? Material.color(Material.Red) : Material.hintTextColor
+    }
+
     ValveSwitchHelper {
         id: helper
+        deviceState: Backend.deviceState
+        valveNumber: control.valveNumber
         onStateChanged: button.checked = state
     }
-
-    Component.onCompleted: Backend.registerValveSwitchHelper(valveNumber, helper)
 }
@@ -121,15 +121,26 @@ Item {
 
     }
 
+    // Set while the device hasn't confirmed the last change (grey), or if it never did (red)
+    Rectangle {
+        width: 6
+        height: 6
+        radius: 3
+        anchors.top: parent.top
+        anchors.right: parent.right
+        anchors.margins: 10
+        visible: helper.pending || helper.unconfirmed
+        color: helper.unconfirmed ? Material.color(Material.Red) : Material.hintTextColor
+    }
+
     ValveSwitchHelper {
         id: helper
+        deviceState: registerWithBackend ? Backend.deviceState : null
+        valveNumber: control.valveNumber
         onStateChanged: button.checked = state
     }
 
     Component.onCompleted: {
-        if (registerWithBackend)
-            Backend.registerValveSwitchHelper(valveNumber, helper)
-
         control.text = Backend.valveLabel(valveNumber);
     }
 }
@@ -0,0 +1,34 @@
+import QtQuick 2.12
+import QtQuick.Controls 2.12
+
+/*
+  A screen of the main SwipeView that is only loaded the first time it is shown, in the background, rather than
+  when the application starts. The loading time is reported to the backend, and shown in the diagnostics section
+  of the settings screen.
+
+  Set either source or sourceComponent, as with any Loader. Call load() to load the screen before it is shown.
+*/
+
+Loader {
+    // Name shown in the diagnostics
+    property string screenName
+
+    property double loadStartTime: 0
+
+    active: false
+    asynchronous: true
+
+    function load() {
+        if (!active) {
+            loadStartTime = Date.now()
+            active = true
+        }
+    }
+
+    SwipeView.onIsCurrentItemChanged: {
+        if (SwipeView.isCurrentItem)
+            load()
+    }
+
+    onLoaded: Backend.recordScreenLoad(screenName, Date.now() - loadStartTime)
+}
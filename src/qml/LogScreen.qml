@@ -4,7 +4,7 @@ import QtQuick.Layouts 1.12
 
 
 import QtQuick.Controls.Material 2.12
-import org.example.ufcs 1.0 // for the Style singleton
+import org.example.ufcs 1.0 // for the Style singleton and LogModel enums
 
 Item {
 
@@ -14,29 +14,47 @@ Item {
         anchors.leftMargin: Style.view.margin
         anchors.rightMargin: anchors.leftMargin
 
+        // Filtering is done by the model (Backend.logModel), so that only matching messages are instantiated
+        RowLayout {
+            Layout.fillWidth: true
+
+            ComboBox {
+                id: levelFilter
+                model: ["All messages", "Info and above", "Warnings and errors", "Errors only"]
+                currentIndex: Backend.logModel.minimumLevel
+                onActivated: Backend.logModel.minimumLevel = index
+            }
+
+            TextField {
+                id: textFilter
+                Layout.fillWidth: true
+                placeholderText: "Filter messages"
+                selectByMouse: true
+                onTextChanged: Backend.logModel.filterText = text
+            }
+        }
+
         ListView {
             id: logMessageList
             visible: true
-            width: parent.width
-            height: parent.height
-            model: Backend.logMessageList
+            Layout.fillWidth: true
+            Layout.fillHeight: true
+            clip: true
+            model: Backend.logModel
 
             ScrollBar.vertical: ScrollBar {}
 
             delegate: Rectangle {
                 height: messageText.contentHeight
-                width: parent.width
+                width: logMessageList.width
                 color: "transparent"
 
-                // Logs are stored as a list of strings (represented in a QVariant). The elements are:
-                // 0: timestamp
-                // 1: message type ("debug", "warning", ...)
-                // 2: the actual message text
+                // Roles provided by the model:
+                // timestamp, level ("Debug", "Warning", ...) and message (the actual message text)
 
                 function messageTypeColor()
                 {
-                    var text = modelData[1]
-                    switch(text) {
+                    switch(level) {
                         case "Debug":
                             return mainWindow.darkMode ? "#B0BEC5" : "#607D8B" // Material.BlueGrey
                         case "Warning":
@@ -55,21 +73,21 @@ Item {
                         id: timestamp
                         font.pointSize: Style.text.fontSize
                         color: mainWindow.darkMode ? "#EEEEEE" : "#9E9E9E" // Material.Grey
-                        text: modelData[0] + " "
+                        text: model.timestamp + " "
                     }
 
                     Text {
                         id: messageType
                         font.pointSize: Style.text.fontSize
                         font.bold: true
-                        text: modelData[1] + ": "
+                        text: level + ": "
                         color: messageTypeColor()
                     }
 
                     Text {
                         id: messageText
                         font.pointSize: Style.text.fontSize
-                        text: modelData[2]
+                        text: message
                         wrapMode: Text.Wrap
                         width: parent.width - timestamp.width - messageType.width
                         color: Material.foreground
@@ -78,7 +96,13 @@ Item {
                 }
             }
 
-            onCountChanged: positionViewAtEnd()
+            // Once the model is full, the count stays constant: rows are removed at the top as they are
+            // added at the bottom. So the view follows insertions rather than count changes.
+            Connections {
+                target: Backend.logModel
+                onRowsInserted: logMessageList.positionViewAtEnd()
+                onModelReset: logMessageList.positionViewAtEnd()
+            }
         }
     }
 
@@ -111,6 +111,7 @@ Item {
                             controllerNumber: 1
                             minPressure: 0
                             maxPressure: 29.5
+                            showChart: true
                         }
                     }
 
@@ -127,6 +128,7 @@ Item {
                             controllerNumber: 2
                             minPressure: 0
                             maxPressure: 4.8
+                            showChart: true
                         }
                     }
 
@@ -45,19 +45,18 @@ Item {
        are unpressurized, and fluids flow to all 8 outputs at once.
        [000010] would open 2, 4, 6 and 8. And so on.
 
-       In practice, this is represented as a string. While this isn't efficient, it does make for
-       a concise definition. See muxModel below for an example definition. This property should
-       be redefined to match whatever setup your particular chip uses.
+       Multiplexers are defined in C++ (see multiplexer.cpp), where each configuration is compiled to
+       a pair of valve bitmasks. This control only needs the name of the multiplexer; the list of
+       channels is obtained from the backend.
 
-       Likewise, the list of valves should be set based on your setup.
-
-       For each entry in the muxModel list, a button is created with the given label. When clicked,
-       it sets the valves (given in the `valves` property) to the state specified by `config`, where
-       0 is closed and 1 is open.
+       For each channel, a button is created with the given label. When clicked, the backend sets
+       all of the multiplexer's valves at once to the state specified by that channel's configuration.
 
        Only one button can be active at a time.
 
-       These buttons can be clicked by the user, or activated by the routine controller backend.
+       These buttons can be clicked by the user, or activated by the routine controller backend (in
+       which case the backend sets the valves, and this control only needs to update its display by
+       setting currentLabel).
        However, they are not updated if individual valves of the multiplexer are toggled. For example,
        if the multiplexer uses valves 10 through 18, and valve #16 is toggled via the manual control
        screen or elsewhere, then the buttons on this screen will not update.
@@ -68,22 +67,11 @@ Item {
     */
     id: muxControl
 
-    /// The control valves associated with the multiplexer
-    property var valves : [13, 14, 15, 16, 17, 18]
-
-    /// The list of possible states, with a label and configuration
-    property ListModel muxModel: ListModel {
-        ListElement { label: "1"; config: "010101" }
-        ListElement { label: "2"; config: "010110" }
-        ListElement { label: "3"; config: "011001" }
-        ListElement { label: "4"; config: "011010" }
-        ListElement { label: "5"; config: "100101" }
-        ListElement { label: "6"; config: "100110" }
-        ListElement { label: "7"; config: "101001" }
-        ListElement { label: "8"; config: "101010" }
-        ListElement { label: "All"; config: "000000" }
-        ListElement { label: "None"; config: "111111" }
-    }
+    /// The name of the multiplexer, as defined in the backend (e.g. "Co-culture chip v5")
+    property string name
+
+    /// The labels of the multiplexer's channels
+    property var channels: Backend.multiplexerChannels(name)
 
     property int columns: 8
     property bool labeledSwitches: false
@@ -98,23 +86,18 @@ Item {
             checkable: true
             autoExclusive: true
             enabled: Backend.connectionStatus == "Connected"
-            text: label
+            text: modelData
             font.capitalization: Font.MixedCase
-            onClicked: setMuxToConfig(config)
+            onClicked: setMuxToLabel(modelData)
 
             width: muxGridView.cellWidth - 6
             height: muxGridView.cellHeight
 
-            Component.onCompleted: {
-                if (config.length !== valves.length)
-                    console.error("Multiplexer channel configuration for channel '" + label + "' does not match number of valves defined")
-            }
-
             Connections {
                 target: muxControl
                 onCurrentLabelChanged: {
-                    // Slightly hacky way to get the labels to update when setMuxToLabel is called
-                    if (muxControl.currentLabel.toUpperCase() === label.toUpperCase())
+                    // Slightly hacky way to get the labels to update when currentLabel is changed
+                    if (muxControl.currentLabel.toUpperCase() === modelData.toUpperCase())
                         checked = true
                 }
             }
@@ -131,7 +114,7 @@ Item {
         id: muxDelegateLabeled
         LabeledValveSwitch {
             id: lvs
-            valveNumber: parseInt(label)
+            valveNumber: parseInt(modelData)
             width: muxGridView.cellWidth - 6
             height: muxGridView.cellHeight
             editable: editingMode
@@ -144,20 +127,18 @@ Item {
                     closeAllValves()
                 }
                 else {
-                    setMuxToConfig(config)
+                    setMuxToLabel(modelData)
                     labeledButtonGroup.lastButtonChecked = this
                 }
             }
             Component.onCompleted: {
-                if (config.length !== valves.length)
-                    console.error("Multiplexer channel configuration for channel '" + label + "' does not match number of valves defined")
-                if (isNaN(parseInt(label)))
-                    console.error("Label for multiplexer channel '" + label + "' must be an integer")
+                if (isNaN(parseInt(modelData)))
+                    console.error("Label for multiplexer channel '" + modelData + "' must be an integer")
             }
             Connections {
                 target: muxControl
                 onCurrentLabelChanged: {
-                    if (muxControl.currentLabel.toUpperCase() === label.toUpperCase()) {
+                    if (muxControl.currentLabel.toUpperCase() === modelData.toUpperCase()) {
                         setChecked(true)
                         labeledButtonGroup.lastButtonChecked = lvs
                     }
@@ -168,7 +149,7 @@ Item {
 
     GridView {
         id: muxGridView
-        model: muxModel
+        model: channels
         delegate: labeledSwitches ? muxDelegateLabeled : muxDelegate
 
         anchors.fill: parent
@@ -181,35 +162,13 @@ Item {
     }
 
     function closeAllValves() {
-        setMuxToConfig("1".repeat(valves.length))
-    }
-
-    function setMuxToConfig(configuration) {
-        console.log("Setting multiplexer to config: " + configuration)
-        for (var i = 0; i < configuration.length; i++) {
-            Backend.setValve(valves[i], parseInt(configuration[i]))
-        }
+        Backend.setMultiplexer(name, "None")
     }
 
     function setMuxToLabel(label) {
         console.log("Setting multiplexer to label: " + label)
-        var found = false
-        for (var i = 0; i < muxModel.count; i++) {
-            if (muxModel.get(i).label.toUpperCase() === label.toUpperCase()) {
-                currentLabel = label
-                setMuxToConfig(muxModel.get(i).config)
-                found = true
-                break
-            }
-        }
-        if (!found) {
-            if (label.toUpperCase() === "NONE") {
-                console.log("Closing all multiplexer channels")
-                closeAllValves()
-            }
-            else
-                console.warn("No multiplexer channel found with label: " + label)
-        }
+        if (Backend.setMultiplexer(name, label))
+            currentLabel = label
     }
 
 }
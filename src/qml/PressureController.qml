@@ -14,6 +14,8 @@ Item {
     property string unitLabel: "PSI"
     property int sliderHeight: 200
     property bool largeHandle: false
+    property bool showChart: false
+    property int chartWidth: 300
 
     width: grid1.implicitWidth
     height: grid1.implicitHeight
@@ -34,7 +36,7 @@ Item {
             id: slider
             orientation: Qt.Vertical
             live: true
-            stepSize: 1./256.
+            stepSize: 1. / helper.steps
             background.implicitHeight: control.sliderHeight
 
             onMoved: {
@@ -57,6 +59,9 @@ Item {
             text: minPressure + " " + unitLabel
             Layout.maximumWidth: 45
             horizontalAlignment: Text.AlignHCenter
+            // Grey until the device confirms the new setpoint, red if it never did
+            color: helper.unconfirmed ? Material.color(Material.Red)
+                                      : (helper.pending ? Material.hintTextColor : Material.foreground)
             //anchors.horizontalCenter: slider.horizontalCenter
             Layout.alignment: Qt.AlignHCenter
         }
@@ -85,10 +90,45 @@ Item {
             horizontalAlignment: Text.AlignHCenter
             Layout.alignment: Qt.AlignHCenter
         }
+
+        // History of the measured value and setpoint
+        Rectangle {
+            visible: control.showChart
+            Layout.rowSpan: 2
+            Layout.preferredWidth: control.chartWidth
+            Layout.preferredHeight: slider.background.height
+            Layout.alignment: Qt.AlignTop
+            color: "transparent"
+            border.color: Material.frameColor
+            clip: true
+
+            PressureChart {
+                anchors.fill: parent
+                anchors.margins: 1
+                series: Backend.pressureSeries
+                controllerNumber: control.controllerNumber
+                minimum: control.minPressure
+                maximum: control.maxPressure
+                timeWindow: 600
+                measuredColor: Material.accent
+                setpointColor: Material.hintTextColor
+            }
+
+            Label {
+                anchors.left: parent.left
+                anchors.bottom: parent.bottom
+                anchors.margins: 4
+                text: qsTr("Last 10 minutes")
+                font.pointSize: 8
+                color: Material.hintTextColor
+            }
+        }
     }
 
     PCHelper {
         id: helper
+        deviceState: Backend.deviceState
+        controllerNumber: control.controllerNumber
         minPressure: control.minPressure
         maxPressure: control.maxPressure
 
@@ -101,7 +141,4 @@ Item {
             //console.log("Updating measured value to " + measuredValueLabel.text)
         }
     }
-    Component.onCompleted: {
-        Backend.registerPCHelper(controllerNumber, helper)
-    }
 }
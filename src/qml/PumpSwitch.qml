@@ -1,10 +1,12 @@
 import QtQuick 2.12
 import QtQuick.Controls 2.12
 import QtQuick.Layouts 1.12
+import QtQuick.Controls.Material 2.12
 
 import org.example.ufcs 1.0
 
 Item {
+    id: control
     property int pumpNumber
 
     implicitHeight: button.height
@@ -20,11 +22,22 @@ Item {
         }
     }
 
+    // Set while the device hasn't confirmed the last change (grey), or if it never did (red)
+    Rectangle {
+        width: 6
+        height: 6
+        radius: 3
+        anchors.top: parent.top
+        anchors.right: parent.right
+        anchors.margins: 0
+        visible: helper.pending || helper.unconfirmed
+        color: helper.unconfirmed ? Material.color(Material.Red) : Material.hintTextColor
+    }
+
     PumpSwitchHelper {
         id: helper
+        deviceState: Backend.deviceState
+        pumpNumber: control.pumpNumber
         onStateChanged: button.checked = state
     }
-
-    Component.onCompleted: Backend.registerPumpSwitchHelper(pumpNumber, helper)
-
 }
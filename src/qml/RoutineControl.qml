@@ -101,12 +101,12 @@ Item {
                 visible: false
                 anchors.fill: parent
                 anchors.margins: 20
-                model: RoutineController.stepsList
+                model: RoutineController.stepsModel
                 currentIndex: RoutineController.currentStep
 
                 delegate: Text {
                     id: delegateText
-                    text: modelData
+                    text: model.display
 
                     font.pointSize: Style.text.fontSize
                     font.bold: RoutineController.currentStep == index
@@ -201,9 +201,78 @@ Item {
 
 DSM.StateMachine {
     id: stateMachine
-    initialState: noFileLoaded
+    initialState: checkpointFound
     running: true
 
+    DSM.State {
+        // On startup, offer to resume a routine that was interrupted (e.g. by a crash)
+        id: checkpointFound
+        signal noCheckpoint
+
+        onEntered: {
+            console.log("Routine UI: Entered state 'checkpointFound'")
+
+            if (!RoutineController.checkpointAvailable()) {
+                noCheckpoint()
+                return
+            }
+
+            title.text = "Resume interrupted routine?"
+            description.text = RoutineController.checkpointDescription()
+                    + " Valves and pressures will be restored to the state set by the routine before it resumes."
+            yesNoButtons.visible = true
+            yesButton.text = "Resume"
+            yesButton.enabled = Qt.binding(function() { return Backend.connectionStatus == "Connected" })
+            noButton.text = "Discard"
+        }
+
+        onExited: {
+            yesNoButtons.visible = false
+            yesButton.enabled = true
+        }
+
+        DSM.SignalTransition {
+            targetState: noFileLoaded
+            signal: checkpointFound.noCheckpoint
+        }
+
+        DSM.SignalTransition {
+            targetState: resumingRoutine
+            signal: yesButton.clicked
+        }
+
+        DSM.SignalTransition {
+            targetState: noFileLoaded
+            signal: noButton.clicked
+            onTriggered: RoutineController.discardCheckpoint()
+        }
+    }
+
+    DSM.State {
+        id: resumingRoutine
+        signal routineResumed
+        signal resumeFailed
+
+        onEntered: {
+            console.log("Routine UI: Entered state 'resumingRoutine'")
+
+            if (RoutineController.resumeFromCheckpoint())
+                routineResumed()
+            else
+                resumeFailed()
+        }
+
+        DSM.SignalTransition {
+            targetState: runningRoutine
+            signal: resumingRoutine.routineResumed
+        }
+
+        DSM.SignalTransition {
+            targetState: noFileLoaded
+            signal: resumingRoutine.resumeFailed
+        }
+    }
+
     DSM.State {
         id: noFileLoaded
         onEntered: {
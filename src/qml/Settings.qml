@@ -7,6 +7,14 @@ import org.example.ufcs 1.0
 
 Item {
     id: settings
+
+    // Startup times (see StartupProfile), refreshed whenever the screen is shown
+    property var startupPhases: []
+    SwipeView.onIsCurrentItemChanged: {
+        if (SwipeView.isCurrentItem)
+            startupPhases = Backend.startupPhases()
+    }
+
     RowLayout {
         anchors.fill: parent
         anchors.margins: Style.view.margin
@@ -120,6 +128,99 @@ Item {
                 }
             }
 
+            RowLayout {
+                SettingsLabel {
+                    Layout.fillWidth: true
+                    primaryText: "Log screen history"
+                    secondaryText: "Number of recent messages shown in the log screen"
+                }
+
+                ComboBox {
+                    model: [1000, 5000, 20000, 100000]
+                    onActivated: Backend.logCapacity = currentValue
+                    Component.onCompleted: currentIndex = indexOfValue(Backend.logCapacity)
+                }
+            }
+
+            RowLayout {
+                SettingsLabel {
+                    Layout.fillWidth: true
+                    primaryText: "Binary log"
+                    secondaryText: "Also write logs in a structured format, for analysis. Requires restart"
+                }
+
+                Switch {
+                    Layout.alignment: Qt.AlignRight | Qt.AlignVCenter
+                    onCheckedChanged: Backend.binaryLogEnabled = checked
+                    Component.onCompleted: checked = Backend.binaryLogEnabled
+                }
+            }
+
+            RowLayout {
+                SettingsLabel {
+                    Layout.fillWidth: true
+                    primaryText: "Pressure history"
+                    secondaryText: "Record measured pressures, for later analysis. Requires restart"
+                }
+
+                Switch {
+                    Layout.alignment: Qt.AlignRight | Qt.AlignVCenter
+                    onCheckedChanged: Backend.pressureHistoryEnabled = checked
+                    Component.onCompleted: checked = Backend.pressureHistoryEnabled
+                }
+            }
+
+            RowLayout {
+                SettingsLabel {
+                    Layout.fillWidth: true
+                    primaryText: "Export routine runs"
+                    secondaryText: "Save the steps and device state of each run as CSV, in " + Backend.exportDirectory + ". Requires restart"
+                }
+
+                Switch {
+                    Layout.alignment: Qt.AlignRight | Qt.AlignVCenter
+                    onCheckedChanged: Backend.exportEnabled = checked
+                    Component.onCompleted: checked = Backend.exportEnabled
+                }
+            }
+
+            SettingsLabel {
+                Layout.fillWidth: true
+                primaryText: "Device firmware"
+                secondaryText: Backend.firmwareVersion ? Backend.firmwareVersion : "Unknown (not reported by the device)"
+            }
+
+            Label {
+                text: qsTr("Diagnostics")
+                font.pointSize: Style.heading1.fontSize
+                padding: Style.heading1.padding
+                leftPadding: Style.heading1.paddingLeft
+            }
+
+            SettingsLabel {
+                Layout.fillWidth: true
+                primaryText: "Startup time"
+                secondaryText: "Time at which each phase of startup completed. Screens marked \"on demand\" are loaded when first shown, rather than at startup"
+            }
+
+            Repeater {
+                model: settings.startupPhases
+
+                RowLayout {
+                    Label {
+                        Layout.fillWidth: true
+                        text: modelData.name + (modelData.deferred ? " (on demand)" : "")
+                        color: Material.hintTextColor
+                    }
+
+                    Label {
+                        text: modelData.deferred ? Math.round(modelData.duration) + " ms"
+                                                 : Math.round(modelData.elapsed) + " ms (+" + Math.round(modelData.duration) + " ms)"
+                        color: Material.hintTextColor
+                    }
+                }
+            }
+
 
         }
 
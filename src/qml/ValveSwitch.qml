@@ -1,10 +1,12 @@
 import QtQuick 2.12
 import QtQuick.Controls 2.12
 import QtQuick.Layouts 1.12
+import QtQuick.Controls.Material 2.12
 
 import org.example.ufcs 1.0
 
 Item {
+    id: control
     property int valveNumber
 
     implicitHeight: height
@@ -27,11 +29,22 @@ Item {
         }
     }
 
+    // Set while the device hasn't confirmed the last change (grey), or if it never did (red)
+    Rectangle {
+        width: 6
+        height: 6
+        radius: 3
+        anchors.top: parent.top
+        anchors.right: parent.right
+        anchors.margins: 10
+        visible: helper.pending || helper.unconfirmed
+        color: helper.unconfirmed ? Material.color(Material.Red) : Material.hintTextColor
+    }
+
     ValveSwitchHelper {
         id: helper
+        deviceState: Backend.deviceState
+        valveNumber: control.valveNumber
         onStateChanged: button.checked = state
     }
-
-    Component.onCompleted: Backend.registerValveSwitchHelper(valveNumber, helper)
-
 }
@@ -28,8 +28,12 @@ ApplicationWindow {
             id: manualControlView
         }
 
-        RoutineControl {
+        // Screens other than manual control, logs and settings are loaded when they are first shown.
+        // The routine screen is loaded at startup if there is a routine to resume, to offer resuming it right away.
+        LazyScreen {
             id: routineControlView
+            screenName: "Routine screen"
+            source: "RoutineControl.qml"
         }
 
         LogScreen {
@@ -71,12 +75,18 @@ ApplicationWindow {
 
     Component {
         id: gcLoaderComponent
-        Loader { source: Backend.currentGraphicalControlScreenURL() }
+        LazyScreen {
+            screenName: "Graphical control screen"
+            source: Backend.currentGraphicalControlScreenURL()
+        }
     }
 
     Component.onCompleted: {
         console.info("Application version: " + Backend.appVersion)
 
+        if (RoutineController.checkpointAvailable())
+            routineControlView.load()
+
         if (Backend.graphicalControlEnabled) {
             swipeView.insertItem(1, gcLoaderComponent.createObject(swipeView));
             tabBar.insertItem(1, graphicalControlTab.createObject(tabBar))
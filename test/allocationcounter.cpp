@@ -0,0 +1,55 @@
+#include "allocationcounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<quint64> gAllocations(0);
+std::atomic<quint64> gDeallocations(0);
+
+}
+
+quint64 AllocationCounter::allocations()
+{
+    return gAllocations.load(std::memory_order_relaxed);
+}
+
+qint64 AllocationCounter::liveAllocations()
+{
+    // Deallocations are read first, so that the result is never negative
+    quint64 deallocations = gDeallocations.load(std::memory_order_relaxed);
+    return qint64(gAllocations.load(std::memory_order_relaxed) - deallocations);
+}
+
+// The nothrow versions of operator new call these by default, and the sized versions of delete call the unsized ones
+
+void* operator new(std::size_t size)
+{
+    void* p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    if (!p)
+        return;
+
+    gDeallocations.fetch_add(1, std::memory_order_relaxed);
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    operator delete(p);
+}
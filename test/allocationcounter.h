@@ -0,0 +1,22 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+/**
+ * @brief Counts heap allocations made with operator new, for the soak test
+ *
+ * allocationcounter.cpp replaces the global operator new and delete, so it must only be linked into the soak test.
+ * Qt containers (QString, QByteArray, QVector...) allocate with malloc, so they are not counted here; their growth
+ * shows in the resident set size instead (see SoakTest).
+ */
+namespace AllocationCounter
+{
+    /// Number of allocations made so far
+    quint64 allocations();
+
+    /// Number of allocations not freed yet
+    qint64 liveAllocations();
+}
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,27 @@
+#include "benchroutines.h"
+#include "benchcommunicator.h"
+#include "benchroutineparsing.h"
+
+int main(int argc, char** argv)
+{
+   // The benchmarks need an event loop, since commands go through queued connections
+   QCoreApplication app(argc, argv);
+
+   QStandardPaths::setTestModeEnabled(true);
+
+   int status = 0;
+   {
+      BenchRoutines tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+   {
+      BenchCommunicator tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+   {
+      BenchRoutineParsing tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+
+   return status;
+}
@@ -0,0 +1,56 @@
+#include "benchcommunicator.h"
+#include "mockapplicationcontroller.h"
+#include "logger.h"
+
+void BenchCommunicator::initTestCase()
+{
+    // The logger's constructor sets the default filter rules, so it must be created before the rows set their own,
+    // and outside of the timed loop
+    Logger::logger();
+
+    mController = createSimulatedController(mCommunicator);
+}
+
+void BenchCommunicator::cleanupTestCase()
+{
+    QLoggingCategory::setFilterRules(QString());
+    Logger::logger()->shutdown();
+    delete mController;
+}
+
+void BenchCommunicator::setValveThroughput_data()
+{
+    QTest::addColumn<QString>("filterRules");
+
+    QTest::newRow("debug disabled") << "ufcs.communicator.debug=false";
+    QTest::newRow("debug enabled") << "ufcs.communicator.debug=true";
+}
+
+void BenchCommunicator::setValveThroughput()
+{
+    QFETCH(QString, filterRules);
+
+    const int n = 20000;
+
+    QLoggingCategory::setFilterRules(filterRules);
+    QtMessageHandler previousHandler = qInstallMessageHandler(Logger::messageHandler);
+
+    int messagesBefore = mCommunicator->messagesSent();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int i(0); i < n; ++i)
+        mCommunicator->setValve(uint(i % N_VALVES) + 1, i % 2);
+
+    qint64 elapsed = timer.nsecsElapsed();
+
+    qInstallMessageHandler(previousHandler);
+    QLoggingCategory::setFilterRules(QString());
+
+    QCOMPARE(mCommunicator->messagesSent() - messagesBefore, n);
+
+    qInfo().noquote() << QString("setValve throughput: %1 calls/s (%2 us per call)")
+                         .arg(qRound64(n / (elapsed / 1e9)))
+                         .arg(elapsed / 1000. / n, 0, 'f', 2);
+}
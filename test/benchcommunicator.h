@@ -0,0 +1,37 @@
+#ifndef BENCHCOMMUNICATOR_H
+#define BENCHCOMMUNICATOR_H
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include "applicationcontroller.h"
+
+class SimulatedCommunicator;
+
+/**
+ * @brief Timing benchmarks for Communicator
+ *
+ * Commands are sent to a SimulatedCommunicator (with echo disabled, so that only the cost of building and logging the
+ * command is measured), with the application's message handler installed.
+ *
+ * The following are reported:
+ *  - setValve throughput: how many setValve calls are made per second, with debug logging of the
+ *    "ufcs.communicator" category enabled and disabled
+ */
+class BenchCommunicator : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void setValveThroughput_data();
+    void setValveThroughput();
+
+private:
+    ApplicationController* mController;
+    SimulatedCommunicator* mCommunicator;
+};
+
+#endif
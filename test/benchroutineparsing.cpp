@@ -0,0 +1,121 @@
+#include "benchroutineparsing.h"
+#include "mockapplicationcontroller.h"
+#include "processmemory.h"
+
+void BenchRoutineParsing::initTestCase()
+{
+    QVERIFY(mTempDir.isValid());
+    mController = new MockApplicationController();
+}
+
+void BenchRoutineParsing::cleanupTestCase()
+{
+    delete mController;
+}
+
+void BenchRoutineParsing::loadAndVerify_data()
+{
+    QTest::addColumn<int>("lineCount");
+
+    QTest::newRow("10k lines") << 10000;
+    QTest::newRow("100k lines") << 100000;
+    QTest::newRow("1M lines") << 1000000;
+    if (qEnvironmentVariableIsSet("UFCS_BENCH_HUGE_ROUTINES"))
+        QTest::newRow("10M lines") << 10000000;
+}
+
+void BenchRoutineParsing::loadAndVerify()
+{
+    QFETCH(int, lineCount);
+
+    QString url = generateRoutine(lineCount);
+
+    {
+        // A new controller for each size, so that memory held by the previous routine doesn't count
+        RoutineController r(mController);
+
+        bool peakReset = ProcessMemory::resetPeak();
+        qint64 memoryBefore = ProcessMemory::residentSetSize();
+
+        QElapsedTimer timer;
+        timer.start();
+
+        QVERIFY(r.loadFile(url));
+        qint64 loadTime = timer.nsecsElapsed();
+
+        int errors = r.verify();
+        qint64 verifyTime = timer.nsecsElapsed() - loadTime;
+
+        qint64 memoryAfter = peakReset ? ProcessMemory::peakResidentSetSize() : ProcessMemory::residentSetSize();
+
+        QCOMPARE(errors, 0);
+        QVERIFY(r.numberOfSteps() > 0);
+
+        QString memory = memoryBefore < 0 || memoryAfter < 0
+                ? QString("n/a")
+                : QString("%1 MB").arg((memoryAfter - memoryBefore) / 1048576., 0, 'f', 1);
+
+        qInfo().noquote() << QString("Routine of %1: load %2 ms (%3 lines/s), verify %4 ms (%5 lines/s), "
+                                     "%6 memory %7")
+                             .arg(QTest::currentDataTag())
+                             .arg(loadTime / 1e6, 0, 'f', 1)
+                             .arg(qRound64(lineCount / (loadTime / 1e9)))
+                             .arg(verifyTime / 1e6, 0, 'f', 1)
+                             .arg(qRound64(lineCount / (verifyTime / 1e9)))
+                             .arg(peakReset ? "peak" : "added")
+                             .arg(memory);
+    }
+
+    QFile::remove(QUrl(url).toLocalFile());
+}
+
+/**
+ * @brief Write a routine of the given number of lines to a temporary file
+ * @return The URL of the file, to be passed to RoutineController::loadFile
+ *
+ * The same routine is generated for a given number of lines, so that results can be compared between runs.
+ */
+QString BenchRoutineParsing::generateRoutine(int lineCount)
+{
+    QString path = mTempDir.filePath(QString("generated_%1.txt").arg(lineCount));
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return QString();
+
+    QRandomGenerator random(lineCount);
+    QByteArray buffer;
+
+    for (int i(0); i < lineCount; ++i) {
+        int kind = random.bounded(100);
+
+        if (kind < 50)
+            buffer.append(QString("valve %1 %2\n").arg(random.bounded(1, 33)).arg(random.bounded(2) ? "open" : "close")
+                          .toUtf8());
+        else if (kind < 70)
+            buffer.append(QString("wait %1 %2\n").arg(random.bounded(1, 500)).arg(random.bounded(2) ? "ms" : "seconds")
+                          .toUtf8());
+        else if (kind < 85)
+            buffer.append(QString("pressure %1 %2\n").arg(random.bounded(1, 3)).arg(random.bounded(300) / 10.)
+                          .toUtf8());
+        else if (kind < 88)
+            buffer.append(QString("wait until pressure %1 >= %2 timeout 30 s\n").arg(random.bounded(1, 3))
+                          .arg(random.bounded(300) / 10.).toUtf8());
+        else if (kind < 90)
+            buffer.append(random.bounded(2) ? "valve all open\n" : "valve all close\n");
+        else if (kind < 95)
+            buffer.append("# Step " + QByteArray::number(i) + ": generated comment\n");
+        else
+            buffer.append('\n');
+
+        if (buffer.size() > (1 << 20)) {
+            file.write(buffer);
+            buffer.clear();
+        }
+    }
+
+    file.write(buffer);
+    file.close();
+
+    return QUrl::fromLocalFile(path).toString();
+}
@@ -0,0 +1,40 @@
+#ifndef BENCHROUTINEPARSING_H
+#define BENCHROUTINEPARSING_H
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include "routinecontroller.h"
+#include "applicationcontroller.h"
+
+/**
+ * @brief Benchmarks of loading and verifying large routines, such as those generated by scripts
+ *
+ * Routines of 10k, 100k and 1M lines are generated with a realistic mix of commands (mostly valve steps, then waits
+ * and setpoints, a few `wait until` and `valve all` steps, comments and blank lines). Routines of 10M lines (about
+ * 150 MB) are also generated if UFCS_BENCH_HUGE_ROUTINES is set.
+ *
+ * The following are reported for each size:
+ *  - load time (RoutineController::loadFile) and verification time (RoutineController::verify), and lines per second
+ *  - peak memory: increase of the peak resident set size over load and verification, i.e. the memory needed to
+ *    hold and check the routine (Linux only; elsewhere, the increase of the resident set size is reported)
+ */
+class BenchRoutineParsing : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void loadAndVerify_data();
+    void loadAndVerify();
+
+private:
+    QString generateRoutine(int lineCount);
+
+    QTemporaryDir mTempDir;
+    ApplicationController* mController;
+};
+
+#endif // BENCHROUTINEPARSING_H
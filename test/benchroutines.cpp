@@ -0,0 +1,228 @@
+#include "benchroutines.h"
+#include "simulatedcommunicator.h"
+
+#include <algorithm>
+#include <atomic>
+
+void BenchRoutines::initTestCase()
+{
+    QVERIFY(mTempDir.isValid());
+
+    mController = createSimulatedController(mCommunicator);
+
+    r = mController->routineController();
+
+    mClock.start();
+
+    // Both of these are direct connections: step times are recorded in the routine thread,
+    // and message times in the GUI thread (where ApplicationController calls the communicator).
+    connect(r, &RoutineController::currentStepChanged, [this](int) {
+        mStepTimes.push_back(mClock.nsecsElapsed());
+    });
+    connect(mCommunicator, &SimulatedCommunicator::messageSent, [this](QByteArray) {
+        mMessageTimes.push_back(mClock.nsecsElapsed());
+    });
+
+    // Simulated GUI load: the GUI thread is kept busy for a part of every frame
+    mGuiLoadBusyMs = 0;
+    mGuiLoadTimer.setInterval(16);
+    connect(&mGuiLoadTimer, &QTimer::timeout, [this]() {
+        QElapsedTimer busy;
+        busy.start();
+        while (busy.elapsed() < mGuiLoadBusyMs) {}
+    });
+}
+
+void BenchRoutines::cleanupTestCase()
+{
+    delete mController;
+}
+
+void BenchRoutines::dispatchLatency_data()
+{
+    QTest::addColumn<int>("guiLoadMs");
+
+    QTest::newRow("idle") << 0;
+    QTest::newRow("gui load") << 8;
+}
+
+void BenchRoutines::dispatchLatency()
+{
+    // Valve steps, separated by short waits so that each command is dispatched on its own
+    // rather than queuing up behind the previous one.
+
+    QFETCH(int, guiLoadMs);
+
+    const int n = 200;
+    QStringList lines;
+    for (int i(0); i < n; ++i) {
+        lines << QString("valve %1 %2").arg(i % 32 + 1).arg(i % 2 ? "close" : "open");
+        lines << "wait 5 ms";
+    }
+
+    QString url = createRoutineFile("dispatch", lines);
+
+    startGuiLoad(guiLoadMs);
+    runRoutine(url);
+    QTRY_COMPARE(mMessageTimes.size(), n);
+    stopGuiLoad();
+
+    QCOMPARE(mStepTimes.size(), 2*n);
+
+    QVector<qint64> latencies;
+    for (int i(0); i < n; ++i)
+        latencies << mMessageTimes[i] - mStepTimes[2*i];
+
+    report(QString("Dispatch latency, %1").arg(QTest::currentDataTag()), latencies);
+}
+
+void BenchRoutines::waitOvershoot_data()
+{
+    QTest::addColumn<int>("waitMs");
+    QTest::addColumn<int>("guiLoadMs");
+
+    QTest::newRow("1 ms, idle") << 1 << 0;
+    QTest::newRow("10 ms, idle") << 10 << 0;
+    QTest::newRow("100 ms, idle") << 100 << 0;
+    QTest::newRow("10 ms, gui load") << 10 << 8;
+}
+
+void BenchRoutines::waitOvershoot()
+{
+    QFETCH(int, waitMs);
+    QFETCH(int, guiLoadMs);
+
+    // Roughly one second of waiting in total
+    const int n = qMax(10, 1000 / waitMs);
+    QStringList lines;
+    for (int i(0); i < n; ++i)
+        lines << QString("wait %1 ms").arg(waitMs);
+
+    QString url = createRoutineFile("wait", lines);
+
+    startGuiLoad(guiLoadMs);
+    qint64 finishTime = runRoutine(url);
+    stopGuiLoad();
+
+    QCOMPARE(mStepTimes.size(), n);
+
+    QVector<qint64> overshoots;
+    for (int i(0); i < n; ++i) {
+        qint64 end = (i + 1 < n ? mStepTimes[i+1] : finishTime);
+        overshoots << end - mStepTimes[i] - qint64(waitMs) * 1000000;
+    }
+
+    report(QString("Wait overshoot, %1").arg(QTest::currentDataTag()), overshoots);
+}
+
+void BenchRoutines::stepThroughput_data()
+{
+    QTest::addColumn<int>("guiLoadMs");
+
+    QTest::newRow("idle") << 0;
+    QTest::newRow("gui load") << 8;
+}
+
+void BenchRoutines::stepThroughput()
+{
+    QFETCH(int, guiLoadMs);
+
+    const int n = 5000;
+    QStringList lines;
+    for (int i(0); i < n; ++i)
+        lines << QString("valve %1 %2").arg(i % 32 + 1).arg(i % 2 ? "close" : "open");
+
+    QString url = createRoutineFile("throughput", lines);
+
+    startGuiLoad(guiLoadMs);
+    qint64 finishTime = runRoutine(url);
+    QTRY_COMPARE_WITH_TIMEOUT(mMessageTimes.size(), n, 30000);
+    stopGuiLoad();
+
+    QCOMPARE(mStepTimes.size(), n);
+
+    double executionTime = (finishTime - mStepTimes.first()) / 1e9;
+    double endToEndTime = (mMessageTimes.last() - mStepTimes.first()) / 1e9;
+
+    qInfo().noquote() << QString("Step throughput, %1: %2 steps/s executed, %3 steps/s delivered to the communicator")
+                         .arg(QTest::currentDataTag())
+                         .arg(n / executionTime, 0, 'f', 0)
+                         .arg(n / endToEndTime, 0, 'f', 0);
+}
+
+/**
+ * @brief Write a routine to a temporary file
+ * @return The URL of the file, to be passed to RoutineController::loadFile
+ */
+QString BenchRoutines::createRoutineFile(const QString &name, const QStringList &lines)
+{
+    QString path = mTempDir.filePath(name + ".txt");
+
+    QFile file(path);
+    file.open(QIODevice::WriteOnly | QIODevice::Text);
+    file.write(lines.join('\n').toUtf8());
+    file.close();
+
+    return QUrl::fromLocalFile(path).toString();
+}
+
+/**
+ * @brief Load and run a routine, processing GUI events until it is finished
+ * @return The time (on mClock, in nanoseconds) at which the routine finished
+ */
+qint64 BenchRoutines::runRoutine(const QString &fileUrl)
+{
+    mStepTimes.clear();
+    mMessageTimes.clear();
+
+    std::atomic<qint64> finishTime(-1);
+    QMetaObject::Connection connection = connect(r, &RoutineController::finished, [this, &finishTime]() {
+        finishTime = mClock.nsecsElapsed();
+    });
+
+    r->loadFile(fileUrl);
+    r->begin();
+
+    while (finishTime < 0)
+        QTest::qWait(1);
+
+    disconnect(connection);
+    return finishTime;
+}
+
+void BenchRoutines::startGuiLoad(int busyMs)
+{
+    mGuiLoadBusyMs = busyMs;
+    if (busyMs > 0)
+        mGuiLoadTimer.start();
+}
+
+void BenchRoutines::stopGuiLoad()
+{
+    mGuiLoadTimer.stop();
+}
+
+/**
+ * @brief Print the distribution of a set of durations (given in nanoseconds)
+ */
+void BenchRoutines::report(const QString &title, QVector<qint64> samples)
+{
+    if (samples.isEmpty())
+        return;
+
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&samples](double p) {
+        int index = qMin(samples.size() - 1, int(p * samples.size()));
+        return QString::number(samples[index] / 1000., 'f', 1);
+    };
+
+    qInfo().noquote() << QString("%1 (us): n=%2, min %3, median %4, p90 %5, p99 %6, max %7")
+                         .arg(title)
+                         .arg(samples.size())
+                         .arg(percentile(0))
+                         .arg(percentile(0.5))
+                         .arg(percentile(0.9))
+                         .arg(percentile(0.99))
+                         .arg(percentile(1));
+}
@@ -0,0 +1,60 @@
+#ifndef BENCHROUTINES_H
+#define BENCHROUTINES_H
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include "routinecontroller.h"
+#include "mockapplicationcontroller.h"
+
+/**
+ * @brief Timing benchmarks for RoutineController
+ *
+ * Synthetic routines are run against a SimulatedCommunicator, going through the same path as in the
+ * application: RoutineController (worker thread) -> ApplicationController (GUI thread) -> Communicator.
+ *
+ * The following are reported, both with an idle GUI thread and with a GUI thread that is kept busy
+ * (to simulate rendering):
+ *  - dispatch latency: time between a step starting and its command reaching the communicator
+ *  - wait overshoot: how much longer than requested `wait` steps actually take
+ *  - throughput: how many back-to-back valve steps are executed per second
+ */
+class BenchRoutines : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void dispatchLatency_data();
+    void dispatchLatency();
+    void waitOvershoot_data();
+    void waitOvershoot();
+    void stepThroughput_data();
+    void stepThroughput();
+
+private:
+    QString createRoutineFile(QString const& name, QStringList const& lines);
+    qint64 runRoutine(QString const& fileUrl);
+    void startGuiLoad(int busyMs);
+    void stopGuiLoad();
+    static void report(QString const& title, QVector<qint64> samples);
+
+    QTemporaryDir mTempDir;
+    QElapsedTimer mClock;
+    QTimer mGuiLoadTimer;
+    int mGuiLoadBusyMs;
+
+    ApplicationController* mController;
+    SimulatedCommunicator* mCommunicator;
+    RoutineController* r;
+
+    /// Time at which each step started (written by the routine thread)
+    QVector<qint64> mStepTimes;
+
+    /// Time at which each message reached the communicator (written by the GUI thread)
+    QVector<qint64> mMessageTimes;
+};
+
+#endif
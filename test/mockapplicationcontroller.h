@@ -0,0 +1,40 @@
+#ifndef MOCKAPPLICATIONCONTROLLER_H
+#define MOCKAPPLICATIONCONTROLLER_H
+
+#include "applicationcontroller.h"
+#include "simulatedcommunicator.h"
+
+/**
+ * @brief ApplicationController of a fixed device: 32 valves, 2 pumps and 2 pressure controllers (0 to 30 PSI)
+ *
+ * Shared by the unit tests, benchmarks and soak test.
+ */
+class MockApplicationController : public ApplicationController
+{
+    // To do: use a mocking library instead of this
+public:
+    MockApplicationController() {}
+    int nValves() { return 32; }
+    int nPumps() { return 2; }
+    int nPressureControllers() { return 2; }
+    double minPressure(int controllerNumber) { Q_UNUSED(controllerNumber); return 0;}
+    double maxPressure(int controllerNumber) { Q_UNUSED(controllerNumber); return 30;}
+};
+
+/**
+ * @brief Create a MockApplicationController connected to a simulated device
+ * @param communicator Set to the simulated communicator, which is owned by the controller
+ * @param echoEnabled Whether the simulated device replies to commands (see SimulatedCommunicator)
+ */
+inline MockApplicationController* createSimulatedController(SimulatedCommunicator*& communicator,
+                                                             bool echoEnabled = false)
+{
+    MockApplicationController* controller = new MockApplicationController();
+    communicator = new SimulatedCommunicator(controller);
+    communicator->setEchoEnabled(echoEnabled);
+    controller->setCommunicator(communicator);
+    communicator->connect();
+    return controller;
+}
+
+#endif // MOCKAPPLICATIONCONTROLLER_H
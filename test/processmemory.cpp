@@ -0,0 +1,81 @@
+#include "processmemory.h"
+
+#include <QtCore>
+
+#if defined(Q_OS_LINUX)
+#include <unistd.h>
+#elif defined(Q_OS_MACOS)
+#include <mach/mach.h>
+#endif
+
+namespace {
+
+#if defined(Q_OS_LINUX)
+/**
+ * @brief Return a size given in kB in /proc/self/status, e.g. "VmHWM", in bytes
+ */
+qint64 statusField(QByteArray const& name)
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text))
+        return -1;
+
+    // /proc files report a size of 0, so they are read line by line rather than with readAll()
+    QByteArray prefix = name + ':';
+    while (!status.atEnd()) {
+        QByteArray line = status.readLine();
+        if (line.startsWith(prefix))
+            return line.mid(prefix.size()).simplified().split(' ').value(0).toLongLong() * 1024;
+    }
+    return -1;
+}
+#endif
+
+}
+
+qint64 ProcessMemory::residentSetSize()
+{
+#if defined(Q_OS_LINUX)
+    return statusField("VmRSS");
+#elif defined(Q_OS_MACOS)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, task_info_t(&info), &count) != KERN_SUCCESS)
+        return -1;
+    return qint64(info.resident_size);
+#else
+    return -1;
+#endif
+}
+
+/**
+ * @brief Return the highest resident set size since the process started, or since the last call to resetPeak()
+ */
+qint64 ProcessMemory::peakResidentSetSize()
+{
+#if defined(Q_OS_LINUX)
+    return statusField("VmHWM");
+#elif defined(Q_OS_MACOS)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, task_info_t(&info), &count) != KERN_SUCCESS)
+        return -1;
+    return qint64(info.resident_size_max);
+#else
+    return -1;
+#endif
+}
+
+/**
+ * @brief Reset the peak resident set size to the current one
+ * @return False if this isn't supported (the peak then covers the whole life of the process)
+ */
+bool ProcessMemory::resetPeak()
+{
+#if defined(Q_OS_LINUX)
+    QFile clearRefs("/proc/self/clear_refs");
+    return clearRefs.open(QIODevice::WriteOnly) && clearRefs.write("5") == 1;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,19 @@
+#ifndef PROCESSMEMORY_H
+#define PROCESSMEMORY_H
+
+#include <QtGlobal>
+
+/**
+ * @brief Memory use of the current process, for the soak test and benchmarks
+ *
+ * Sizes are in bytes, or -1 if they can't be measured on this platform. The resident set size is available on Linux
+ * and macOS; its peak can only be reset on Linux.
+ */
+namespace ProcessMemory
+{
+    qint64 residentSetSize();
+    qint64 peakResidentSetSize();
+    bool resetPeak();
+}
+
+#endif // PROCESSMEMORY_H
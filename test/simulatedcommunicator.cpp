@@ -0,0 +1,68 @@
+#include "simulatedcommunicator.h"
+
+SimulatedCommunicator::SimulatedCommunicator(ApplicationController *applicationController)
+    : Communicator(applicationController)
+    , mEchoEnabled(false)
+    , mMessagesSent(0)
+{
+}
+
+/**
+ * @brief "Connect" to the simulated device. This succeeds immediately.
+ */
+void SimulatedCommunicator::connect()
+{
+    setConnectionStatus(Connected);
+}
+
+void SimulatedCommunicator::sendMessage(QByteArray message)
+{
+    mMessagesSent++;
+    emit messageSent(message);
+
+    if (!mEchoEnabled)
+        return;
+
+    mBuffer.append(message);
+
+    while (mBuffer.size() > 0) {
+        QByteArray b = decodeBuffer();
+        if (b.length() > 0)
+            reply(b);
+    }
+}
+
+/**
+ * @brief Handle a (decoded) message as if the device had sent it
+ */
+void SimulatedCommunicator::receive(const QByteArray &decodedMessage)
+{
+    parseDecodedBuffer(decodedMessage);
+}
+
+/**
+ * @brief Answer a (decoded) message the way the microcontroller would
+ */
+void SimulatedCommunicator::reply(const QByteArray &decodedMessage)
+{
+    uint8_t command = decodedMessage[0];
+
+    switch (command) {
+        case VALVE:
+        case PUMP:
+            parseDecodedBuffer(decodedMessage);
+            break;
+
+        case PRESSURE: {
+            // Host sends number and setpoint; the device answers with number, setpoint and measured value (the
+            // setpoint parameter, size included, is repeated)
+            QByteArray answer = decodedMessage;
+            answer.append(decodedMessage.mid(3));
+            parseDecodedBuffer(answer);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef SIMULATEDCOMMUNICATOR_H
+#define SIMULATEDCOMMUNICATOR_H
+
+#include "communicator.h"
+
+/**
+ * @brief A Communicator that talks to a simulated microcontroller instead of real hardware.
+ *
+ * Messages passed to sendMessage are decoded just like incoming data would be. If echo is enabled,
+ * the simulated device then replies the way the ESP32 does: VALVE and PUMP commands are echoed back,
+ * and PRESSURE commands are answered with the new setpoint and a measured value equal to it.
+ * With echo disabled, this is a null communicator: messages are simply counted and discarded.
+ *
+ * The messageSent signal is emitted for every message that is sent, which is used by benchmarks
+ * to time the arrival of commands. Messages that the device sends on its own (e.g. telemetry) can be
+ * simulated with receive().
+ */
+class SimulatedCommunicator : public Communicator
+{
+    Q_OBJECT
+
+public:
+    SimulatedCommunicator(ApplicationController* applicationController);
+
+    void connect();
+
+    void setEchoEnabled(bool enabled) { mEchoEnabled = enabled; }
+    int messagesSent() const { return mMessagesSent; }
+
+    void receive(QByteArray const& decodedMessage);
+
+signals:
+    void messageSent(QByteArray message);
+
+protected:
+    void sendMessage(QByteArray message);
+
+private:
+    void reply(QByteArray const& decodedMessage);
+
+    bool mEchoEnabled;
+    int mMessagesSent;
+};
+
+#endif // SIMULATEDCOMMUNICATOR_H
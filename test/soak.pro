@@ -0,0 +1,72 @@
+# Soak test: long-running test of the whole stack, checking for memory and queue growth (see SoakTest).
+# Not part of unittests.pro, as it replaces the global operator new.
+
+QT += qml quick core serialport testlib bluetooth
+
+HEADERS += \
+    mockapplicationcontroller.h \
+    simulatedcommunicator.h \
+    ../src/cpp/bluetoothcommunicator.h \
+    ../src/cpp/serialcommunicator.h \
+    ../src/cpp/communicator.h \
+    ../src/cpp/constants.h \
+    ../src/cpp/applicationcontroller.h \
+    ../src/cpp/guihelper.h \
+    ../src/cpp/routinecontroller.h \
+    ../src/cpp/multiplexer.h \
+    ../src/cpp/logging.h \
+    ../src/cpp/logclock.h \
+    ../src/cpp/logger.h \
+    ../src/cpp/logwriter.h \
+    ../src/cpp/logarchiver.h \
+    ../src/cpp/logmodel.h \
+    ../src/cpp/structuredlog.h \
+    ../src/cpp/routinecheckpoint.h \
+    ../src/cpp/routinesource.h \
+    ../src/cpp/routinestepsmodel.h \
+    ../src/cpp/pressurerecorder.h \
+    ../src/cpp/pressuretimeseries.h \
+    ../src/cpp/experimentexporter.h \
+    ../src/cpp/devicestate.h \
+    ../src/cpp/settingscache.h \
+    ../src/cpp/startupprofile.h \
+    allocationcounter.h \
+    processmemory.h \
+    soaktest.h
+
+SOURCES += \
+    soak_main.cpp \
+    simulatedcommunicator.cpp \
+    ../src/cpp/bluetoothcommunicator.cpp \
+    ../src/cpp/serialcommunicator.cpp \
+    ../src/cpp/communicator.cpp \
+    ../src/cpp/applicationcontroller.cpp \
+    ../src/cpp/guihelper.cpp \
+    ../src/cpp/routinecontroller.cpp \
+    ../src/cpp/multiplexer.cpp \
+    ../src/cpp/logging.cpp \
+    ../src/cpp/logclock.cpp \
+    ../src/cpp/logger.cpp \
+    ../src/cpp/logwriter.cpp \
+    ../src/cpp/logarchiver.cpp \
+    ../src/cpp/logmodel.cpp \
+    ../src/cpp/structuredlog.cpp \
+    ../src/cpp/routinecheckpoint.cpp \
+    ../src/cpp/routinesource.cpp \
+    ../src/cpp/routinestepsmodel.cpp \
+    ../src/cpp/pressurerecorder.cpp \
+    ../src/cpp/pressuretimeseries.cpp \
+    ../src/cpp/experimentexporter.cpp \
+    ../src/cpp/devicestate.cpp \
+    ../src/cpp/settingscache.cpp \
+    ../src/cpp/startupprofile.cpp \
+    allocationcounter.cpp \
+    processmemory.cpp \
+    soaktest.cpp
+
+INCLUDEPATH += ../src/cpp/
+
+DEFINES += TESTING
+DEFINES += GIT_VERSION=0
+
+CONFIG += c++14
@@ -0,0 +1,12 @@
+#include "soaktest.h"
+
+int main(int argc, char** argv)
+{
+   // Commands go through queued connections, as in the application
+   QCoreApplication app(argc, argv);
+
+   QStandardPaths::setTestModeEnabled(true);
+
+   SoakTest tc;
+   return QTest::qExec(&tc, argc, argv);
+}
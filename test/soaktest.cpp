@@ -0,0 +1,308 @@
+#include "soaktest.h"
+#include "simulatedcommunicator.h"
+#include "allocationcounter.h"
+#include "processmemory.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cmath>
+
+void SoakTest::initTestCase()
+{
+    QVERIFY(mTempDir.isValid());
+
+    qInstallMessageHandler(Logger::messageHandler);
+
+    mController = createSimulatedController(mCommunicator, true);
+
+    r = mController->routineController();
+
+    mTelemetryRate = qEnvironmentVariableIsSet("UFCS_SOAK_RATE") ? qMax(1, qEnvironmentVariableIntValue("UFCS_SOAK_RATE"))
+                                                                 : 200;
+    mTelemetryFramesSent = 0;
+    mCoalescedSetpoints = 0;
+    mRoutineRuns = 0;
+    mStopping = false;
+
+    mClock.start();
+
+    // Commands are timestamped in the routine thread as they are emitted (direct connections), and matched with the
+    // messages reaching the communicator in the GUI thread, in order.
+    connect(r, &RoutineController::setValve, [this](uint, bool) { commandEmitted(); });
+    connect(r, &RoutineController::setValves, [this](quint32, quint32) { commandEmitted(); });
+    connect(r, &RoutineController::setPressure, [this](uint, double) { commandEmitted(); });
+    connect(mCommunicator, &SimulatedCommunicator::messageSent, [this](QByteArray) { commandSent(); });
+
+    mTelemetryTimer.setTimerType(Qt::PreciseTimer);
+    mTelemetryTimer.setInterval(5);
+    connect(&mTelemetryTimer, &QTimer::timeout, this, &SoakTest::sendTelemetry);
+}
+
+void SoakTest::cleanupTestCase()
+{
+    delete mController;
+    Logger::logger()->shutdown();
+    qInstallMessageHandler(nullptr);
+}
+
+void SoakTest::soak()
+{
+    int duration = qEnvironmentVariableIsSet("UFCS_SOAK_DURATION") ? qEnvironmentVariableIntValue("UFCS_SOAK_DURATION")
+                                                                   : 3600;
+    int sampleInterval = qBound(1, duration / 100, 60);
+
+    // Setpoints are spaced by more than Communicator::setpointInterval(), so that every command becomes one message
+    QString url = createRoutineFile("soak", {
+        "valve 1 open",
+        "valve 2 open",
+        "pressure 1 5",
+        "wait 25 ms",
+        "valve 1 close",
+        "pressure 2 3",
+        "wait until pressure 1 >= 4 timeout 100 ms",
+        "valve all close",
+        "pressure 1 0",
+        "wait 25 ms",
+        "pressure 2 0",
+        "wait 25 ms"
+    });
+
+    QMetaObject::Connection restart = connect(r, &RoutineController::finished, this, [this, url]() {
+        mRoutineRuns++;
+        if (!mStopping) {
+            r->loadFile(url);
+            r->begin();
+        }
+    });
+
+    QFile csv(qEnvironmentVariable("UFCS_SOAK_CSV"));
+    if (!csv.fileName().isEmpty() && csv.open(QIODevice::WriteOnly | QIODevice::Text))
+        csv.write("time,rss,allocations,live_allocations,log_queue,commands_in_flight,log_model_rows,routine_runs,"
+                  "latency_p50_us,latency_p99_us\n");
+
+    qInfo().noquote() << QString("Soak test: %1 s, %2 telemetry frames/s, sampled every %3 s")
+                         .arg(duration).arg(mTelemetryRate).arg(sampleInterval);
+
+    QVector<Sample> samples;
+    mClock.restart();
+    mTelemetryTimer.start();
+    r->loadFile(url);
+    r->begin();
+
+    while (mClock.elapsed() < duration * 1000LL) {
+        QTest::qWait(int(qMin<qint64>(sampleInterval * 1000LL, duration * 1000LL - mClock.elapsed() + 1)));
+
+        Sample sample = takeSample();
+        samples << sample;
+        printSample(sample);
+
+        if (csv.isOpen()) {
+            csv.write(QString("%1,%2,%3,%4,%5,%6,%7,%8,%9,%10\n")
+                      .arg(sample.time, 0, 'f', 1).arg(sample.residentSetSize).arg(sample.allocations)
+                      .arg(sample.liveAllocations).arg(sample.logQueueDepth).arg(sample.commandsInFlight)
+                      .arg(sample.logModelRows).arg(sample.routineRuns)
+                      .arg(sample.latencyP50, 0, 'f', 1).arg(sample.latencyP99, 0, 'f', 1).toUtf8());
+            csv.flush();
+        }
+    }
+
+    mStopping = true;
+    mTelemetryTimer.stop();
+    r->stop();
+    QTRY_VERIFY_WITH_TIMEOUT(r->status() != RoutineController::Running, 5000);
+    disconnect(restart);
+
+    // Every command emitted by the routine must have reached the communicator
+    QTRY_VERIFY_WITH_TIMEOUT(takeSample().commandsInFlight == 0, 5000);
+    QVERIFY(mRoutineRuns > 0);
+
+    QVector<Sample> measured;
+    for (Sample const& s : samples) {
+        if (s.time >= duration * WARM_UP_FRACTION)
+            measured << s;
+    }
+
+    if (measured.size() < 3 || measured.last().time - measured.first().time < MIN_TREND_DURATION) {
+        qWarning() << "Soak test: run too short to check trends; use UFCS_SOAK_DURATION to run for at least"
+                   << qRound(MIN_TREND_DURATION / (1 - WARM_UP_FRACTION)) << "s";
+        return;
+    }
+
+    if (measured.first().residentSetSize >= 0)
+        checkTrend(measured, "Resident set size (bytes)",
+                   [](Sample const& s) { return double(s.residentSetSize); }, MAX_RSS_GROWTH);
+    checkTrend(measured, "Live allocations",
+               [](Sample const& s) { return double(s.liveAllocations); }, MAX_LIVE_ALLOCATION_GROWTH);
+    checkTrend(measured, "Log queue depth",
+               [](Sample const& s) { return double(s.logQueueDepth); }, MAX_QUEUE_GROWTH);
+    checkTrend(measured, "Commands in flight",
+               [](Sample const& s) { return double(s.commandsInFlight); }, MAX_QUEUE_GROWTH);
+
+    // Latency: compare the start and end of the measured period
+    int n = qMax(1, measured.size() / 10);
+    double startP99(0), endP99(0);
+    for (int i(0); i < n; ++i) {
+        startP99 += measured[i].latencyP99 / n;
+        endP99 += measured[measured.size() - 1 - i].latencyP99 / n;
+    }
+    qInfo().noquote() << QString("Dispatch latency p99: %1 us at the start, %2 us at the end")
+                         .arg(startP99, 0, 'f', 1).arg(endP99, 0, 'f', 1);
+    QVERIFY2(endP99 <= 2*startP99 + 5000, "Dispatch latency increased over the run");
+}
+
+/**
+ * @brief Write a routine to a temporary file
+ * @return The URL of the file, to be passed to RoutineController::loadFile
+ */
+QString SoakTest::createRoutineFile(const QString &name, const QStringList &lines)
+{
+    QString path = mTempDir.filePath(name + ".txt");
+
+    QFile file(path);
+    file.open(QIODevice::WriteOnly | QIODevice::Text);
+    file.write(lines.join('\n').toUtf8());
+    file.close();
+
+    return QUrl::fromLocalFile(path).toString();
+}
+
+/**
+ * @brief Send the TELEMETRY frames due since the last call, to keep up the configured rate
+ */
+void SoakTest::sendTelemetry()
+{
+    qint64 due = mClock.elapsed() * mTelemetryRate / 1000;
+
+    for (; mTelemetryFramesSent < due; ++mTelemetryFramesSent) {
+        QByteArray data;
+        for (uint8_t controller(1); controller <= 2; ++controller) {
+            // Measured pressure oscillates around the middle of the range
+            double t = mTelemetryFramesSent / double(mTelemetryRate);
+            quint16 setpoint = PR_MAX_VALUE_V2 / 2;
+            quint16 measured = quint16(setpoint + 0.4 * PR_MAX_VALUE_V2 * std::sin(t * controller));
+
+            data.push_back(controller);
+            data.push_back(uint8_t(setpoint >> 8));
+            data.push_back(uint8_t(setpoint));
+            data.push_back(uint8_t(measured >> 8));
+            data.push_back(uint8_t(measured));
+        }
+
+        QByteArray message;
+        message.push_back(TELEMETRY);
+        message.push_back(uint8_t(data.size()));
+        message.append(data);
+        mCommunicator->receive(message);
+    }
+}
+
+/**
+ * @brief Record that the routine emitted a command. Called from the routine thread.
+ */
+void SoakTest::commandEmitted()
+{
+    qint64 now = mClock.nsecsElapsed();
+    std::lock_guard<std::mutex> lock(mInFlightMutex);
+    mInFlight.push_back(now);
+}
+
+/**
+ * @brief Record that a command reached the communicator, and how long it took
+ */
+void SoakTest::commandSent()
+{
+    qint64 now = mClock.nsecsElapsed();
+    std::lock_guard<std::mutex> lock(mInFlightMutex);
+
+    // Setpoints replaced by a newer one before being sent never reach the communicator (this only happens if the GUI
+    // thread stalls, as the routine spaces its setpoints). They are dropped from the oldest commands, so that the
+    // counts still match.
+    for (; mCoalescedSetpoints < mCommunicator->coalescedSetpoints() && !mInFlight.empty(); ++mCoalescedSetpoints)
+        mInFlight.pop_front();
+
+    if (!mInFlight.empty()) {
+        mLatencies << now - mInFlight.front();
+        mInFlight.pop_front();
+    }
+}
+
+SoakTest::Sample SoakTest::takeSample()
+{
+    Sample s;
+    s.time = mClock.elapsed() / 1000.;
+    s.residentSetSize = ProcessMemory::residentSetSize();
+    s.allocations = AllocationCounter::allocations();
+    s.liveAllocations = AllocationCounter::liveAllocations();
+    s.logQueueDepth = Logger::logger()->queueDepth();
+    s.logModelRows = mController->logModel()->rowCount();
+    s.routineRuns = mRoutineRuns;
+
+    QVector<qint64> latencies;
+    {
+        std::lock_guard<std::mutex> lock(mInFlightMutex);
+        s.commandsInFlight = int(mInFlight.size());
+        latencies.swap(mLatencies);
+    }
+
+    s.latencyP50 = percentile(latencies, 0.5) / 1000.;
+    s.latencyP99 = percentile(latencies, 0.99) / 1000.;
+
+    return s;
+}
+
+void SoakTest::printSample(const SoakTest::Sample &s)
+{
+    qInfo().noquote() << QString("%1 s: RSS %2 MB, %3 allocations (%4 live), log queue %5, %6 commands in flight, "
+                                 "%7 log rows, %8 routine runs, latency p50 %9 us, p99 %10 us")
+                         .arg(s.time, 0, 'f', 0)
+                         .arg(s.residentSetSize / 1048576., 0, 'f', 1)
+                         .arg(s.allocations)
+                         .arg(s.liveAllocations)
+                         .arg(s.logQueueDepth)
+                         .arg(s.commandsInFlight)
+                         .arg(s.logModelRows)
+                         .arg(s.routineRuns)
+                         .arg(s.latencyP50, 0, 'f', 1)
+                         .arg(s.latencyP99, 0, 'f', 1);
+}
+
+/**
+ * @brief Fail if a value grows by more than maxSlope per hour over the given samples
+ */
+void SoakTest::checkTrend(const QVector<SoakTest::Sample> &samples, const char *name,
+                          double (*value)(const SoakTest::Sample &), double maxSlope)
+{
+    double slope = slopePerHour(samples, value);
+    qInfo().noquote() << QString("%1: %2 per hour (limit %3)").arg(name).arg(slope, 0, 'f', 1).arg(maxSlope, 0, 'f', 0);
+
+    QVERIFY2(slope <= maxSlope, qPrintable(QString("%1 grows over time").arg(name)));
+}
+
+double SoakTest::percentile(QVector<qint64> samples, double p)
+{
+    if (samples.isEmpty())
+        return 0;
+
+    std::sort(samples.begin(), samples.end());
+    return samples[qMin(samples.size() - 1, int(p * samples.size()))];
+}
+
+/**
+ * @brief Return the slope of the least-squares line through the values of the samples, per hour
+ */
+double SoakTest::slopePerHour(const QVector<SoakTest::Sample> &samples, double (*value)(const SoakTest::Sample &))
+{
+    double meanTime(0), meanValue(0);
+    for (Sample const& s : samples) {
+        meanTime += s.time / samples.size();
+        meanValue += value(s) / samples.size();
+    }
+
+    double covariance(0), variance(0);
+    for (Sample const& s : samples) {
+        covariance += (s.time - meanTime) * (value(s) - meanValue);
+        variance += (s.time - meanTime) * (s.time - meanTime);
+    }
+
+    return variance > 0 ? covariance / variance * 3600 : 0;
+}
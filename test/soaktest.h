@@ -0,0 +1,118 @@
+#ifndef SOAKTEST_H
+#define SOAKTEST_H
+
+#include <deque>
+#include <mutex>
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include "routinecontroller.h"
+#include "mockapplicationcontroller.h"
+
+/**
+ * @brief Long-running test of the whole application stack, to detect leaks and backlogs that only show over hours
+ *
+ * A simulated device sends pressure telemetry at a sustained rate, while a routine (valve toggles, setpoints, waits,
+ * `wait until` conditions) is loaded and run over and over, going through the same path as in the application:
+ * RoutineController (worker thread) -> ApplicationController (GUI thread) -> Communicator, with replies echoed back.
+ * Messages are logged through the application's Logger.
+ *
+ * At regular intervals, the following are sampled and printed (and written to a CSV file if UFCS_SOAK_CSV is set):
+ *  - resident set size (Linux and macOS only)
+ *  - heap allocations made with operator new, and those not freed yet (see AllocationCounter)
+ *  - queue depths: messages waiting to be written by the Logger, commands emitted by the routine thread that haven't
+ *    reached the communicator yet, and rows in the GUI log model
+ *  - dispatch latency percentiles: time between the routine emitting a command and the command reaching the
+ *    communicator
+ *
+ * The test fails if, after a warm-up period, the resident set size, the number of live allocations or a queue depth
+ * grows over time (the slope of a least-squares fit exceeds the limit per hour), or if the latency at the end of the
+ * run is much worse than at the start. Trends are only checked if the measured period lasts at least
+ * MIN_TREND_DURATION, as shorter runs are too noisy.
+ *
+ * The run is configured with environment variables:
+ *  - UFCS_SOAK_DURATION: duration in seconds (default: 1 hour)
+ *  - UFCS_SOAK_RATE: telemetry frames sent by the simulated device per second (default: 200)
+ *  - UFCS_SOAK_CSV: path of a CSV file where samples are written
+ *
+ * The soak test is a separate target (soak.pro), as it replaces the global operator new.
+ */
+class SoakTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void soak();
+
+private:
+    struct Sample
+    {
+        /// Seconds since the start of the run
+        double time;
+        /// Bytes, or -1 if unknown
+        qint64 residentSetSize;
+        quint64 allocations;
+        qint64 liveAllocations;
+        quint64 logQueueDepth;
+        int commandsInFlight;
+        int logModelRows;
+        int routineRuns;
+        /// Dispatch latency percentiles over the sampling interval, in us
+        double latencyP50;
+        double latencyP99;
+    };
+
+    QString createRoutineFile(QString const& name, QStringList const& lines);
+    void sendTelemetry();
+    void commandEmitted();
+    void commandSent();
+    Sample takeSample();
+    void printSample(Sample const& sample);
+    void checkTrend(QVector<Sample> const& samples, const char* name, double (*value)(Sample const&), double maxSlope);
+
+    static double percentile(QVector<qint64> samples, double p);
+    static double slopePerHour(QVector<Sample> const& samples, double (*value)(Sample const&));
+
+    /// Trends are not checked over shorter periods, in seconds
+    static const int MIN_TREND_DURATION = 600;
+
+    /// Part of the run excluded from trends, while caches and buffers fill up
+    static constexpr double WARM_UP_FRACTION = 0.2;
+
+    /// Maximum growth per hour
+    static constexpr double MAX_RSS_GROWTH = 16*1024*1024;
+    static constexpr double MAX_LIVE_ALLOCATION_GROWTH = 20000;
+    static constexpr double MAX_QUEUE_GROWTH = 100;
+
+    QTemporaryDir mTempDir;
+    QElapsedTimer mClock;
+
+    ApplicationController* mController;
+    SimulatedCommunicator* mCommunicator;
+    RoutineController* r;
+
+    QTimer mTelemetryTimer;
+    int mTelemetryRate;
+    qint64 mTelemetryFramesSent;
+
+    /// Time at which each command that didn't reach the communicator yet was emitted by the routine thread
+    std::mutex mInFlightMutex;
+    std::deque<qint64> mInFlight;
+
+    /// Dispatch latencies since the last sample, in ns. Protected by mInFlightMutex.
+    QVector<qint64> mLatencies;
+
+    /// Number of setpoints coalesced by the communicator that were accounted for. Protected by mInFlightMutex.
+    quint64 mCoalescedSetpoints;
+
+    int mRoutineRuns;
+
+    /// Set at the end of the run, so that the routine isn't started again
+    bool mStopping;
+};
+
+#endif // SOAKTEST_H
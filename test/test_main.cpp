@@ -1,8 +1,17 @@
 #include "testroutines.h"
 #include "testcommunicator.h"
+#include "testlogging.h"
+#include "testpressurerecorder.h"
+#include "testexperimentexporter.h"
+#include "testdevicestate.h"
+#include "testsettingscache.h"
+#include "testguiupdates.h"
 
 int main(int argc, char** argv)
 {
+   // Keep routine checkpoints out of the user's data directory
+   QStandardPaths::setTestModeEnabled(true);
+
    int status = 0;
    {
       TestCommunicator tc;
@@ -14,5 +23,35 @@ int main(int argc, char** argv)
       status |= QTest::qExec(&tc, argc, argv);
    }
 
+   {
+      TestLogging tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+
+   {
+      TestPressureRecorder tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+
+   {
+      TestExperimentExporter tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+
+   {
+      TestDeviceState tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+
+   {
+      TestSettingsCache tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+
+   {
+      TestGuiUpdates tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+
    return status;
 }
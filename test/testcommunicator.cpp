@@ -1,4 +1,5 @@
 #include "testcommunicator.h"
+#include "simulatedcommunicator.h"
 
 
 void noMessageOutput(QtMsgType, const QMessageLogContext&, const QString&)
@@ -22,6 +23,7 @@ void TestCommunicator::init()
     c->mDecoderEscaped = false;
     c->mBuffer.clear();
     c->mDecodedBuffer.clear();
+    c->mProtocolVersion = 1;
 }
 
 void TestCommunicator::cleanup()
@@ -279,6 +281,98 @@ void TestCommunicator::pressureChange()
     }
 }
 
+void TestCommunicator::setpointCoalescing()
+{
+    auto setpointMessage = [this](uint8_t controllerNumber, double pressure) {
+        QByteArray message;
+        message.push_back(PRESSURE);
+        message.push_back(1);
+        message.push_back(controllerNumber);
+        message.push_back(1);
+        message.push_back(uint8_t(pressure*PR_MAX_VALUE));
+        return c->frameMessage(message);
+    };
+
+    SimulatedCommunicator s(c->appController);
+    s.connect();
+    QSignalSpy sent(&s, SIGNAL(messageSent(QByteArray)));
+
+    // The first setpoint is sent immediately; the following ones are held back, and only the latest is sent
+    s.setPressure(1, 0.1);
+    s.setPressure(1, 0.2);
+    s.setPressure(1, 0.3);
+    s.setPressure(2, 0.5);
+    QCOMPARE(sent.count(), 2);
+    QCOMPARE(s.coalescedSetpoints(), quint64(1));
+
+    QTRY_COMPARE(sent.count(), 3);
+    QCOMPARE(sent[2][0].toByteArray(), setpointMessage(1, 0.3));
+
+    // Waiting setpoints are sent before other commands
+    s.setPressure(1, 0.4);
+    s.setPressure(1, 0.6);
+    s.setValve(1, true);
+    QCOMPARE(sent.last()[0].toByteArray(), c->valveMessage(1, true));
+    QCOMPARE(sent[sent.count() - 2][0].toByteArray(), setpointMessage(1, 0.6));
+
+    QTest::qWait(2*s.setpointInterval());
+    QCOMPARE(sent.last()[0].toByteArray(), c->valveMessage(1, true));
+}
+
+void TestCommunicator::pressureChangeV2()
+{
+    // In protocol version 2, setpoint and measured value are 16-bit, most significant byte first
+    QList<QByteArray> params { QByteArray(1, 2), QByteArray::fromHex("8000"), QByteArray::fromHex("fffe") };
+
+    QSignalSpy spSpy(c, SIGNAL(pressureSetpointChanged(uint, double)));
+    QSignalSpy pvSpy(c, SIGNAL(pressureChanged(uint, double)));
+    c->handleCommand(PRESSURE, params);
+
+    QCOMPARE(spSpy.count(), 1);
+    QCOMPARE(spSpy[0][0].toUInt(), 2u);
+    QCOMPARE(spSpy[0][1].toDouble(), 0x8000/65535.);
+    QCOMPARE(pvSpy[0][1].toDouble(), 0xfffe/65535.);
+
+    // Setpoint and measured value must have the same size
+    params[2] = QByteArray(1, 10);
+    c->handleCommand(PRESSURE, params);
+    QCOMPARE(spSpy.count(), 1);
+
+    // Setpoints are sent with 16 bits once the device has chosen version 2
+    SimulatedCommunicator s(c->appController);
+    s.connect();
+    QSignalSpy sent(&s, SIGNAL(messageSent(QByteArray)));
+    s.setPressure(1, 0.5);
+    QCOMPARE(sent.last()[0].toByteArray(), c->frameMessage(QByteArray::fromHex("010101017f")));
+
+    s.mProtocolVersion = 2;
+    s.setPressure(2, 0.5);
+    QCOMPARE(sent.last()[0].toByteArray(), c->frameMessage(QByteArray::fromHex("010102028000")));
+}
+
+void TestCommunicator::telemetry()
+{
+    // One parameter, with number, setpoint and measured value (16-bit each) of each controller
+    QList<QByteArray> params { QByteArray::fromHex("01ffff0000" "0300000001") };
+
+    QSignalSpy spSpy(c, SIGNAL(pressureSetpointChanged(uint, double)));
+    QSignalSpy pvSpy(c, SIGNAL(pressureChanged(uint, double)));
+    c->handleCommand(TELEMETRY, params);
+
+    QCOMPARE(spSpy.count(), 2);
+    QCOMPARE(pvSpy.count(), 2);
+    QCOMPARE(spSpy[0][0].toUInt(), 1u);
+    QCOMPARE(spSpy[0][1].toDouble(), 1.);
+    QCOMPARE(pvSpy[0][1].toDouble(), 0.);
+    QCOMPARE(spSpy[1][0].toUInt(), 3u);
+    QCOMPARE(pvSpy[1][1].toDouble(), 1/65535.);
+
+    // Incomplete
+    params[0].chop(1);
+    c->handleCommand(TELEMETRY, params);
+    QCOMPARE(spSpy.count(), 2);
+}
+
 void TestCommunicator::frameMessage()
 {
     // Messages need to be framed by a start and end byte, and any special characters
@@ -328,6 +422,54 @@ void TestCommunicator::uptime()
 
 }
 
+void TestCommunicator::capabilities()
+{
+    // CAPABILITIES has the number of valves, pumps and pressure controllers (1 byte each), the firmware version and
+    // device identifier (strings), and the range of each pressure controller: min and max in thousandths of PSI,
+    // as signed 32-bit values (most significant byte first).
+    qRegisterMetaType<DeviceCapabilities>();
+
+    auto range = [](qint32 min, qint32 max) {
+        QByteArray p;
+        for (qint32 v : {min, max})
+            for (int shift(24); shift >= 0; shift -= 8)
+                p.push_back(uint8_t(quint32(v) >> shift));
+        return p;
+    };
+
+    QList<QByteArray> params { QByteArray(1, 24), QByteArray(1, 1), QByteArray(1, 2), "2.1.0", "ufcs-0042",
+                               range(0, 29500), range(-14000, 14000) };
+
+    QSignalSpy spy(c, SIGNAL(capabilitiesReceived(DeviceCapabilities)));
+    c->handleCommand(CAPABILITIES, params);
+
+    QCOMPARE(spy.count(), 1);
+    DeviceCapabilities capabilities = spy.takeFirst()[0].value<DeviceCapabilities>();
+    QCOMPARE(capabilities.valveCount, 24);
+    QCOMPARE(capabilities.pumpCount, 1);
+    QCOMPARE(capabilities.controllerCount, 2);
+    QCOMPARE(capabilities.firmwareVersion, QString("2.1.0"));
+    QCOMPARE(capabilities.deviceId, QString("ufcs-0042"));
+    QCOMPARE(capabilities.minPressure[0], 0.);
+    QCOMPARE(capabilities.maxPressure[0], 29.5);
+    QCOMPARE(capabilities.minPressure[1], -14.);
+    QCOMPARE(capabilities.maxPressure[1], 14.);
+    QCOMPARE(capabilities.protocolVersion, 1);
+    QCOMPARE(c->protocolVersion(), 1);
+
+    // The device chose protocol version 2
+    params << QByteArray(1, 2);
+    c->handleCommand(CAPABILITIES, params);
+    QCOMPARE(spy.takeFirst()[0].value<DeviceCapabilities>().protocolVersion, 2);
+    QCOMPARE(c->protocolVersion(), 2);
+    params.removeLast();
+
+    // A range is missing
+    params.removeLast();
+    c->handleCommand(CAPABILITIES, params);
+    QCOMPARE(spy.count(), 0);
+}
+
 void TestCommunicator::parseDecodedBuffer()
 {
     // Parse a valid buffer, and execute the command in it.
@@ -31,10 +31,14 @@ private slots:
     void valveChange();
     void pumpChange();
     void pressureChange();
+    void setpointCoalescing();
+    void pressureChangeV2();
+    void telemetry();
 
     void frameMessage();
 
     void uptime();
+    void capabilities();
 
     void parseDecodedBuffer();
     // To do:
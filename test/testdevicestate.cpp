@@ -0,0 +1,134 @@
+#include "testdevicestate.h"
+
+void TestDeviceState::testValvesAndPumps()
+{
+    DeviceState state;
+    QCOMPARE(state.valveCount(), N_VALVES);
+    QCOMPARE(state.pumpCount(), N_PUMPS);
+
+    DeviceCapabilities capabilities = DeviceCapabilities::defaults();
+    capabilities.valveCount = 16;
+    capabilities.pumpCount = 1;
+    state.setCapabilities(capabilities);
+    QCOMPARE(state.valveCount(), 16);
+    QVERIFY(state.isValveDefined(16));
+    QVERIFY(!state.isValveDefined(17));
+
+    // The first report is a change, even if the valve is closed
+    QVERIFY(!state.isValveKnown(5));
+    QVERIFY(state.setValveState(5, false));
+    QVERIFY(state.isValveKnown(5));
+    QVERIFY(!state.setValveState(5, false));
+    QVERIFY(state.setValveState(5, true));
+    QVERIFY(state.valveState(5));
+
+    QVERIFY(state.setValveState(32, true));
+    QCOMPARE(state.valveStates(), (1u << 4) | (1u << 31));
+
+    QVERIFY(!state.setValveState(0, true));
+    QVERIFY(!state.setValveState(33, true));
+    QVERIFY(!state.valveState(33));
+
+    QCOMPARE(state.pumpCount(), 1);
+    QVERIFY(state.setPumpState(2, true));
+    QVERIFY(!state.setPumpState(2, true));
+    QVERIFY(state.pumpState(2));
+    QVERIFY(!state.pumpState(1));
+    QVERIFY(!state.setPumpState(N_PUMPS + 1, true));
+
+    // Counts are limited to what the application supports
+    capabilities.valveCount = 64;
+    state.setCapabilities(capabilities);
+    QCOMPARE(state.valveCount(), N_VALVES);
+}
+
+void TestDeviceState::testPressureControllers()
+{
+    DeviceState state;
+    QCOMPARE(state.controllerCount(), N_PRS);
+    QCOMPARE(state.minPressure(3), double(PR3_MIN_PRESSURE));
+    QCOMPARE(state.maxPressure(3), double(PR3_MAX_PRESSURE));
+
+    DeviceCapabilities capabilities;
+    capabilities.controllerCount = 2;
+    capabilities.minPressure[0] = 0;
+    capabilities.maxPressure[0] = 30;
+    capabilities.minPressure[1] = -14;
+    capabilities.maxPressure[1] = 14;
+    state.setCapabilities(capabilities);
+
+    QCOMPARE(state.controllerCount(), 2);
+    QVERIFY(!state.isControllerDefined(3));
+    QCOMPARE(state.minPressure(2), -14.);
+    QCOMPARE(state.maxPressure(2), 14.);
+    QCOMPARE(state.toPsi(1, 0.5), 15.);
+    QCOMPARE(state.toPsi(2, 0.25), -7.);
+    QCOMPARE(state.toPsi(N_PRS + 1, 0.5), 0.);
+
+    QVERIFY(state.setMeasuredPressure(1, 0.5));
+    QVERIFY(!state.setMeasuredPressure(1, 0.5));
+    QCOMPARE(state.measuredPressure(1), 0.5);
+
+    QVERIFY(state.setSetpoint(2, 1));
+    QCOMPARE(state.setpoint(2), 1.);
+    QCOMPARE(state.setpoint(3), 0.);
+}
+
+void TestDeviceState::testPendingCommands()
+{
+    DeviceState state;
+    state.setValveState(1, false);
+    state.setValveState(2, false);
+    QVERIFY(!state.hasPendingCommands());
+
+    // Commanded state is shown until the device confirms it
+    state.commandValve(1, true, 1000);
+    QVERIFY(state.hasPendingCommands());
+    QVERIFY(state.isValvePending(1));
+    QVERIFY(state.displayedValveState(1));
+    QVERIFY(!state.valveState(1));
+
+    // A stale report of the previous state doesn't confirm the command
+    state.setValveState(1, false);
+    QVERIFY(state.isValvePending(1));
+    QVERIFY(state.displayedValveState(1));
+
+    state.setValveState(1, true);
+    QVERIFY(!state.isValvePending(1));
+    QVERIFY(state.displayedValveState(1));
+    QVERIFY(!state.hasPendingCommands());
+
+    // Commands that are never confirmed expire, and the reported state is shown again
+    state.commandValve(2, true, 1000);
+    state.commandPump(1, true, 1500);
+    QCOMPARE(state.expireValveCommands(2999, 2000), 0u);
+    QCOMPARE(state.expireValveCommands(3000, 2000), 1u << 1);
+    QVERIFY(!state.isValvePending(2));
+    QVERIFY(state.isValveUnconfirmed(2));
+    QVERIFY(!state.displayedValveState(2));
+    QVERIFY(state.isPumpPending(1));
+    QCOMPARE(state.expirePumpCommands(3500, 2000), 1u);
+    QVERIFY(state.isPumpUnconfirmed(1));
+
+    // A late confirmation, or a new command, clears the flag
+    state.setValveState(2, true);
+    QVERIFY(!state.isValveUnconfirmed(2));
+    state.commandPump(1, false, 4000);
+    QVERIFY(!state.isPumpUnconfirmed(1));
+    QVERIFY(state.isPumpPending(1));
+
+    // Setpoints are confirmed within the precision of the device
+    state.commandSetpoint(1, 0.5, 1000);
+    QVERIFY(state.isSetpointPending(1));
+    QCOMPARE(state.displayedSetpoint(1), 0.5);
+    state.setSetpoint(1, 0.1);
+    QVERIFY(state.isSetpointPending(1));
+    state.setSetpoint(1, 128. / PR_MAX_VALUE);
+    QVERIFY(!state.isSetpointPending(1));
+    QCOMPARE(state.displayedSetpoint(1), 128. / PR_MAX_VALUE);
+
+    state.commandSetpoint(2, 0.25, 1000);
+    QCOMPARE(state.expireSetpointCommands(3000, 2000), 1u << 1);
+    QVERIFY(state.isSetpointUnconfirmed(2));
+    QCOMPARE(state.displayedSetpoint(2), 0.);
+}
@@ -0,0 +1,19 @@
+#ifndef TESTDEVICESTATE_H
+#define TESTDEVICESTATE_H
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include "devicestate.h"
+
+class TestDeviceState : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testValvesAndPumps();
+    void testPressureControllers();
+    void testPendingCommands();
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include "testexperimentexporter.h"
+
+QList<QStringList> TestExperimentExporter::readRows(const QString &path)
+{
+    QList<QStringList> rows;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return rows;
+
+    while (!file.atEnd()) {
+        QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if (!line.isEmpty())
+            rows << line.split(',');
+    }
+    return rows;
+}
+
+void TestExperimentExporter::testExport()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    ExperimentExporter exporter(dir.path());
+
+    // State before the run is written at the start of the run
+    exporter.recordValve(3, true);
+    exporter.recordValve(4, false);
+    exporter.recordSetpoint(1, 12.5);
+    exporter.recordPressure(1, 12.25);
+
+    exporter.beginRun("Test routine");
+    exporter.recordStep(0, "valve 3 close");
+    exporter.recordValve(3, false);
+    exporter.recordStep(1, "pressure 1 10");
+    exporter.recordSetpoint(1, 10);
+    exporter.recordPressure(1, 11);
+    exporter.endRun();
+
+    // Events between runs aren't exported
+    exporter.recordValve(5, true);
+    exporter.flush();
+
+    QString path = exporter.lastFilePath();
+    QVERIFY(QFileInfo(path).fileName().startsWith("Test_routine_"));
+    QVERIFY(path.endsWith(".csv"));
+
+    QList<QStringList> rows = readRows(path);
+    QCOMPARE(rows.size(), 12);
+    QCOMPARE(rows[0], QStringList() << "timestamp" << "elapsed" << "step" << "event" << "number" << "value" << "text");
+
+    // timestamp, elapsed, step, event, number, value, text
+    QCOMPARE(rows[1].mid(2), QStringList() << "-1" << "run" << "0" << "0" << "Test routine");
+    QCOMPARE(rows[2].mid(2), QStringList() << "-1" << "valve" << "3" << "1" << "");
+    QCOMPARE(rows[3].mid(2), QStringList() << "-1" << "valve" << "4" << "0" << "");
+    QCOMPARE(rows[4].mid(2), QStringList() << "-1" << "setpoint" << "1" << "12.5" << "");
+    QCOMPARE(rows[5].mid(2), QStringList() << "-1" << "pressure" << "1" << "12.25" << "");
+    QCOMPARE(rows[6].mid(2), QStringList() << "0" << "step" << "0" << "0" << "valve 3 close");
+    QCOMPARE(rows[7].mid(2), QStringList() << "0" << "valve" << "3" << "0" << "");
+    QCOMPARE(rows[8].mid(2), QStringList() << "1" << "step" << "1" << "0" << "pressure 1 10");
+    QCOMPARE(rows[9].mid(2), QStringList() << "1" << "setpoint" << "1" << "10" << "");
+    QCOMPARE(rows[10].mid(2), QStringList() << "1" << "pressure" << "1" << "11" << "");
+    QCOMPARE(rows[11].mid(3), QStringList() << "run" << "0" << "0" << "Finished");
+
+    // Timestamps don't decrease, and elapsed times are relative to the start of the run
+    qint64 start = rows[1][0].toLongLong();
+    for (int i(2); i < rows.size() - 1; ++i) {
+        QVERIFY(rows[i][0].toLongLong() >= rows[i-1][0].toLongLong());
+        QCOMPARE(rows[i][1].toDouble(), (rows[i][0].toLongLong() - start) / 1000.);
+    }
+
+    // A new run gets a new file, starting with the current state
+    exporter.beginRun("Test routine");
+    exporter.endRun();
+    exporter.flush();
+
+    QVERIFY(exporter.lastFilePath() != path);
+    rows = readRows(exporter.lastFilePath());
+    QCOMPARE(rows[2].mid(3, 3), QStringList() << "valve" << "3" << "0");
+    QCOMPARE(rows[4].mid(3, 3), QStringList() << "valve" << "5" << "1");
+}
+
+void TestExperimentExporter::testBoundedQueue()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const int n = 200000;
+    quint64 dropped;
+    QString path;
+
+    {
+        ExperimentExporter exporter(dir.path(), 100);
+        exporter.beginRun("Bounded");
+        for (int i(0); i < n; ++i)
+            exporter.recordPressure(1, i);
+        exporter.endRun();
+        exporter.flush();
+
+        dropped = exporter.droppedEvents();
+        path = exporter.lastFilePath();
+    }
+
+    QList<QStringList> rows = readRows(path);
+
+    int pressureRows = 0;
+    quint64 reportedDrops = 0;
+    for (QStringList const& row : rows) {
+        if (row[3] == "pressure")
+            pressureRows++;
+        else if (row[3] == "dropped")
+            reportedDrops += row[4].toULongLong();
+    }
+
+    // Every event is either written or counted as dropped, and the file is always closed properly
+    QCOMPARE(quint64(pressureRows) + dropped, quint64(n));
+    QCOMPARE(reportedDrops, dropped);
+    QCOMPARE(rows.last()[6], QString("Finished"));
+}
+
+void TestExperimentExporter::testStop()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    ExperimentExporter exporter(dir.path());
+    exporter.beginRun("Test routine");
+    exporter.recordValve(1, true);
+
+    // Stopping writes the pending events and closes the run, which is still in progress
+    exporter.stop();
+    exporter.recordValve(2, true);
+    exporter.stop();
+
+    QList<QStringList> rows = readRows(exporter.lastFilePath());
+    QCOMPARE(rows.size(), 4);
+    QCOMPARE(rows[2].mid(3, 3), QStringList() << "valve" << "1" << "1");
+    QCOMPARE(rows[3].mid(3), QStringList() << "run" << "0" << "0" << "Application closed");
+}
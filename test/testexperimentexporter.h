@@ -0,0 +1,22 @@
+#ifndef TESTEXPERIMENTEXPORTER_H
+#define TESTEXPERIMENTEXPORTER_H
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include "experimentexporter.h"
+
+class TestExperimentExporter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testExport();
+    void testBoundedQueue();
+    void testStop();
+
+private:
+    static QList<QStringList> readRows(QString const& path);
+};
+
+#endif
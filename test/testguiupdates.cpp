@@ -0,0 +1,60 @@
+#include "testguiupdates.h"
+#include "simulatedcommunicator.h"
+#include "guihelper.h"
+
+void TestGuiUpdates::initTestCase()
+{
+    mController = createSimulatedController(mCommunicator);
+}
+
+void TestGuiUpdates::cleanupTestCase()
+{
+    delete mController;
+}
+
+void TestGuiUpdates::coalescing()
+{
+    ValveSwitchHelper valve;
+    PCHelper controller;
+    valve.setDeviceState(mController->deviceState());
+    valve.setNumber(3);
+    controller.setDeviceState(mController->deviceState());
+    controller.setNumber(1);
+
+    QSignalSpy valveSpy(&valve, SIGNAL(stateChanged(bool)));
+    QSignalSpy setpointSpy(&controller, SIGNAL(setPointChanged(double)));
+    QSignalSpy measuredSpy(&controller, SIGNAL(measuredValueChanged(double)));
+    QSignalSpy stateSpy(mController->deviceState(), SIGNAL(changed(quint32,quint32,quint32,quint32)));
+
+    // A burst of reports from the device: the valve ends up open, and the controller at the last values
+    for (int i(0); i < 5; ++i) {
+        mCommunicator->receive(QByteArray::fromHex("00010301") + char(i % 2 == 0));
+        mCommunicator->receive(QByteArray::fromHex("01010101") + char(10*i) + char(1) + char(20*i));
+    }
+
+    // Nothing is updated until the next frame
+    QCOMPARE(valveSpy.count(), 0);
+    QCOMPARE(setpointSpy.count(), 0);
+    QCOMPARE(measuredSpy.count(), 0);
+
+    QTRY_COMPARE_WITH_TIMEOUT(valveSpy.count(), 1, 10*ApplicationController::GUI_UPDATE_INTERVAL);
+    QCOMPARE(setpointSpy.count(), 1);
+    QCOMPARE(measuredSpy.count(), 1);
+    QCOMPARE(stateSpy.count(), 1);
+
+    QCOMPARE(valve.state(), true);
+    QCOMPARE(controller.setPoint(), 40./PR_MAX_VALUE);
+    QCOMPARE(controller.measuredValue(), 80./PR_MAX_VALUE);
+
+    // No further updates without changes
+    QTest::qWait(5*ApplicationController::GUI_UPDATE_INTERVAL);
+    QCOMPARE(valveSpy.count(), 1);
+    QCOMPARE(setpointSpy.count(), 1);
+    QCOMPARE(measuredSpy.count(), 1);
+
+    // Helpers created later, e.g. by lazily loaded screens, read the current state when they are bound
+    ValveSwitchHelper lateValve;
+    lateValve.setNumber(3);
+    lateValve.setDeviceState(mController->deviceState());
+    QCOMPARE(lateValve.state(), true);
+}
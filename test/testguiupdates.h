@@ -0,0 +1,27 @@
+#ifndef TESTGUIUPDATES_H
+#define TESTGUIUPDATES_H
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include "mockapplicationcontroller.h"
+
+/**
+ * @brief Tests that the GUI helpers are updated at most once per frame, with the latest state of the device
+ */
+class TestGuiUpdates : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void coalescing();
+
+private:
+    ApplicationController* mController;
+    SimulatedCommunicator* mCommunicator;
+};
+
+#endif // TESTGUIUPDATES_H
@@ -0,0 +1,294 @@
+#include "testlogging.h"
+
+void TestLogging::testStructuredLog()
+{
+    QString path = "./test_log.bin";
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write(StructuredLog::FILE_MAGIC, sizeof(StructuredLog::FILE_MAGIC));
+
+    QVector<LogRecord> records;
+    qint64 t0 = QDateTime::currentMSecsSinceEpoch();
+
+    for (int i(0); i < 100; ++i) {
+        LogRecord record;
+        record.timestamp = t0 + i;
+        record.level = QtInfoMsg;
+        record.event = LogRecord::ValveChanged;
+        record.number = i % 10 + 1;
+        record.value = i % 2;
+        record.text = QString("Valve %1 %2").arg(record.number).arg(i % 2 ? "opened" : "closed");
+        records << record;
+    }
+
+    LogRecord message;
+    message.timestamp = t0 + 100;
+    message.level = QtWarningMsg;
+    message.text = QString::fromUtf8("Non-ASCII text: µL");
+    records << message;
+
+    for (LogRecord const& record : records)
+        file.write(record.encode());
+
+    // A record truncated by a crash is ignored
+    file.write(records[0].encode().left(StructuredLog::HEADER_SIZE + 2));
+    file.close();
+
+    StructuredLogReader reader;
+    QVERIFY(reader.open(path));
+
+    StructuredLogReader::Query all;
+    QCOMPARE(reader.count(all), 101);
+
+    StructuredLogReader::Query valve3;
+    valve3.event = LogRecord::ValveChanged;
+    valve3.number = 3;
+    QVector<LogRecord> found = reader.query(valve3);
+    QCOMPARE(found.size(), 10);
+    QCOMPARE(found[0].timestamp, t0 + 2);
+    QCOMPARE(found[0].text, records[2].text);
+    QCOMPARE(found[0].value, 0.);
+
+    StructuredLogReader::Query range;
+    range.from = t0 + 50;
+    range.to = t0 + 59;
+    QCOMPARE(reader.count(range), 10);
+
+    // Conversion back to text gives the same lines as the text log
+    QVERIFY(reader.convertToText("./test_log.txt"));
+    QFile text("./test_log.txt");
+    QVERIFY(text.open(QIODevice::ReadOnly));
+    QStringList lines = QString::fromUtf8(text.readAll()).split('\n', QString::SkipEmptyParts);
+    QCOMPARE(lines.size(), 101);
+    QCOMPARE(lines.last() + "\n", message.toText());
+}
+
+void TestLogging::testRotation()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    LogRotationPolicy policy;
+    policy.maxSegmentSize = 1000;
+    policy.maxSegmentAge = 0;
+    policy.maxAge = 0;
+    policy.maxTotalSize = 0;
+
+    qint64 bytesWritten = 0;
+    {
+        LogWriter writer;
+        writer.start(dir.path(), false, policy);
+
+        for (int i(0); i < 100; ++i) {
+            LogRecord record;
+            record.timestamp = QDateTime::currentMSecsSinceEpoch();
+            record.text = QString("Rotation test message %1").arg(i);
+            bytesWritten += record.toText().toUtf8().size();
+            writer.post(record);
+
+            if (i % 10 == 9)
+                writer.flush();
+        }
+
+        // Segments are compressed in the background; destroying the writer waits for them
+    }
+
+    QDir logDir(dir.path());
+    QFileInfoList current = logDir.entryInfoList(QStringList() << "log_*.txt", QDir::Files);
+    QFileInfoList archived = logDir.entryInfoList(QStringList() << "log_*.txt.gz", QDir::Files);
+    QCOMPARE(current.size(), 1);
+    QVERIFY(archived.size() >= 2);
+
+    // All messages are either in the current segment or in an archive (whose uncompressed size is in its trailer)
+    qint64 total = current[0].size();
+    for (QFileInfo const& info : archived) {
+        QFile file(info.absoluteFilePath());
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QByteArray data = file.readAll();
+        QCOMPARE(uchar(data[0]), uchar(0x1f));
+        QCOMPARE(uchar(data[1]), uchar(0x8b));
+        total += qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(data.constData()) + data.size() - 4);
+    }
+    QCOMPARE(total, bytesWritten);
+
+    // Retention: only the active file is kept when the size limit is tiny
+    policy.maxTotalSize = 1;
+    LogArchiver::prune(dir.path(), policy, QStringList() << current[0].absoluteFilePath());
+    QCOMPARE(logDir.entryInfoList(QStringList() << "log_*", QDir::Files).size(), 1);
+}
+
+void TestLogging::testLogModel()
+{
+    LogModel model(3);
+    QSignalSpy insertSpy(&model, SIGNAL(rowsInserted(QModelIndex, int, int)));
+    QSignalSpy removeSpy(&model, SIGNAL(rowsRemoved(QModelIndex, int, int)));
+
+    model.append({"12:00:00.000", "Info", "Valve 1 opened"});
+    model.append({"12:00:00.001", "Debug", "Setting valve 2"});
+    model.append({"12:00:00.002", "Warning", "Pressure invalid"});
+    QCOMPARE(model.rowCount(), 3);
+    QCOMPARE(insertSpy.count(), 3);
+    QCOMPARE(removeSpy.count(), 0);
+
+    // Once full, each new message replaces the oldest, one row at a time
+    model.append({"12:00:00.003", "Info", "Valve 2 opened"});
+    QCOMPARE(model.rowCount(), 3);
+    QCOMPARE(insertSpy.count(), 4);
+    QCOMPARE(removeSpy.count(), 1);
+    QCOMPARE(model.data(model.index(0), LogModel::MessageRole).toString(), QString("Setting valve 2"));
+    QCOMPARE(model.data(model.index(2), LogModel::TimestampRole).toString(), QString("12:00:00.003"));
+
+    model.setMinimumLevel(LogModel::Info);
+    QCOMPARE(model.rowCount(), 2);
+    QCOMPARE(model.data(model.index(0), LogModel::LevelRole).toString(), QString("Warning"));
+
+    // Messages that don't match the filter are stored, but not inserted as rows
+    model.append({"12:00:00.004", "Debug", "Setting valve 3"});
+    QCOMPARE(model.rowCount(), 2);
+
+    model.setMinimumLevel(LogModel::Debug);
+    model.setFilterText("VALVE");
+    QCOMPARE(model.rowCount(), 2);
+    QCOMPARE(model.data(model.index(1), LogModel::MessageRole).toString(), QString("Setting valve 3"));
+
+    // Reducing the capacity keeps the most recent messages
+    model.setFilterText("");
+    model.setCapacity(2);
+    QCOMPARE(model.rowCount(), 2);
+    QCOMPARE(model.data(model.index(0), LogModel::MessageRole).toString(), QString("Valve 2 opened"));
+}
+
+void TestLogging::testRateLimiter()
+{
+    LogRateLimiter limiter(20, 2);
+
+    // The burst is allowed, then messages are dropped until a token is available
+    QCOMPARE(limiter.tryAcquire(), 0);
+    QCOMPARE(limiter.tryAcquire(), 0);
+    QCOMPARE(limiter.tryAcquire(), -1);
+    QCOMPARE(limiter.tryAcquire(), -1);
+
+    // The next message logged reports how many were dropped
+    QTest::qSleep(60);
+    QCOMPARE(limiter.tryAcquire(), 2);
+
+    // The macro uses one bucket per call site
+    static int logged;
+    logged = 0;
+    QtMessageHandler previousHandler = qInstallMessageHandler([](QtMsgType, QMessageLogContext const&, QString const&) {
+        logged++;
+    });
+
+    for (int i(0); i < 10; ++i)
+        LOG_RATE_LIMITED(qDebug(), 0.1, 3) << "Rate-limited message" << i;
+
+    qInstallMessageHandler(previousHandler);
+    QCOMPARE(logged, 3);
+}
+
+void TestLogging::testLogCategories()
+{
+    static QStringList categories;
+    categories.clear();
+    QtMessageHandler previousHandler = qInstallMessageHandler([](QtMsgType, QMessageLogContext const& context,
+                                                                 QString const&) {
+        categories << context.category;
+    });
+
+    // Disabled levels don't reach the message handler, and the rest of the statement isn't evaluated
+    QLoggingCategory::setFilterRules("ufcs.communicator.debug=false");
+    int evaluated = 0;
+    UFCS_DEBUG(lcCommunicator) << "Disabled message" << ++evaluated;
+    UFCS_WARNING(lcCommunicator) << "Enabled message";
+    UFCS_DEBUG(lcMicrocontroller) << "Enabled message";
+    StructuredLog::logEvent(QtDebugMsg, LogRecord::Communicator, LogRecord::ValveChanged, 1, 1, "Disabled event");
+    QLoggingCategory::setFilterRules(QString());
+
+    qInstallMessageHandler(previousHandler);
+
+    QCOMPARE(evaluated, 0);
+    QCOMPARE(categories, QStringList() << "ufcs.communicator" << "ufcs.microcontroller");
+
+    QCOMPARE(StructuredLog::sourceFromCategory("ufcs.communicator"), LogRecord::Communicator);
+    QCOMPARE(StructuredLog::sourceFromCategory("ufcs.microcontroller"), LogRecord::Microcontroller);
+    QCOMPARE(StructuredLog::sourceFromCategory("default"), LogRecord::Application);
+    QCOMPARE(StructuredLog::sourceFromCategory(nullptr), LogRecord::Application);
+}
+
+void TestLogging::testLogClock()
+{
+    // Cached formatting gives the same result as formatting each time, including across seconds and days
+    QDateTime start(QDate(2020, 3, 31), QTime(23, 59, 58, 990));
+    for (qint64 t = start.toMSecsSinceEpoch(); t < start.toMSecsSinceEpoch() + 3000; t += 7) {
+        QDateTime dateTime = QDateTime::fromMSecsSinceEpoch(t);
+        QCOMPARE(LogClock::formatDateTime(t), dateTime.toString("yyyy-MM-dd hh:mm:ss.zzz"));
+        QCOMPARE(LogClock::formatTime(t), dateTime.toString("hh:mm:ss.zzz"));
+    }
+
+    // Log times follow the monotonic clock, and stay close to the system clock
+    qint64 t0 = LogClock::monotonicNanoseconds();
+    qint64 t1 = LogClock::monotonicNanoseconds();
+    QVERIFY(t1 >= t0);
+    QVERIFY(LogClock::toWallTime(t1) >= LogClock::toWallTime(t0));
+    QVERIFY(qAbs(LogClock::currentWallTime() - QDateTime::currentMSecsSinceEpoch()) < 1000);
+
+    // Messages are written in the order in which they were logged, even if they were queued out of order
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    LogWriter writer;
+    writer.start(dir.path());
+
+    LogRecord later;
+    later.monotonicTime = t1 + 1000000;
+    later.timestamp = LogClock::toWallTime(later.monotonicTime);
+    later.text = "Second";
+
+    LogRecord earlier;
+    earlier.monotonicTime = t1;
+    earlier.timestamp = LogClock::toWallTime(earlier.monotonicTime);
+    earlier.text = "First";
+
+    writer.post(later);
+    writer.post(earlier);
+    QString path = writer.currentFilePath();
+    writer.stop();
+
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QString contents = QString::fromUtf8(file.readAll());
+    QVERIFY(contents.indexOf("First") >= 0);
+    QVERIFY(contents.indexOf("First") < contents.indexOf("Second"));
+}
+
+void TestLogging::testStartupProfile()
+{
+    StartupProfile::start();
+    QTest::qSleep(20);
+    StartupProfile::mark("First");
+    StartupProfile::mark("Second");
+    StartupProfile::addDeferredLoad("Screen", 150);
+    QTest::qSleep(20);
+    StartupProfile::mark("Third");
+
+    // Repeated phases (e.g. reconnections) are ignored
+    StartupProfile::mark("First");
+
+    QVector<StartupProfile::Phase> phases = StartupProfile::phases();
+    QCOMPARE(phases.size(), 4);
+
+    QCOMPARE(phases[0].name, QString("First"));
+    QVERIFY(phases[0].elapsed >= 20);
+    QCOMPARE(phases[0].duration, phases[0].elapsed);
+    QVERIFY(phases[1].elapsed >= phases[0].elapsed);
+
+    QCOMPARE(phases[2].name, QString("Screen"));
+    QVERIFY(phases[2].deferred);
+    QCOMPARE(phases[2].duration, 150.);
+
+    // Deferred loads don't count as phases of startup
+    QCOMPARE(phases[3].name, QString("Third"));
+    QVERIFY(!phases[3].deferred);
+    QVERIFY(phases[3].duration >= 20);
+    QCOMPARE(phases[3].duration, phases[3].elapsed - phases[1].elapsed);
+}
@@ -0,0 +1,28 @@
+#ifndef TESTLOGGING_H
+#define TESTLOGGING_H
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include "structuredlog.h"
+#include "logwriter.h"
+#include "logmodel.h"
+#include "logging.h"
+#include "logclock.h"
+#include "startupprofile.h"
+
+class TestLogging : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testStructuredLog();
+    void testRotation();
+    void testLogModel();
+    void testRateLimiter();
+    void testLogCategories();
+    void testLogClock();
+    void testStartupProfile();
+};
+
+#endif
@@ -0,0 +1,223 @@
+#include "testpressurerecorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void TestPressureRecorder::testRecording()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const qint64 t0 = 1600000000000;
+    QString path;
+
+    {
+        PressureRecorder recorder(dir.path());
+        recorder.setRange(1, 0, 30);
+        recorder.setRange(2, -10, 10);
+
+        // 20 minutes at 10 Hz, i.e. several chunks (written every CHUNK_INTERVAL)
+        for (int i(0); i < 12000; ++i) {
+            recorder.addSample(1, t0 + 100*i, 0.5, (i % 100) / 100.);
+            if (i % 10 == 0)
+                recorder.addSample(2, t0 + 100*i, 0.25, 0.75);
+        }
+
+        // Samples that are still buffered are written when the recorder is destroyed
+        path = recorder.filePath();
+    }
+
+    PressureHistoryReader reader;
+    QVERIFY(reader.open(dir.path()));
+
+    QCOMPARE(reader.firstTimestamp(1), t0);
+    QCOMPARE(reader.lastTimestamp(1), t0 + 100*11999);
+    QCOMPARE(reader.firstTimestamp(3), qint64(-1));
+
+    QVector<PressureSample> all = reader.samples(1, t0, t0 + 100*11999);
+    QCOMPARE(all.size(), 12000);
+    for (int i(0); i < all.size(); ++i) {
+        QCOMPARE(all[i].timestamp, t0 + 100*i);
+        QVERIFY(qAbs(all[i].setpoint - 15) < 0.001);
+        QVERIFY(qAbs(all[i].measured - 30*(i % 100)/100.) < 0.001);
+    }
+
+    QVector<PressureSample> range = reader.samples(1, t0 + 1000, t0 + 2000);
+    QCOMPARE(range.size(), 11);
+    QCOMPARE(range.first().timestamp, t0 + 1000);
+
+    QVector<PressureSample> other = reader.samples(2, t0, t0 + 100*12000);
+    QCOMPARE(other.size(), 1200);
+    QVERIFY(qAbs(other[0].setpoint - (-5)) < 0.001);
+    QVERIFY(qAbs(other[0].measured - 5) < 0.001);
+
+    // A chunk truncated by a crash is ignored
+    reader.close();
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.resize(file.size() - 10));
+    file.close();
+
+    QVERIFY(reader.open(path));
+    int remaining = reader.samples(1, t0, t0 + 100*12000).size() + reader.samples(2, t0, t0 + 100*12000).size();
+    QVERIFY(remaining > 0);
+    QVERIFY(remaining < 13200);
+}
+
+void TestPressureRecorder::testFlushExpired()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const qint64 t0 = 1600000000000;
+
+    PressureRecorder recorder(dir.path());
+    recorder.addSample(1, t0, 0.5, 0.5);
+    recorder.addSample(2, t0 + 30000, 0.5, 0.5);
+
+    // Only the chunk of controller 1 is old enough to be written, although no samples followed it
+    recorder.flushExpired(t0 + PressureRecorder::CHUNK_INTERVAL);
+    recorder.waitForDone();
+
+    PressureHistoryReader reader;
+    QVERIFY(reader.open(recorder.filePath()));
+    QCOMPARE(reader.samples(1, t0, t0 + 60000).size(), 1);
+    QCOMPARE(reader.samples(2, t0, t0 + 60000).size(), 0);
+    reader.close();
+
+    recorder.flush();
+    recorder.waitForDone();
+
+    QVERIFY(reader.open(recorder.filePath()));
+    QCOMPARE(reader.samples(2, t0, t0 + 60000).size(), 1);
+}
+
+void TestPressureRecorder::testDownsampling()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const qint64 t0 = 1600000000000;
+    const int n = 50000;
+
+    {
+        PressureRecorder recorder(dir.path());
+        recorder.setRange(1, 0, 100);
+        for (int i(0); i < n; ++i)
+            recorder.addSample(1, t0 + 50*i, 0, 0.5 + 0.4*std::sin(i / 500.));
+    }
+
+    PressureHistoryReader reader;
+    QVERIFY(reader.open(dir.path()));
+
+    QVector<PressureSample> samples = reader.samples(1, t0, t0 + 50*n);
+    QCOMPARE(samples.size(), n);
+
+    // Buckets match the statistics computed from the individual samples, whether or not the reader
+    // uses the chunk summaries
+    for (int bucketCount : {1, 7, 100, 5000}) {
+        qint64 from = t0 + 1234;
+        qint64 to = t0 + 50*n - 5678;
+        QVector<PressureBucket> buckets = reader.downsample(1, from, to, bucketCount);
+        QCOMPARE(buckets.size(), bucketCount);
+
+        int total = 0;
+        for (PressureBucket const& b : buckets) {
+            int count = 0;
+            double min = 1e9, max = -1e9, sum = 0;
+            for (PressureSample const& s : samples) {
+                if (s.timestamp >= b.start && s.timestamp < b.end) {
+                    count++;
+                    min = qMin(min, s.measured);
+                    max = qMax(max, s.measured);
+                    sum += s.measured;
+                }
+            }
+
+            QCOMPARE(b.count, count);
+            if (count > 0) {
+                QVERIFY(qAbs(b.min - min) < 1e-6);
+                QVERIFY(qAbs(b.max - max) < 1e-6);
+                QVERIFY(qAbs(b.mean - sum / count) < 1e-6);
+            }
+            total += b.count;
+        }
+
+        QCOMPARE(buckets.first().start, from);
+        QCOMPARE(buckets.last().end, to);
+        QCOMPARE(total, int(std::count_if(samples.begin(), samples.end(), [&](PressureSample const& s) {
+            return s.timestamp >= from && s.timestamp < to;
+        })));
+    }
+}
+
+void TestPressureRecorder::testLiveDecimation()
+{
+    // Small capacity, so that the ring buffer wraps around
+    PressureTimeSeries series(10000);
+    QCOMPARE(series.capacity() % PressureTimeSeries::BLOCK_SIZE, 0);
+
+    QSignalSpy spy(&series, &PressureTimeSeries::samplesAdded);
+
+    const qint64 t0 = 1600000000000;
+    const int n = 25000;
+    for (int i(0); i < n; ++i) {
+        double measured = 10 + 5*std::sin(i / 300.) + (i % 997 == 0 ? 20 : 0); // occasional spikes
+        series.append(1, t0 + 10*i, i / 5000, measured);
+    }
+
+    QCOMPARE(spy.count(), n);
+    QCOMPARE(series.size(1), series.capacity());
+    QCOMPARE(series.size(2), 0);
+    QCOMPARE(series.lastTimestamp(1), t0 + 10*(n - 1));
+
+    // Expected extrema, computed from the samples still in the buffer
+    int first = n - series.capacity();
+    auto valueAt = [](int i) { return float(10 + 5*std::sin(i / 300.) + (i % 997 == 0 ? 20 : 0)); };
+
+    for (int bucketCount : {1, 13, 500, 20000}) {
+        qint64 from = t0 + 10*(first - 100); // starts before the oldest sample still stored
+        qint64 to = t0 + 10*n;
+
+        QVector<PressureTimeSeries::Point> measured, setpoint;
+        series.decimate(1, from, to, bucketCount, measured, setpoint);
+
+        QVERIFY(measured.size() <= 2 * bucketCount);
+        QVERIFY(!measured.isEmpty());
+
+        for (int i(1); i < measured.size(); ++i)
+            QVERIFY(measured[i].timestamp > measured[i-1].timestamp);
+
+        // Every bucket's extrema are present, so the overall extrema (including spikes) are too
+        float expectedMax = std::numeric_limits<float>::lowest();
+        float expectedMin = std::numeric_limits<float>::max();
+        for (int i(first); i < n; ++i) {
+            expectedMax = qMax(expectedMax, valueAt(i));
+            expectedMin = qMin(expectedMin, valueAt(i));
+        }
+
+        double max = -1e9, min = 1e9;
+        for (PressureTimeSeries::Point const& p : measured) {
+            max = qMax(max, p.value);
+            min = qMin(min, p.value);
+
+            // Points are actual samples
+            int i = int((p.timestamp - t0) / 10);
+            QVERIFY(i >= first && i < n);
+            QCOMPARE(float(p.value), valueAt(i));
+        }
+        QCOMPARE(float(max), expectedMax);
+        QCOMPARE(float(min), expectedMin);
+
+        QCOMPARE(setpoint.first().value, double(first / 5000));
+        QCOMPARE(setpoint.last().value, double((n - 1) / 5000));
+    }
+
+    // Empty windows
+    QVector<PressureTimeSeries::Point> measured, setpoint;
+    series.decimate(1, t0 + 10*n, t0 + 10*n + 1000, 100, measured, setpoint);
+    QVERIFY(measured.isEmpty());
+    series.decimate(2, t0, t0 + 10*n, 100, measured, setpoint);
+    QVERIFY(measured.isEmpty());
+}
@@ -0,0 +1,21 @@
+#ifndef TESTPRESSURERECORDER_H
+#define TESTPRESSURERECORDER_H
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include "pressurerecorder.h"
+#include "pressuretimeseries.h"
+
+class TestPressureRecorder : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testRecording();
+    void testFlushExpired();
+    void testDownsampling();
+    void testLiveDecimation();
+};
+
+#endif
@@ -5,7 +5,7 @@ void TestRoutines::initTestCase()
     mTempFileLocation = "file:./dummyroutine.txt";
     createDummyRoutineFile(mTempFileLocation);
 
-    ApplicationController* controller = new RoutineMockApplicationController();
+    ApplicationController* controller = new MockApplicationController();
     r = new RoutineController(controller);
 }
 
@@ -55,6 +55,201 @@ void TestRoutines::testRunning()
     QCOMPARE(pressureSpy[1][1].toDouble(), 3.1/30);
 }
 
+void TestRoutines::testMultiplexer()
+{
+    // Channel configurations are compiled to bitmasks, with bit 0 corresponding to valve 1
+
+    Multiplexer mux("test", {3, 4, 5, 6});
+    QVERIFY(mux.addChannel("1", "1010"));
+    QVERIFY(mux.addChannel("All", "0000"));
+
+    // Invalid configurations: wrong length, invalid characters
+    QVERIFY(!mux.addChannel("2", "10101"));
+    QVERIFY(!mux.addChannel("3", "10x0"));
+
+    QCOMPARE(mux.channelLabels(), QStringList({"1", "All"}));
+
+    Multiplexer::Channel channel;
+    QVERIFY(mux.findChannel("1", channel));
+    QCOMPARE(channel.openMask, quint32(0b0010100));
+    QCOMPARE(channel.closeMask, quint32(0b0101000));
+
+    // Labels are case-insensitive
+    QVERIFY(mux.findChannel("all", channel));
+    QCOMPARE(channel.openMask, quint32(0));
+    QCOMPARE(channel.closeMask, quint32(0b0111100));
+
+    // "None" is defined implicitly, and opens all the control valves
+    QVERIFY(mux.findChannel("None", channel));
+    QCOMPARE(channel.openMask, quint32(0b0111100));
+    QCOMPARE(channel.closeMask, quint32(0));
+
+    QVERIFY(!mux.findChannel("2", channel));
+}
+
+void TestRoutines::testCheckpoint()
+{
+    RoutineCheckpoint checkpoint;
+    checkpoint.fileUrl = mTempFileLocation;
+    checkpoint.routineName = "dummyroutine";
+    checkpoint.routineHash = QCryptographicHash::hash("dummy", QCryptographicHash::Sha1);
+    checkpoint.step = 3;
+    checkpoint.numberOfSteps = 6;
+    checkpoint.waitRemaining = 1500;
+    checkpoint.openValves = 0b1010;
+    checkpoint.closedValves = 0b0101;
+    checkpoint.pressures[1] = 0.25;
+    checkpoint.time = QDateTime::currentDateTimeUtc();
+
+    QString path = "./test_checkpoint.dat";
+    CheckpointWriter writer(path);
+    writer.post(checkpoint.serialize());
+    writer.waitForDone();
+
+    RoutineCheckpoint read = RoutineCheckpoint::deserialize(writer.read());
+    QVERIFY(read.isValid());
+    QCOMPARE(read.fileUrl, checkpoint.fileUrl);
+    QCOMPARE(read.routineHash, checkpoint.routineHash);
+    QCOMPARE(read.step, 3);
+    QCOMPARE(read.waitRemaining, qint64(1500));
+    QCOMPARE(read.openValves, quint32(0b1010));
+    QCOMPARE(read.closedValves, quint32(0b0101));
+    QCOMPARE(read.pressures, checkpoint.pressures);
+
+    // Clearing removes the file; corrupt data gives an invalid checkpoint
+    writer.clear();
+    writer.waitForDone();
+    QVERIFY(!QFile::exists(path));
+    QVERIFY(!RoutineCheckpoint::deserialize(QByteArray("garbage")).isValid());
+}
+
+void TestRoutines::testResumeWait()
+{
+    const char * routine = "valve 1 open\nwait 500 ms\nvalve 1 close";
+
+    QString url = "file:./resumeroutine.txt";
+    QFile file(QUrl(url).toLocalFile());
+    file.open(QIODevice::WriteOnly);
+    file.write(routine);
+    file.close();
+
+    MockApplicationController controller;
+
+    // Checkpoint taken at the end of step 1, i.e. before the wait started (waitRemaining is 0),
+    // then one taken during the wait, with 50 ms left
+    for (qint64 waitRemaining : {qint64(0), qint64(50)}) {
+        RoutineCheckpoint checkpoint;
+        checkpoint.fileUrl = url;
+        checkpoint.routineName = "resumeroutine";
+        checkpoint.routineHash = QCryptographicHash::hash(routine, QCryptographicHash::Sha1);
+        checkpoint.step = 1;
+        checkpoint.numberOfSteps = 3;
+        checkpoint.waitRemaining = waitRemaining;
+        checkpoint.openValves = 0b1;
+        checkpoint.time = QDateTime::currentDateTimeUtc();
+
+        CheckpointWriter writer;
+        writer.post(checkpoint.serialize());
+        writer.waitForDone();
+
+        // A new controller each time, so that it is done deleting the previous checkpoint
+        RoutineController resumed(&controller);
+        QSignalSpy valveSpy(&resumed, SIGNAL(setValve(uint, bool)));
+
+        QVERIFY(resumed.checkpointAvailable());
+
+        QElapsedTimer timer;
+        timer.start();
+        QVERIFY(resumed.resumeFromCheckpoint());
+
+        while(resumed.status() != RoutineController::Finished)
+            QTest::qSleep(10);
+
+        if (waitRemaining == 0)
+            QVERIFY(timer.elapsed() >= 450);
+        else
+            QVERIFY(timer.elapsed() < 450);
+
+        // Only the step after the wait is executed
+        QCOMPARE(valveSpy.count(), 1);
+        QCOMPARE(valveSpy[0][1].toBool(), false);
+    }
+
+    QFile::remove(QUrl(url).toLocalFile());
+}
+
+void TestRoutines::testWaitUntil()
+{
+    const char * routine = R"(
+wait until pressure 1 >= 10 timeout 5
+valve 1 open
+wait until pressure 2 < 3 timeout 100 ms
+
+# invalid: controller number, operator, missing timeout value
+wait until pressure 3 > 1
+wait until pressure 1 = 1
+wait until pressure 1 > 1 timeout)";
+
+    QString url = "file:./waituntilroutine.txt";
+    QFile file(QUrl(url).toLocalFile());
+    file.open(QIODevice::WriteOnly);
+    file.write(routine);
+    file.close();
+
+    r->loadFile(url);
+    QCOMPARE(r->verify(), 3);
+    QCOMPARE(r->numberOfSteps(), 3);
+
+    QSignalSpy errorSpy(r, SIGNAL(error(QString)));
+
+    QElapsedTimer timer;
+    timer.start();
+    r->begin();
+
+    // The first wait ends as soon as the condition is met, rather than after the timeout
+    QTest::qSleep(100);
+    r->setMeasuredPressure(1, 5);
+    r->setMeasuredPressure(1, 12);
+
+    while(r->status() != RoutineController::Finished)
+        QTest::qSleep(10);
+
+    QVERIFY(timer.elapsed() < 2000);
+
+    // No measurement was received for controller 2, so the second wait times out
+    QCOMPARE(errorSpy.count(), 1);
+}
+
+void TestRoutines::testStepsModel()
+{
+    // Windows line endings and a byte order mark are handled like QTextStream does
+    QString url = "file:./crlfroutine.txt";
+    QFile file(QUrl(url).toLocalFile());
+    file.open(QIODevice::WriteOnly);
+    file.write("\xEF\xBB\xBFvalve 3 open\r\n\r\n  wait   2 min # comment\r\npressure 2 5");
+    file.close();
+
+    QVERIFY(r->loadFile(url));
+    QCOMPARE(r->fileContents(), QStringList({"valve 3 open", "", "  wait   2 min # comment", "pressure 2 5"}));
+    QCOMPARE(r->verify(), 0);
+
+    // Step text is read from the file, without comments and excess whitespace
+    QAbstractItemModel* model = r->stepsModel();
+    QCOMPARE(model->rowCount(), 3);
+    QCOMPARE(model->data(model->index(0, 0)).toString(), QString("valve 3 open"));
+    QCOMPARE(model->data(model->index(1, 0)).toString(), QString("wait 2 min"));
+    QCOMPARE(r->stepText(2), QString("pressure 2 5"));
+    QCOMPARE(r->stepText(3), QString());
+    QCOMPARE(r->totalRunTime(), 120L);
+
+    // Loading another file resets the model
+    QSignalSpy resetSpy(model, SIGNAL(modelReset()));
+    r->loadFile(mTempFileLocation);
+    QCOMPARE(resetSpy.count(), 1);
+    QCOMPARE(model->rowCount(), 0);
+
+    QFile::remove(QUrl(url).toLocalFile());
+}
 
 void TestRoutines::createDummyRoutineFile(QString url)
 {
@@ -6,7 +6,7 @@
 
 #include "communicator.h"
 #include "routinecontroller.h"
-#include "applicationcontroller.h"
+#include "mockapplicationcontroller.h"
 
 class TestRoutines : public QObject
 {
@@ -17,6 +17,11 @@ private slots:
     void cleanupTestCase();
     void testParsing();
     void testRunning();
+    void testMultiplexer();
+    void testCheckpoint();
+    void testResumeWait();
+    void testWaitUntil();
+    void testStepsModel();
 private:
     void createDummyRoutineFile(QString url);
 
@@ -24,16 +29,4 @@ private:
     RoutineController* r;
 };
 
-class RoutineMockApplicationController : public ApplicationController
-{
-    // To do: use a mocking library instead of this
-public:
-    RoutineMockApplicationController() {}
-    int nValves() { return 32; }
-    int nPumps() { return 2; }
-    int nPressureControllers() { return 2; }
-    double minPressure(int controllerNumber) { Q_UNUSED(controllerNumber); return 0;}
-    double maxPressure(int controllerNumber) { Q_UNUSED(controllerNumber); return 30;}
-};
-
 #endif
@@ -0,0 +1,64 @@
+#include "testsettingscache.h"
+
+void TestSettingsCache::testReadWrite()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString fileName = dir.filePath("settings.ini");
+
+    {
+        QSettings settings(fileName, QSettings::IniFormat);
+        settings.setValue("baudRate", 57600);
+        settings.setValue("valveLabels/3", "Inlet");
+    }
+
+    SettingsCache cache(fileName);
+    QCOMPARE(cache.value("baudRate", 115200).toInt(), 57600);
+    QCOMPARE(cache.value("valveLabels/3").toString(), QString("Inlet"));
+    QCOMPARE(cache.value("valveLabels/4", "Unlabeled input").toString(), QString("Unlabeled input"));
+    QVERIFY(!cache.contains("darkMode"));
+
+    // Changes are visible immediately, but only written after WRITE_DELAY (or when flushed)
+    for (int i(0); i < 100; ++i)
+        cache.setValue("windowWidth", 500 + i);
+    cache.setValue("darkMode", true);
+    QCOMPARE(cache.value("windowWidth").toInt(), 599);
+    QVERIFY(cache.value("darkMode", false).toBool());
+
+    QVERIFY(!QSettings(fileName, QSettings::IniFormat).contains("windowWidth"));
+
+    QTRY_VERIFY_WITH_TIMEOUT(QSettings(fileName, QSettings::IniFormat).contains("windowWidth"),
+                             SettingsCache::WRITE_DELAY * 5);
+    cache.waitForDone();
+
+    QSettings settings(fileName, QSettings::IniFormat);
+    QCOMPARE(settings.value("windowWidth").toInt(), 599);
+    QCOMPARE(settings.value("darkMode").toBool(), true);
+    QCOMPARE(settings.value("baudRate").toInt(), 57600);
+
+    // Pending changes are written when the cache is destroyed
+    {
+        SettingsCache other(fileName);
+        QCOMPARE(other.value("windowWidth").toInt(), 599);
+        other.setValue("windowHeight", 900);
+    }
+    QCOMPARE(QSettings(fileName, QSettings::IniFormat).value("windowHeight").toInt(), 900);
+}
+
+void TestSettingsCache::testChildKeys()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    SettingsCache cache(dir.filePath("settings.ini"));
+    cache.setValue("graphicalControl/enabled", true);
+    cache.setValue("graphicalControl/sources/Droplet Generator", "qrc:/a.qml");
+    cache.setValue("graphicalControl/sources/Co-culture chip v5", "qrc:/b.qml");
+    cache.setValue("graphicalControl/sourcesOld", "x");
+    cache.setValue("graphicalControl/sources/nested/key", "y");
+
+    QCOMPARE(cache.childKeys("graphicalControl/sources"),
+             QStringList({"Co-culture chip v5", "Droplet Generator"}));
+    QCOMPARE(cache.childKeys("graphicalControl"), QStringList({"enabled", "sourcesOld"}));
+    QVERIFY(cache.childKeys("logging").isEmpty());
+}
@@ -0,0 +1,18 @@
+#ifndef TESTSETTINGSCACHE_H
+#define TESTSETTINGSCACHE_H
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include "settingscache.h"
+
+class TestSettingsCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testReadWrite();
+    void testChildKeys();
+};
+
+#endif
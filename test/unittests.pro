@@ -1,7 +1,9 @@
 QT += qml quick core serialport testlib bluetooth
 
 HEADERS += \
+    mockapplicationcontroller.h \
     testcommunicator.h \
+    simulatedcommunicator.h \
     ../src/cpp/bluetoothcommunicator.h \
     ../src/cpp/serialcommunicator.h \
     ../src/cpp/communicator.h \
@@ -9,18 +11,63 @@ HEADERS += \
     ../src/cpp/applicationcontroller.h \
     ../src/cpp/guihelper.h \
     ../src/cpp/routinecontroller.h \
-    testroutines.h
+    ../src/cpp/multiplexer.h \
+    ../src/cpp/logging.h \
+    ../src/cpp/logclock.h \
+    ../src/cpp/logmodel.h \
+    ../src/cpp/structuredlog.h \
+    ../src/cpp/logwriter.h \
+    ../src/cpp/logarchiver.h \
+    ../src/cpp/routinecheckpoint.h \
+    ../src/cpp/routinesource.h \
+    ../src/cpp/routinestepsmodel.h \
+    ../src/cpp/pressurerecorder.h \
+    ../src/cpp/pressuretimeseries.h \
+    ../src/cpp/experimentexporter.h \
+    ../src/cpp/devicestate.h \
+    ../src/cpp/settingscache.h \
+    ../src/cpp/startupprofile.h \
+    testroutines.h \
+    testlogging.h \
+    testpressurerecorder.h \
+    testexperimentexporter.h \
+    testdevicestate.h \
+    testsettingscache.h \
+    testguiupdates.h
 
 SOURCES += \
     test_main.cpp \
     testcommunicator.cpp \
+    simulatedcommunicator.cpp \
     ../src/cpp/bluetoothcommunicator.cpp \
     ../src/cpp/serialcommunicator.cpp \
     ../src/cpp/communicator.cpp \
     ../src/cpp/applicationcontroller.cpp \
     ../src/cpp/guihelper.cpp \
     ../src/cpp/routinecontroller.cpp \
-    testroutines.cpp
+    ../src/cpp/multiplexer.cpp \
+    ../src/cpp/logging.cpp \
+    ../src/cpp/logclock.cpp \
+    ../src/cpp/logmodel.cpp \
+    ../src/cpp/structuredlog.cpp \
+    ../src/cpp/logwriter.cpp \
+    ../src/cpp/logarchiver.cpp \
+    ../src/cpp/routinecheckpoint.cpp \
+    ../src/cpp/routinesource.cpp \
+    ../src/cpp/routinestepsmodel.cpp \
+    ../src/cpp/pressurerecorder.cpp \
+    ../src/cpp/pressuretimeseries.cpp \
+    ../src/cpp/experimentexporter.cpp \
+    ../src/cpp/devicestate.cpp \
+    ../src/cpp/settingscache.cpp \
+    ../src/cpp/startupprofile.cpp \
+    testroutines.cpp \
+    testlogging.cpp \
+    testpressurerecorder.cpp \
+    testexperimentexporter.cpp \
+    testdevicestate.cpp \
+    testsettingscache.cpp \
+    testguiupdates.cpp
 
 INCLUDEPATH += ../src/cpp/
 
@@ -11,17 +11,51 @@ HEADERS += \
     src/cpp/constants.h \
     src/cpp/applicationcontroller.h \
     src/cpp/logger.h \
+    src/cpp/logging.h \
+    src/cpp/logclock.h \
+    src/cpp/logmodel.h \
+    src/cpp/logwriter.h \
+    src/cpp/logarchiver.h \
+    src/cpp/structuredlog.h \
     src/cpp/routinecontroller.h \
+    src/cpp/multiplexer.h \
+    src/cpp/routinecheckpoint.h \
+    src/cpp/routinesource.h \
+    src/cpp/routinestepsmodel.h \
+    src/cpp/pressurerecorder.h \
+    src/cpp/pressuretimeseries.h \
+    src/cpp/experimentexporter.h \
+    src/cpp/devicestate.h \
+    src/cpp/settingscache.h \
+    src/cpp/startupprofile.h \
+    src/cpp/pressurechart.h \
     src/cpp/guihelper.h \
     src/cpp/bluetoothcommunicator.h \
     src/cpp/serialcommunicator.h
 
 SOURCES += \
     src/cpp/logger.cpp \
+    src/cpp/logging.cpp \
+    src/cpp/logclock.cpp \
+    src/cpp/logmodel.cpp \
+    src/cpp/logwriter.cpp \
+    src/cpp/logarchiver.cpp \
+    src/cpp/structuredlog.cpp \
     src/cpp/main.cpp \
     src/cpp/communicator.cpp \
     src/cpp/applicationcontroller.cpp \
     src/cpp/routinecontroller.cpp \
+    src/cpp/multiplexer.cpp \
+    src/cpp/routinecheckpoint.cpp \
+    src/cpp/routinesource.cpp \
+    src/cpp/routinestepsmodel.cpp \
+    src/cpp/pressurerecorder.cpp \
+    src/cpp/pressuretimeseries.cpp \
+    src/cpp/experimentexporter.cpp \
+    src/cpp/devicestate.cpp \
+    src/cpp/settingscache.cpp \
+    src/cpp/startupprofile.cpp \
+    src/cpp/pressurechart.cpp \
     src/cpp/guihelper.cpp \
     src/cpp/bluetoothcommunicator.cpp \
     src/cpp/serialcommunicator.cpp
@@ -70,6 +104,7 @@ DISTFILES += \
     src/qml/Style.qml \
     src/qml/RoutineControl.qml \
     src/qml/LogScreen.qml \
+    src/qml/LazyScreen.qml \
     src/qml/PumpSwitch.qml \
     src/qml/MultiplexerControl.qml
 
@@ -92,3 +127,4 @@ isEmpty(GIT_BIN) {
 }
 
 #DEFINES += LOG_TO_TERMINAL # Write logs to terminal as well as to a file and to the application
+#DEFINES += UFCS_LOG_MIN_LEVEL=1 # Remove debug messages from the UFCS_* logging macros at compile time (see logging.h)